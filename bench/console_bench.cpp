@@ -0,0 +1,224 @@
+/**
+ * ESP Chas TV - Serial console throughput
+ *
+ * Streams a scripted cue list (the kind a show console sends over USB)
+ * through SerialConsole in random-sized chunks, the way bytes trickle in
+ * from Serial.available(), and checks every line reached the right
+ * handler with the right arguments. For comparison it runs the same
+ * script through the String-style parsing the sketches used before
+ * (readStringUntil + trim + toLowerCase + substring), modelled with
+ * std::string.
+ *
+ * Every operator new is counted, so allocs_per_line shows what each
+ * parser costs the heap. Prints CSV:
+ *   parser,lines,ns_per_line,allocs_per_line,check
+ *
+ * Build & run (host):
+ *   g++ -O2 -Ilib/ChaosShow/src bench/console_bench.cpp \
+ *       lib/ChaosShow/src/SerialConsole.cpp -o console_bench && ./console_bench
+ */
+
+#include "SerialConsole.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+static const int LINES = 200000;
+
+// ---------------------------------------------------------------------------
+// Allocation counter
+// ---------------------------------------------------------------------------
+
+static unsigned long allocCount = 0;
+
+void* operator new(size_t size) {
+  allocCount++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// ---------------------------------------------------------------------------
+// Script
+// ---------------------------------------------------------------------------
+
+enum { H_START, H_STOP, H_SCENE, H_PATTERN, H_FEC, H_COUNT };
+
+struct Expect {
+  int handler;   // -1 = unknown, -2 = dropped (too long)
+  int a;
+  int b;
+};
+
+struct Result {
+  long hits[H_COUNT];
+  long sumA;
+  long sumB;
+  long unknown;
+};
+
+static Result got;
+
+static void hStart(uint8_t, char**, void*)   { got.hits[H_START]++; }
+static void hStop(uint8_t, char**, void*)    { got.hits[H_STOP]++; }
+static void hScene(uint8_t, char* argv[], void*) {
+  got.hits[H_SCENE]++;
+  got.sumA += consoleInt(argv[1]);
+}
+static void hPattern(uint8_t, char* argv[], void*) {
+  got.hits[H_PATTERN]++;
+  got.sumA += consoleInt(argv[1]);
+}
+static void hFec(uint8_t, char* argv[], void*) {
+  got.hits[H_FEC]++;
+  got.sumA += consoleInt(argv[1], 4);
+  got.sumB += consoleInt(argv[2], 2);
+}
+static void hUnknown(uint8_t, char**, void*) { got.unknown++; }
+
+static const ConsoleCommand table[] = {
+  { "start",   hStart },
+  { "stop",    hStop },
+  { "scene",   hScene },
+  { "pattern", hPattern },
+  { "fec",     hFec },
+};
+
+static uint32_t rng = 0x12345678;
+static uint32_t nextRand() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static void buildScript(std::string& script, Result& want) {
+  memset(&want, 0, sizeof(want));
+  char line[160];
+
+  for (int i = 0; i < LINES; i++) {
+    int n = (int)(nextRand() % 9);
+    int v = (int)(nextRand() % 10);
+    const char* eol = (nextRand() & 1) ? "\r\n" : "\n";
+
+    switch (n) {
+      case 0: snprintf(line, sizeof(line), "start%s", eol); want.hits[H_START]++; break;
+      case 1: snprintf(line, sizeof(line), "  STOP %s", eol); want.hits[H_STOP]++; break;
+      case 2: snprintf(line, sizeof(line), "scene%d%s", v, eol); want.hits[H_SCENE]++; want.sumA += v; break;
+      case 3: snprintf(line, sizeof(line), "scene %d%s", v, eol); want.hits[H_SCENE]++; want.sumA += v; break;
+      case 4: snprintf(line, sizeof(line), "pattern\t%d%s", v, eol); want.hits[H_PATTERN]++; want.sumA += v; break;
+      case 5: snprintf(line, sizeof(line), "fec %d %d%s", v + 1, v % 3, eol); want.hits[H_FEC]++; want.sumA += v + 1; want.sumB += v % 3; break;
+      case 6: snprintf(line, sizeof(line), "fec%s", eol); want.hits[H_FEC]++; want.sumA += 4; want.sumB += 2; break;
+      case 7: snprintf(line, sizeof(line), "bogus %d%s", v, eol); want.unknown++; break;
+      default: {
+        // Longer than CONSOLE_LINE_MAX - must be dropped, not run
+        memset(line, 'x', 120);
+        memcpy(line, "scene 1 ", 8);
+        strcpy(line + 120, eol);
+        break;
+      }
+    }
+    script += line;
+  }
+}
+
+static bool matches(const Result& a, const Result& b) {
+  return memcmp(a.hits, b.hits, sizeof(a.hits)) == 0 &&
+         a.sumA == b.sumA && a.sumB == b.sumB && a.unknown == b.unknown;
+}
+
+// ---------------------------------------------------------------------------
+// Parsers
+// ---------------------------------------------------------------------------
+
+static void runConsole(const std::string& script, std::vector<size_t>& chunks) {
+  SerialConsole console;
+  console.begin(table, sizeof(table) / sizeof(table[0]), 0, hUnknown);
+
+  size_t pos = 0;
+  for (size_t c = 0; pos < script.size(); c++) {
+    size_t n = chunks[c % chunks.size()];
+    if (pos + n > script.size()) n = script.size() - pos;
+    console.push(script.data() + pos, n);
+    pos += n;
+  }
+}
+
+// What readStringUntil('\n') + trim() + toLowerCase() + substring() did
+static void runStringStyle(const std::string& script) {
+  size_t pos = 0;
+  while (pos < script.size()) {
+    size_t nl = script.find('\n', pos);
+    std::string input = script.substr(pos, nl - pos);
+    pos = nl + 1;
+
+    size_t b = input.find_first_not_of(" \t\r");
+    size_t e = input.find_last_not_of(" \t\r");
+    input = (b == std::string::npos) ? std::string() : input.substr(b, e - b + 1);
+    for (size_t i = 0; i < input.size(); i++) input[i] = (char)tolower(input[i]);
+
+    if (input.size() > CONSOLE_LINE_MAX) continue;   // Same rule, for a fair check
+    if (input == "start") {
+      hStart(0, 0, 0);
+    } else if (input == "stop") {
+      hStop(0, 0, 0);
+    } else if (input.compare(0, 5, "scene") == 0) {
+      got.hits[H_SCENE]++;
+      got.sumA += atoi(input.substr(5).c_str());
+    } else if (input.compare(0, 7, "pattern") == 0) {
+      got.hits[H_PATTERN]++;
+      got.sumA += atoi(input.substr(7).c_str());
+    } else if (input.compare(0, 3, "fec") == 0) {
+      int k = 4, m = 2;
+      sscanf(input.substr(3).c_str(), "%d %d", &k, &m);
+      got.hits[H_FEC]++;
+      got.sumA += k;
+      got.sumB += m;
+    } else {
+      hUnknown(0, 0, 0);
+    }
+  }
+}
+
+static void report(const char* parser, double ns, unsigned long allocs, bool ok) {
+  printf("%s,%d,%.1f,%.2f,%s\n", parser, LINES, ns / LINES,
+         (double)allocs / LINES, ok ? "ok" : "MISMATCH");
+}
+
+int main() {
+  std::string script;
+  Result want;
+  buildScript(script, want);
+
+  // Serial.available() hands over 1..64 bytes at a time
+  std::vector<size_t> chunks;
+  for (int i = 0; i < 4096; i++) chunks.push_back(1 + nextRand() % 64);
+
+  printf("parser,lines,ns_per_line,allocs_per_line,check\n");
+
+  memset(&got, 0, sizeof(got));
+  unsigned long a0 = allocCount;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  runConsole(script, chunks);
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  report("SerialConsole", std::chrono::duration<double, std::nano>(t1 - t0).count(),
+         allocCount - a0, matches(got, want));
+
+  memset(&got, 0, sizeof(got));
+  a0 = allocCount;
+  t0 = std::chrono::steady_clock::now();
+  runStringStyle(script);
+  t1 = std::chrono::steady_clock::now();
+  report("string_style", std::chrono::duration<double, std::nano>(t1 - t0).count(),
+         allocCount - a0, matches(got, want));
+
+  return 0;
+}
@@ -0,0 +1,568 @@
+/**
+ * ESP Chas TV - Show core microbenchmarks
+ *
+ * Times the code every cue goes through on a fixture - frame encode,
+ * decode and address filter, command names, console dispatch, the
+ * executor, LED effect evaluation, the scheduler guard, the command log
+ * queue, the state journal and FEC - built natively against the real
+ * library sources. Flash-backed parts run on the partition model in
+ * bench/shim, so they pay for the same reads and writes as on a board.
+ *
+ * Each benchmark is sized to batches of at least --min-ms, run
+ * --repeats times, and reported as the fastest batch - anything else
+ * on the machine can only make a batch slower, so the fastest one is
+ * the steadiest number between runs. The batches go round-robin over
+ * the benchmarks, so a slow few seconds cost each one a batch rather
+ * than all of one benchmark's. Every operator new is counted: the
+ * show core must stay at 0 allocs_per_op. Prints CSV:
+ *   name,ops,ns_per_op,spread_pct,allocs_per_op
+ * spread_pct is (median - fastest batch) / fastest: how far a typical
+ * batch strayed. A run with a much larger spread than usual was
+ * disturbed - run it again before reading anything into it.
+ *
+ * Baseline mode: save one run, then compare later runs against it.
+ *   ./core_bench > base.csv
+ *   ./core_bench --baseline base.csv [--threshold 10]
+ * adds base_ns_per_op,change_pct,verdict columns (same / faster / slower
+ * / allocs / new) and exits 1 if any benchmark allocates more than it
+ * did, or got slower by more than --threshold percent (and more than
+ * MIN_CHANGE_NS). A benchmark that looks slower is measured again (up to
+ * RECHECKS times, keeping the fastest) before it counts, since a busy
+ * neighbour can slow a machine down for seconds at a time; a real
+ * slowdown stays slower however often it is measured. Other options:
+ * --filter <text> runs only names containing it.
+ *
+ * Build & run (host):
+ *   g++ -std=gnu++11 -O2 -Ibench/shim -Ilib/ChaosShow/src bench/core_bench.cpp \
+ *       lib/ChaosShow/src/ShowCommand.cpp lib/ChaosShow/src/ShowExecutor.cpp \
+ *       lib/ChaosShow/src/SerialConsole.cpp lib/ChaosShow/src/CommandLog.cpp \
+ *       lib/ChaosShow/src/StateJournal.cpp lib/ChaosShow/src/ShowStateStore.cpp \
+ *       lib/ChaosShow/src/PartitionStore.cpp lib/ChaosShow/src/FecCodec.cpp \
+ *       -o core_bench && ./core_bench
+ * or through PlatformIO: pio run -e native && .pio/build/native/program
+ */
+
+#include "ShowCommand.h"
+#include "ShowExecutor.h"
+#include "ShowScheduler.h"
+#include "ShowStateStore.h"
+#include "SerialConsole.h"
+#include "CommandLog.h"
+#include "PartitionStore.h"
+#include "FecCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Allocation counter
+// ---------------------------------------------------------------------------
+
+static unsigned long allocCount = 0;
+
+void* operator new(size_t size) {
+  allocCount++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Results go here so the compiler can't drop the work
+static volatile uint32_t sink = 0;
+
+static const uint32_t NODE_ID = 0x00C0FFEE;
+
+// ---------------------------------------------------------------------------
+// Command frames
+// ---------------------------------------------------------------------------
+
+static const ShowCommand CUES[8] = {
+  { CMD_SHOW_START, 0, 0 }, { CMD_SCENE, 1, 0 }, { CMD_PATTERN, PATTERN_FAST, 0 },
+  { CMD_LED_TOGGLE, 0, 0 }, { CMD_SCENE, 2, 0 }, { CMD_LED_ON, 0, 0 },
+  { CMD_SCENE, 3, 0 }, { CMD_PATTERN, PATTERN_STROBE, 0 },
+};
+
+static uint8_t frames[16][sizeof(ShowFrame)];   // Half of them addressed
+static ShowAddress me;
+
+static void setupFrames() {
+  me.groups = (1u << 2) | (1u << 5);
+  me.device = 12;
+  for (int i = 0; i < 16; i++) {
+    ShowFrame f;
+    showFrameEncode(f, CUES[i & 7], 0x00BEEF00, i, 1000 * i);
+    if (i & 1) showFrameSetGroups(f, 1u << (i & 7));
+    if (i & 2) showFrameSetRange(f, 10, (uint16_t)(8 + i));
+    memcpy(frames[i], &f, sizeof(f));
+  }
+}
+
+static void benchFrameEncode(uint32_t n) {
+  ShowFrame f;
+  for (uint32_t i = 0; i < n; i++) {
+    showFrameEncode(f, CUES[i & 7], NODE_ID, i, i);
+    sink += f.seq;
+  }
+}
+
+static void benchFrameDecode(uint32_t n) {
+  ShowFrame f;
+  for (uint32_t i = 0; i < n; i++) {
+    if (showFrameDecode(frames[i & 15], sizeof(ShowFrame), f)) sink += f.value1;
+  }
+}
+
+static void benchFrameForMe(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    sink += showFrameForMe(frames[i & 15], sizeof(ShowFrame), me);
+  }
+}
+
+static const char* const NAMES[8] = {
+  "SHOW_START", "SCENE", "PATTERN", "LED_TOGGLE", "SET_GROUPS", "PING", "POLL_OPEN", "BOGUS",
+};
+
+static void benchCommandFromName(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) sink += showCommandFromName(NAMES[i & 7]);
+}
+
+static void benchGroupMask(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) sink += showGroupMask("1,3,7,12");
+}
+
+// ---------------------------------------------------------------------------
+// Console dispatch
+// ---------------------------------------------------------------------------
+
+static void onConsole(uint8_t argc, char* argv[], void*) {
+  sink += argc + (uint32_t)consoleInt(argv[1]);
+}
+
+// The master table of the 02 sketch, in its order
+static const ConsoleCommand CONSOLE_TABLE[] = {
+  { "start", onConsole }, { "stop", onConsole }, { "on", onConsole },
+  { "off", onConsole }, { "scene", onConsole }, { "pattern", onConsole },
+  { "zone", onConsole }, { "range", onConsole }, { "setgroups", onConsole },
+  { "setdevice", onConsole }, { "status", onConsole }, { "log", onConsole },
+  { "role", onConsole }, { "fleet", onConsole },
+};
+
+static const char* const LINES[8] = {
+  "start\n", "scene 2\n", "pattern 3\n", "zone 1,3 scene 2\n",
+  "SCENE4\n", "setdevice 12 7\n", "fleet\n", "nope 1\n",
+};
+static size_t lineLen[8];
+static SerialConsole console;
+
+static void setupConsole() {
+  console.begin(CONSOLE_TABLE, sizeof(CONSOLE_TABLE) / sizeof(CONSOLE_TABLE[0]), 0, onConsole);
+  for (int i = 0; i < 8; i++) lineLen[i] = strlen(LINES[i]);
+}
+
+static void benchConsoleLine(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) console.push(LINES[i & 7], lineLen[i & 7]);
+}
+
+// ---------------------------------------------------------------------------
+// Executor and LED effects
+// ---------------------------------------------------------------------------
+
+static ShowExecutor executor;
+
+static void onExecuted(const ShowCommand& cmd, void*) { sink += cmd.value1; }
+
+static void setupExecutor() {
+  executor.setNodeId(NODE_ID);
+  executor.on(CMD_SCENE, onExecuted);
+  ShowCommand groups = { CMD_SET_GROUPS, 0, (int32_t)me.groups };
+  executor.execute(groups, 0);
+}
+
+static void benchExecute(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) sink += executor.execute(CUES[i & 7], i);
+}
+
+// Decode + address filter + execute: what a receiver does per radio frame
+static void benchExecuteFrame(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    sink += executor.executeFrame(frames[i & 15], sizeof(ShowFrame), i);
+  }
+}
+
+static void benchLedLevel(uint32_t n) {
+  static const ShowCommand scene = { CMD_SCENE, 3, 0 };
+  executor.execute(scene, 0);
+  for (uint32_t i = 0; i < n; i++) sink += executor.ledLevel(i * 7);
+}
+
+// ---------------------------------------------------------------------------
+// Scheduler
+// ---------------------------------------------------------------------------
+
+static ShowScheduler scheduler;
+
+static void radioWork(void*) { sink++; }
+
+static void setupScheduler() { scheduler.begin(radioWork, 0); }
+
+// One loop() pass: run the radio work, then touch shared state under the guard
+static void benchSchedulerPoll(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    scheduler.poll();
+    ShowScheduler::Guard guard(scheduler);
+    sink += i;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Command log queue and state journal (flash model)
+// ---------------------------------------------------------------------------
+
+static PartitionStore logStore;
+static CommandRecorder recorder;
+
+static void setupRecorder() {
+  if (!logStore.begin(CMDLOG_PARTITION, CMDLOG_MAX_SECTORS) || !recorder.begin(&logStore, 0)) {
+    fprintf(stderr, "cmdlog partition model missing\n");
+    exit(2);
+  }
+}
+
+// record() from the radio callback, flush() from loop() every 8 cues
+static void benchRecorder(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    recorder.record(CUES[i & 7], SOURCE_ESPNOW, OUTCOME_EXECUTED, i * 500000u);
+    if ((i & 7) == 7) recorder.flush();
+  }
+  recorder.flush();
+  sink += recorder.stats().recorded;
+}
+
+static ShowStateStore stateStore;
+static ShowExecutor stateExecutor;
+
+static void setupStateStore() {
+  if (!stateStore.begin()) {
+    fprintf(stderr, "showstate partition model missing\n");
+    exit(2);
+  }
+}
+
+// A scene change followed by the loop() save, as on every cue
+static void benchStateSave(uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    ShowCommand cmd = { CMD_SCENE, (int32_t)(i & 15), 0 };
+    stateExecutor.execute(cmd, i);
+    stateStore.update(stateExecutor);
+  }
+  sink += stateStore.journal().seq();
+}
+
+// ---------------------------------------------------------------------------
+// FEC (LoRa cues, k=8 m=4)
+// ---------------------------------------------------------------------------
+
+static const uint8_t FEC_K = 8;
+static const uint8_t FEC_M = 4;
+static const int FEC_BLOCKS = 256;   // One full wrap of the block id
+
+static FecEncoder fecEncoder;
+static FecDecoder fecDecoder;
+static std::vector<std::vector<uint8_t> > fecPackets;   // One data packet lost per block
+
+static void onFecDeliver(const uint8_t* payload, uint8_t, bool recovered) {
+  sink += payload[0] + recovered;
+}
+
+static void setupFec() {
+  FecEncoder enc;
+  enc.configure(FEC_K, FEC_M, sizeof(ShowFrame));
+  uint8_t packet[FEC_MAX_PACKET];
+  for (int b = 0; b < FEC_BLOCKS; b++) {
+    for (int i = 0; i < FEC_K; i++) {
+      size_t len = enc.addData(frames[(b + i) & 15], packet);
+      if (i != b % FEC_K) fecPackets.push_back(std::vector<uint8_t>(packet, packet + len));
+    }
+    for (uint8_t j = 0; j < enc.repairCount(); j++) {
+      size_t len = enc.makeRepair(j, packet);
+      fecPackets.push_back(std::vector<uint8_t>(packet, packet + len));
+    }
+    enc.closeBlock();
+  }
+  fecEncoder.configure(FEC_K, FEC_M, sizeof(ShowFrame));
+  fecDecoder.onDeliver(onFecDeliver);
+}
+
+// Per cue: wrap it, and send the block's repair packets once it is full
+static void benchFecEncode(uint32_t n) {
+  uint8_t packet[FEC_MAX_PACKET];
+  for (uint32_t i = 0; i < n; i++) {
+    sink += fecEncoder.addData(frames[i & 15], packet);
+    if (fecEncoder.blockFull()) {
+      for (uint8_t j = 0; j < fecEncoder.repairCount(); j++) {
+        sink += fecEncoder.makeRepair(j, packet);
+      }
+      fecEncoder.closeBlock();
+    }
+  }
+}
+
+// Per packet received, with one cue per block rebuilt from the repairs
+static void benchFecDecode(uint32_t n) {
+  size_t count = fecPackets.size();
+  size_t at = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    const std::vector<uint8_t>& p = fecPackets[at];
+    sink += fecDecoder.receive(&p[0], p.size());
+    if (++at == count) at = 0;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------
+
+typedef void (*BenchFn)(uint32_t n);
+
+struct Bench {
+  const char* name;
+  void (*setup)();
+  BenchFn run;
+};
+
+static const Bench BENCHES[] = {
+  { "frame_encode",        setupFrames,     benchFrameEncode },
+  { "frame_decode",        0,               benchFrameDecode },
+  { "frame_for_me",        0,               benchFrameForMe },
+  { "command_from_name",   0,               benchCommandFromName },
+  { "group_mask_parse",    0,               benchGroupMask },
+  { "console_line",        setupConsole,    benchConsoleLine },
+  { "executor_execute",    setupExecutor,   benchExecute },
+  { "executor_frame",      0,               benchExecuteFrame },
+  { "led_level",           0,               benchLedLevel },
+  { "scheduler_poll",      setupScheduler,  benchSchedulerPoll },
+  { "cmdlog_record_flush", setupRecorder,   benchRecorder },
+  { "state_store_update",  setupStateStore, benchStateSave },
+  { "fec_encode_cue",      setupFec,        benchFecEncode },
+  { "fec_decode_packet",   0,               benchFecDecode },
+};
+
+static const int BENCH_COUNT = sizeof(BENCHES) / sizeof(BENCHES[0]);
+
+struct Result {
+  uint64_t ops;
+  double nsPerOp;
+  double spreadPct;
+  double allocsPerOp;
+};
+
+static double timeBatch(BenchFn fn, uint32_t n) {
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  fn(n);
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+// Grow the batch until it runs for minMs (this also warms the caches)
+static uint32_t batchSize(BenchFn fn, double minMs) {
+  uint32_t n = 1;
+  while (timeBatch(fn, n) < minMs * 1e6 && n < (1u << 30)) n *= 2;
+  return n;
+}
+
+// Batches of one benchmark, timed one at a time
+struct Samples {
+  uint32_t n;
+  std::vector<double> perOp;
+  unsigned long allocs;
+};
+
+static void timeSample(BenchFn fn, Samples& s) {
+  unsigned long allocsBefore = allocCount;
+  s.perOp.push_back(timeBatch(fn, s.n) / s.n);
+  s.allocs += allocCount - allocsBefore;
+}
+
+static Result summarize(Samples& s) {
+  std::sort(s.perOp.begin(), s.perOp.end());
+  Result res;
+  res.ops = (uint64_t)s.n * s.perOp.size();
+  res.nsPerOp = s.perOp.front();
+  res.spreadPct = res.nsPerOp > 0 ? 100.0 * (s.perOp[s.perOp.size() / 2] - res.nsPerOp) / res.nsPerOp : 0;
+  res.allocsPerOp = (double)s.allocs / res.ops;
+  return res;
+}
+
+static Result measure(BenchFn fn, double minMs, int repeats) {
+  Samples s = { batchSize(fn, minMs), std::vector<double>(), 0 };
+  for (int r = 0; r < repeats; r++) timeSample(fn, s);
+  return summarize(s);
+}
+
+// ---------------------------------------------------------------------------
+// Baseline
+// ---------------------------------------------------------------------------
+
+struct BaseEntry {
+  std::string name;
+  double nsPerOp;
+  double allocsPerOp;
+};
+
+static std::vector<std::string> splitCsv(const std::string& line) {
+  std::vector<std::string> out;
+  size_t start = 0;
+  for (;;) {
+    size_t comma = line.find(',', start);
+    out.push_back(line.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+    if (comma == std::string::npos) return out;
+    start = comma + 1;
+  }
+}
+
+static bool loadBaseline(const char* path, std::vector<BaseEntry>& out) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+  char buf[512];
+  int colName = -1, colNs = -1, colAllocs = -1;
+  while (fgets(buf, sizeof(buf), f)) {
+    std::string line(buf);
+    while (!line.empty() && (line[line.size() - 1] == '\n' || line[line.size() - 1] == '\r')) {
+      line.erase(line.size() - 1);
+    }
+    std::vector<std::string> cols = splitCsv(line);
+    if (colName < 0) {
+      for (size_t i = 0; i < cols.size(); i++) {
+        if (cols[i] == "name") colName = (int)i;
+        if (cols[i] == "ns_per_op") colNs = (int)i;
+        if (cols[i] == "allocs_per_op") colAllocs = (int)i;
+      }
+      if (colName < 0 || colNs < 0) break;   // Not one of our CSVs
+      continue;
+    }
+    if ((int)cols.size() <= std::max(colName, colNs)) continue;
+    BaseEntry e;
+    e.name = cols[colName];
+    e.nsPerOp = atof(cols[colNs].c_str());
+    e.allocsPerOp = colAllocs >= 0 && (int)cols.size() > colAllocs ? atof(cols[colAllocs].c_str()) : 0;
+    out.push_back(e);
+  }
+  fclose(f);
+  return colName >= 0 && colNs >= 0;
+}
+
+static const BaseEntry* findBase(const std::vector<BaseEntry>& base, const char* name) {
+  for (size_t i = 0; i < base.size(); i++) {
+    if (base[i].name == name) return &base[i];
+  }
+  return 0;
+}
+
+static double changePct(const Result& r, const BaseEntry& e) {
+  return e.nsPerOp > 0 ? 100.0 * (r.nsPerOp - e.nsPerOp) / e.nsPerOp : 0;
+}
+
+static const double MIN_CHANGE_NS = 0.25;   // Below the timer's reach even over a batch
+
+static const char* verdictFor(const Result& r, const BaseEntry& e, double threshold) {
+  double change = changePct(r, e);
+  if (r.allocsPerOp > e.allocsPerOp + 0.0005) return "allocs";
+  if (change > threshold && r.nsPerOp - e.nsPerOp > MIN_CHANGE_NS) return "slower";
+  if (change < -threshold && e.nsPerOp - r.nsPerOp > MIN_CHANGE_NS) return "faster";
+  return "same";
+}
+
+// ---------------------------------------------------------------------------
+// Main
+// ---------------------------------------------------------------------------
+
+static const int RECHECKS = 10;   // Extra measurements before "slower" counts
+
+static void usage() {
+  fprintf(stderr, "usage: core_bench [--filter text] [--min-ms n] [--repeats n]\n"
+                  "                  [--baseline file.csv] [--threshold pct]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  const char* filter = 0;
+  const char* baselinePath = 0;
+  double minMs = 20;
+  int repeats = 15;
+  double threshold = 10;
+
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--filter") && hasValue) filter = argv[++i];
+    else if (!strcmp(argv[i], "--baseline") && hasValue) baselinePath = argv[++i];
+    else if (!strcmp(argv[i], "--min-ms") && hasValue) minMs = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--repeats") && hasValue) repeats = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--threshold") && hasValue) threshold = atof(argv[++i]);
+    else usage();
+  }
+  if (minMs <= 0 || repeats < 1) usage();
+
+  std::vector<BaseEntry> base;
+  if (baselinePath && !loadBaseline(baselinePath, base)) {
+    fprintf(stderr, "can't read baseline %s\n", baselinePath);
+    return 2;
+  }
+
+  printf("name,ops,ns_per_op,spread_pct,allocs_per_op%s\n",
+         baselinePath ? ",base_ns_per_op,change_pct,verdict" : "");
+
+  // Setups run even for filtered-out benchmarks; later ones rely on them
+  std::vector<const Bench*> picked;
+  std::vector<Samples> samples;
+  for (int b = 0; b < BENCH_COUNT; b++) {
+    const Bench& bench = BENCHES[b];
+    if (bench.setup) bench.setup();
+    if (filter && !strstr(bench.name, filter)) continue;
+    Samples s = { batchSize(bench.run, minMs), std::vector<double>(), 0 };
+    picked.push_back(&bench);
+    samples.push_back(s);
+  }
+  for (int r = 0; r < repeats; r++) {
+    for (size_t i = 0; i < picked.size(); i++) timeSample(picked[i]->run, samples[i]);
+  }
+
+  int regressions = 0;
+  for (size_t i = 0; i < picked.size(); i++) {
+    const Bench& bench = *picked[i];
+    Result r = summarize(samples[i]);
+    const BaseEntry* e = baselinePath ? findBase(base, bench.name) : 0;
+    for (int retry = 0; e && retry < RECHECKS && !strcmp(verdictFor(r, *e, threshold), "slower"); retry++) {
+      Result again = measure(bench.run, minMs, repeats);
+      if (again.nsPerOp < r.nsPerOp) r = again;
+    }
+    printf("%s,%llu,%.2f,%.1f,%.3f", bench.name, (unsigned long long)r.ops,
+           r.nsPerOp, r.spreadPct, r.allocsPerOp);
+
+    if (baselinePath) {
+      if (!e) {
+        printf(",,,new");
+      } else {
+        const char* verdict = verdictFor(r, *e, threshold);
+        if (!strcmp(verdict, "allocs") || !strcmp(verdict, "slower")) regressions++;
+        printf(",%.2f,%+.1f,%s", e->nsPerOp, changePct(r, *e), verdict);
+      }
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+
+  if (baselinePath) {
+    fprintf(stderr, "%d regression%s against %s (threshold %.0f%%)\n",
+            regressions, regressions == 1 ? "" : "s", baselinePath, threshold);
+  }
+  return regressions ? 1 : 0;
+}
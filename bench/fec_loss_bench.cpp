@@ -0,0 +1,124 @@
+/**
+ * ESP Chas TV - FEC recovery vs. overhead on a simulated lossy channel
+ *
+ * Runs FecEncoder/FecDecoder from lib/ChaosShow against two channel
+ * models and prints one CSV row per (channel, loss, k, m):
+ *   - iid:   every packet dropped independently with probability p
+ *   - burst: Gilbert-Elliott channel with the same average loss, mean
+ *            burst length 3 packets (interference, a person walking
+ *            past the antenna, ...)
+ *
+ * Build & run (host):
+ *   g++ -O2 -Ilib/ChaosShow/src bench/fec_loss_bench.cpp \
+ *       lib/ChaosShow/src/FecCodec.cpp -o fec_bench && ./fec_bench
+ */
+
+#include "FecCodec.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+static const int BLOCKS = 20000;
+static const uint8_t PAYLOAD = 28;  // sizeof(LoRaMessage)
+
+static uint32_t rngState = 0x12345678;
+static uint32_t rng() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+static double rngUnit() { return (rng() & 0xFFFFFF) / (double)0x1000000; }
+
+// Channel model: returns true if the next packet is lost
+struct Channel {
+  bool bursty;
+  double p;
+  bool bad;
+
+  bool drop() {
+    if (!bursty) return rngUnit() < p;
+    // Gilbert-Elliott: bad state loses everything, mean burst = 3
+    const double leaveBad = 1.0 / 3.0;
+    double enterBad = p * leaveBad / (1.0 - p);
+    if (bad) {
+      if (rngUnit() < leaveBad) bad = false;
+    } else {
+      if (rngUnit() < enterBad) bad = true;
+    }
+    return bad;
+  }
+};
+
+static uint32_t delivered;
+static bool corrupt;
+static uint8_t expected[FEC_MAX_K][PAYLOAD];
+
+static void onCue(const uint8_t* payload, uint8_t len, bool recovered) {
+  (void)recovered;
+  uint8_t i = payload[0];
+  if (len != PAYLOAD || i >= FEC_MAX_K || memcmp(payload, expected[i], PAYLOAD) != 0) {
+    corrupt = true;
+  }
+  delivered++;
+}
+
+static void run(bool bursty, double p, uint8_t k, uint8_t m) {
+  FecEncoder enc;
+  FecDecoder dec;
+  enc.configure(k, m, PAYLOAD);
+  dec.onDeliver(onCue);
+
+  Channel ch = { bursty, p, false };
+  delivered = 0;
+  corrupt = false;
+
+  uint32_t plainDelivered = 0;
+  uint32_t sent = 0;
+  uint8_t packet[FEC_MAX_PACKET];
+
+  for (int blk = 0; blk < BLOCKS; blk++) {
+    for (uint8_t i = 0; i < k; i++) {
+      expected[i][0] = i;
+      for (uint8_t n = 1; n < PAYLOAD; n++) expected[i][n] = (uint8_t)rng();
+      size_t len = enc.addData(expected[i], packet);
+      sent++;
+      if (!ch.drop()) {
+        dec.receive(packet, len);
+        plainDelivered++;  // same loss pattern without FEC
+      }
+    }
+    for (uint8_t j = 0; j < enc.repairCount(); j++) {
+      size_t len = enc.makeRepair(j, packet);
+      sent++;
+      if (!ch.drop()) dec.receive(packet, len);
+    }
+    enc.closeBlock();
+  }
+
+  double cues = (double)BLOCKS * k;
+  printf("%s,%.2f,%u,%u,%.3f,%.5f,%.5f,%s\n",
+         bursty ? "burst" : "iid", p, k, m,
+         (double)(sent - cues) / cues,
+         plainDelivered / cues,
+         delivered / cues,
+         corrupt ? "CORRUPT" : "ok");
+}
+
+int main() {
+  static const double losses[] = { 0.05, 0.10, 0.20, 0.30 };
+  static const uint8_t configs[][2] = {
+    { 4, 1 }, { 4, 2 }, { 8, 2 }, { 8, 4 }, { 16, 4 }, { 16, 8 }
+  };
+
+  printf("channel,loss,k,m,overhead,delivery_plain,delivery_fec,check\n");
+  for (int b = 0; b < 2; b++) {
+    for (size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+      for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+        run(b == 1, losses[l], configs[c][0], configs[c][1]);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,395 @@
+/**
+ * ESP Chas TV - Fleet update simulation
+ *
+ * Runs FleetSender / FleetReceiver with 1, 10, 60 and 200 boards on a
+ * lossy broadcast channel and compares how long the whole fleet takes
+ * with updating the boards one after another.
+ *
+ * Objects:
+ *   config     a 60-entry fleet config blob
+ *   full       a 512 KB firmware image, sent whole
+ *   delta      the same image as a patch against the running version
+ *              (~2% of it edited, a few insertions and a deletion)
+ *   forged     the delta signed with the wrong fleet key: every board
+ *              must refuse it (check "ok" = nobody committed it)
+ *
+ * Channel model: every frame reaches each other node with 5% independent
+ * loss; the channel carries 2 frames per ms, frames beyond that in the
+ * same ms collide and reach nobody. NACKs are overheard by the other
+ * boards, so suppression works like on air.
+ *
+ * Prints CSV:
+ *   boards,object,payload_bytes,chunks,rounds,chunk_tx,repair_tx,nack_tx,
+ *   nacks_suppressed,fleet_s,one_by_one_s,updated,check
+ *
+ * fleet_s is the time until the last board committed (or, for forged,
+ * refused it); one_by_one_s is the single-board time times the number of
+ * boards. check is "ok" if every board's slot holds exactly the new
+ * image.
+ *
+ * The delta encoder here is the same block-match scheme as
+ * scripts/fleet_delta.py; patching uses the real receiver code.
+ *
+ * Build & run (host):
+ *   g++ -O2 -Ilib/ChaosShow/src bench/fleet_sim_bench.cpp \
+ *       lib/ChaosShow/src/FleetUpdate.cpp lib/ChaosShow/src/NodeConfig.cpp \
+ *       lib/ChaosShow/src/StateJournal.cpp lib/ChaosShow/src/Sha256.cpp \
+ *       -o fleet_bench && ./fleet_bench
+ */
+
+#include "BoardProfile.h"
+#include "FleetUpdate.h"
+#include "NodeConfig.h"
+
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+static const uint32_t SECTOR_SIZE = 4096;
+static const uint32_t IMAGE_SIZE = 512 * 1024;
+static const uint32_t LOSS_PERMILLE = 50;
+static const int FRAMES_PER_MS = 2;
+static const uint32_t TIME_LIMIT_MS = 15 * 60 * 1000;
+static const uint32_t OLD_VERSION = 7;
+static const uint32_t NEW_VERSION = 8;
+static const uint8_t FLEET_KEY[FLEET_KEY_SIZE] = {
+  0x3c, 0x91, 0x5e, 0x07, 0xa2, 0x6b, 0xd4, 0x18, 0xf0, 0x4d, 0x86, 0x2a, 0xc9, 0x73, 0x1e, 0xb5,
+  0x58, 0x0f, 0xe6, 0x9a, 0x31, 0xcd, 0x74, 0x2b, 0x8e, 0x45, 0xf9, 0x10, 0x67, 0xba, 0xd3, 0x02
+};
+static const uint8_t WRONG_KEY[FLEET_KEY_SIZE] = { 0x01 };
+
+static uint32_t rng = 0xF1EE7001;
+static uint32_t nextRand() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+// ---------------------------------------------------------------------------
+// Flash model
+// ---------------------------------------------------------------------------
+
+class NorFlash : public JournalStore {
+public:
+  explicit NorFlash(uint16_t sectors) : mem((size_t)sectors * SECTOR_SIZE, 0x00), _sectors(sectors) {}
+
+  uint32_t sectorSize() const { return SECTOR_SIZE; }
+  uint16_t sectorCount() const { return _sectors; }
+
+  bool read(uint32_t addr, void* buf, size_t len) {
+    if (addr + len > mem.size()) return false;
+    memcpy(buf, &mem[addr], len);
+    return true;
+  }
+  bool write(uint32_t addr, const void* buf, size_t len) {
+    if (addr + len > mem.size()) return false;
+    const uint8_t* p = (const uint8_t*)buf;
+    for (size_t i = 0; i < len; i++) mem[addr + i] &= p[i];
+    return true;
+  }
+  bool erase(uint16_t sector) {
+    memset(&mem[(size_t)sector * SECTOR_SIZE], 0xFF, SECTOR_SIZE);
+    return true;
+  }
+
+  std::vector<uint8_t> mem;
+
+private:
+  uint16_t _sectors;
+};
+
+// ---------------------------------------------------------------------------
+// Images and delta
+// ---------------------------------------------------------------------------
+
+static std::vector<uint8_t> makeOldImage() {
+  std::vector<uint8_t> img(IMAGE_SIZE);
+  for (size_t i = 0; i < img.size(); i++) img[i] = (uint8_t)nextRand();
+  return img;
+}
+
+// A release: scattered small edits, a few inserted functions, one removed
+static std::vector<uint8_t> makeNewImage(const std::vector<uint8_t>& old) {
+  std::vector<uint8_t> img(old);
+  for (int i = 0; i < 150; i++) {
+    size_t at = nextRand() % (img.size() - 64);
+    size_t n = 1 + nextRand() % 64;
+    for (size_t j = 0; j < n; j++) img[at + j] = (uint8_t)nextRand();
+  }
+  for (int i = 0; i < 3; i++) {
+    size_t at = nextRand() % img.size();
+    std::vector<uint8_t> add(1024 + nextRand() % 3072);
+    for (size_t j = 0; j < add.size(); j++) add[j] = (uint8_t)nextRand();
+    img.insert(img.begin() + at, add.begin(), add.end());
+  }
+  size_t cut = nextRand() % (img.size() - 2048);
+  img.erase(img.begin() + cut, img.begin() + cut + 2048);
+  return img;
+}
+
+static void put32(std::vector<uint8_t>& v, uint32_t x) {
+  for (int i = 0; i < 4; i++) v.push_back((uint8_t)(x >> (8 * i)));
+}
+
+static void flushAdd(std::vector<uint8_t>& delta, const uint8_t* p, size_t n) {
+  while (n) {
+    uint16_t k = (uint16_t)(n < 0xFFFF ? n : 0xFFFF);
+    delta.push_back(FLEET_OP_ADD);
+    delta.push_back((uint8_t)k);
+    delta.push_back((uint8_t)(k >> 8));
+    delta.insert(delta.end(), p, p + k);
+    p += k;
+    n -= k;
+  }
+}
+
+static uint64_t blockHash(const uint8_t* p, uint32_t n) {
+  uint64_t h = 1469598103934665603ull;
+  for (uint32_t i = 0; i < n; i++) h = (h ^ p[i]) * 1099511628211ull;
+  return h;
+}
+
+// Index the old image by aligned blocks, slide over the new one, grow
+// every hit as far as it matches
+static std::vector<uint8_t> makeDelta(const std::vector<uint8_t>& old, const std::vector<uint8_t>& img) {
+  const uint32_t B = 32;
+  std::unordered_map<uint64_t, uint32_t> blocks;
+  for (uint32_t o = 0; o + B <= old.size(); o += B) blocks.emplace(blockHash(&old[o], B), o);
+
+  std::vector<uint8_t> delta;
+  put32(delta, FLEET_DELTA_MAGIC);
+  size_t pos = 0, lit = 0;
+  while (pos + B <= img.size()) {
+    std::unordered_map<uint64_t, uint32_t>::const_iterator hit = blocks.find(blockHash(&img[pos], B));
+    if (hit == blocks.end() || memcmp(&old[hit->second], &img[pos], B) != 0) {
+      pos++;
+      continue;
+    }
+    size_t src = hit->second, at = pos;
+    while (at > lit && src > 0 && old[src - 1] == img[at - 1]) {
+      src--;
+      at--;
+    }
+    size_t end = pos + B, srcEnd = hit->second + B;
+    while (end < img.size() && srcEnd < old.size() && old[srcEnd] == img[end]) {
+      end++;
+      srcEnd++;
+    }
+    flushAdd(delta, &img[lit], at - lit);
+    delta.push_back(FLEET_OP_COPY);
+    put32(delta, (uint32_t)src);
+    put32(delta, (uint32_t)(end - at));
+    pos = lit = end;
+  }
+  flushAdd(delta, &img[lit], img.size() - lit);
+  return delta;
+}
+
+// ---------------------------------------------------------------------------
+// Radio
+// ---------------------------------------------------------------------------
+
+struct Frame {
+  int from;   // -1 = sender
+  std::vector<uint8_t> bytes;
+};
+
+static std::vector<Frame> air;
+
+struct Node {
+  int id;
+};
+
+static bool radioSend(void* ctx, const uint8_t* data, size_t len) {
+  Frame f;
+  f.from = ((Node*)ctx)->id;
+  f.bytes.assign(data, data + len);
+  air.push_back(f);
+  return true;
+}
+
+static bool lost() {
+  return nextRand() % 1000 < LOSS_PERMILLE;
+}
+
+// ---------------------------------------------------------------------------
+// Run
+// ---------------------------------------------------------------------------
+
+struct Object {
+  const char* name;
+  bool forged;
+  uint8_t kind;
+  std::vector<uint8_t> payload;
+  std::vector<uint8_t> image;
+};
+
+struct Result {
+  uint32_t rounds, chunkTx, repairTx, nackTx, suppressed;
+  uint32_t updated;
+  double fleetS;
+  bool check;
+};
+
+static const std::vector<uint8_t>* payload;
+
+static bool readPayload(void*, uint32_t offset, uint8_t* buf, size_t len) {
+  if (offset + len > payload->size()) return false;
+  memcpy(buf, &(*payload)[offset], len);
+  return true;
+}
+
+static uint32_t commits;
+static bool commitObject(void*, const FleetAnnounce&, JournalStore*) {
+  commits++;
+  return true;
+}
+
+static Result run(int boards, const Object& obj, NorFlash& base, uint32_t baseVersion) {
+  bool config = obj.kind == FLEET_CONFIG;
+  uint16_t sectors = (uint16_t)((obj.image.size() + SECTOR_SIZE - 1) / SECTOR_SIZE);
+  if (baseVersion) sectors += (uint16_t)((obj.payload.size() + SECTOR_SIZE - 1) / SECTOR_SIZE) + 1;
+
+  std::vector<Node> nodes(boards + 1);
+  std::vector<NorFlash*> slots(boards, 0);
+  std::vector<FleetRamSlot<FLEET_CONFIG_MAX>*> ramSlots(boards, 0);
+  std::vector<FleetReceiver*> rx(boards);
+  for (int i = 0; i < boards; i++) {
+    nodes[i].id = i;
+    rx[i] = new FleetReceiver();
+    rx[i]->begin(0x1000 + i, BOARD_HOST, radioSend, &nodes[i]);
+    rx[i]->setKey(FLEET_KEY);
+    JournalStore* slot;
+    if (config) slot = ramSlots[i] = new FleetRamSlot<FLEET_CONFIG_MAX>();
+    else slot = slots[i] = new NorFlash(sectors);
+    rx[i]->accept(obj.kind, slot, config ? 0 : &base, config ? 0 : OLD_VERSION, commitObject);
+  }
+  nodes[boards].id = -1;
+
+  FleetSender tx;
+  tx.begin(0xAA, radioSend, &nodes[boards]);
+  payload = &obj.payload;
+  FleetOffer offer;
+  offer.kind = obj.kind;
+  offer.board = config ? FLEET_ANY_BOARD : BOARD_HOST;
+  offer.version = NEW_VERSION;
+  offer.baseVersion = baseVersion;
+  offer.payloadSize = (uint32_t)obj.payload.size();
+  offer.payloadCrc = fleetCrc32(0, &obj.payload[0], obj.payload.size());
+  offer.imageSize = (uint32_t)obj.image.size();
+  offer.imageCrc = fleetCrc32(0, &obj.image[0], obj.image.size());
+  fleetTag(obj.forged ? WRONG_KEY : FLEET_KEY, offer.kind, offer.board, offer.version,
+           &obj.image[0], offer.imageSize, offer.tag);
+
+  commits = 0;
+  air.clear();
+  tx.offer(offer, readPayload, 0, 0);
+  Result r;
+  memset(&r, 0, sizeof(r));
+  r.fleetS = -1;
+
+  for (uint32_t now = 0; now < TIME_LIMIT_MS; now++) {
+    tx.update(now);
+    int refused = 0;
+    for (int i = 0; i < boards; i++) {
+      rx[i]->update(now);
+      refused += !rx[i]->receiving() && rx[i]->lastStatus() == FLEET_BAD_TAG;
+    }
+    if ((commits == (uint32_t)boards || refused == boards) && r.fleetS < 0) r.fleetS = now / 1000.0;
+
+    // Sender first; past FRAMES_PER_MS everything in this ms collides
+    int onAir = 0;
+    for (size_t f = 0; f < air.size(); f++) {
+      if (air[f].from >= 0) {
+        r.nackTx += air[f].bytes.size() > 1 && air[f].bytes[1] == FLEET_NACK;
+      }
+      if (++onAir > FRAMES_PER_MS) continue;
+      const Frame& fr = air[f];
+      if (fr.from >= 0 && !lost()) tx.onMessage(&fr.bytes[0], fr.bytes.size());
+      for (int i = 0; i < boards; i++) {
+        if (i != fr.from && !lost()) rx[i]->onMessage(&fr.bytes[0], fr.bytes.size(), now);
+      }
+    }
+    air.clear();
+
+    if (!tx.active() && r.fleetS >= 0) break;
+  }
+
+  const FleetSenderStats& s = tx.stats();
+  r.rounds = s.rounds;
+  r.chunkTx = s.chunks;
+  r.repairTx = s.repairs;
+  r.updated = commits;
+  r.check = commits == (obj.forged ? 0u : (uint32_t)boards);
+  for (int i = 0; i < boards; i++) {
+    r.suppressed += rx[i]->stats().nacksSuppressed;
+    const uint8_t* got = config ? ramSlots[i]->data() : &slots[i]->mem[0];
+    if (!obj.forged && memcmp(got, &obj.image[0], obj.image.size()) != 0) r.check = false;
+    delete rx[i];
+    delete slots[i];
+    delete ramSlots[i];
+  }
+  return r;
+}
+
+int main() {
+  Object objects[4];
+
+  FleetConfigEntry entries[60];
+  for (int i = 0; i < 60; i++) {
+    entries[i].node = i == 0 ? 0 : 0x1000 + i;
+    entries[i].role = ROLE_RECEIVER;
+    entries[i].reserved = 0;
+    entries[i].device = (uint16_t)(i + 1);
+    entries[i].groups = 1u << (i % 8);
+  }
+  uint8_t blob[FLEET_CONFIG_MAX];
+  size_t blobLen = fleetConfigBuild(entries, 60, blob, sizeof(blob));
+  objects[0].name = "config";
+  objects[0].forged = false;
+  objects[0].kind = FLEET_CONFIG;
+  objects[0].payload.assign(blob, blob + blobLen);
+  objects[0].image = objects[0].payload;
+
+  std::vector<uint8_t> oldImage = makeOldImage();
+  std::vector<uint8_t> newImage = makeNewImage(oldImage);
+  objects[1].name = "full";
+  objects[1].forged = false;
+  objects[1].kind = FLEET_FIRMWARE;
+  objects[1].payload = newImage;
+  objects[1].image = newImage;
+  objects[2].name = "delta";
+  objects[2].forged = false;
+  objects[2].kind = FLEET_FIRMWARE;
+  objects[2].payload = makeDelta(oldImage, newImage);
+  objects[2].image = newImage;
+  objects[3] = objects[2];
+  objects[3].name = "forged";
+  objects[3].forged = true;
+
+  NorFlash base((uint16_t)((oldImage.size() + SECTOR_SIZE - 1) / SECTOR_SIZE));
+  for (uint16_t s = 0; s < base.sectorCount(); s++) base.erase(s);
+  base.write(0, &oldImage[0], oldImage.size());
+
+  printf("boards,object,payload_bytes,chunks,rounds,chunk_tx,repair_tx,nack_tx,"
+         "nacks_suppressed,fleet_s,one_by_one_s,updated,check\n");
+  const int boardCounts[] = { 1, 10, 60, 200 };
+  for (int o = 0; o < 4; o++) {
+    const Object& obj = objects[o];
+    uint32_t baseVersion = o >= 2 ? OLD_VERSION : 0;
+    double single = 0;
+    for (size_t b = 0; b < sizeof(boardCounts) / sizeof(boardCounts[0]); b++) {
+      int boards = boardCounts[b];
+      Result r = run(boards, obj, base, baseVersion);
+      if (boards == 1) single = r.fleetS;
+      printf("%d,%s,%u,%u,%u,%u,%u,%u,%u,%.2f,%.2f,%u,%s\n",
+             boards, obj.name, (unsigned)obj.payload.size(),
+             (unsigned)((obj.payload.size() + FLEET_CHUNK_SIZE - 1) / FLEET_CHUNK_SIZE),
+             r.rounds, r.chunkTx, r.repairTx, r.nackTx, r.suppressed,
+             r.fleetS, single * boards, r.updated, r.check ? "ok" : "FAIL");
+    }
+  }
+  return 0;
+}
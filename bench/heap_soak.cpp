@@ -0,0 +1,472 @@
+/**
+ * ESP Chas TV - Heap soak
+ *
+ * Replays a festival-length show (default 8 hours) through the handlers
+ * the sketches run, on a master board and a fixture:
+ * - src/main.cpp's web routes: "/" renders the control page into the
+ *   shared page buffer, the buttons run the executor and record the
+ *   command; loop() saves the show state and flushes the command log
+ *   (PartitionStore on the shim "cmdlog" partition).
+ * - The mesh sketch's console: cues parsed by SerialConsole, sent as
+ *   ShowFrames by MeshRouter, logged and run locally.
+ * - The fixture's receive path: the ESP-NOW callback copies each frame
+ *   into the static rx_frame queue, radioWork() drains it into the
+ *   router, and meshDeliver() filters, decodes and executes the cue.
+ * The WiFi, WebServer and ESP-NOW stacks themselves are ESP-IDF code
+ * and are not modelled.
+ *
+ * Every operator new goes to a first-fit heap model the size of an
+ * ESP32's free heap, so fragmentation shows up the way it would on the
+ * device. Before the show starts the soak checks that the hook really
+ * sees an allocation. Every simulated 30 minutes it prints CSV:
+ *   minute,cues,requests,heap_used,largest_free,allocs
+ *
+ * The run FAILs (exit 1) unless heap_used, largest_free and allocs stay
+ * exactly where they were after setup.
+ *
+ * `--legacy` puts back the String-style code the sketches had (a growing
+ * page per request, string scene labels and "Sent command" messages) -
+ * that run FAILs, showing what the check catches.
+ *
+ * Build & run (host):
+ *   g++ -O2 -Ibench/shim -Ilib/ChaosShow/src bench/heap_soak.cpp \
+ *       lib/ChaosShow/src/CommandLog.cpp lib/ChaosShow/src/ControlPage.cpp \
+ *       lib/ChaosShow/src/MeshRouter.cpp lib/ChaosShow/src/PartitionStore.cpp \
+ *       lib/ChaosShow/src/SerialConsole.cpp lib/ChaosShow/src/ShowCommand.cpp \
+ *       lib/ChaosShow/src/ShowExecutor.cpp lib/ChaosShow/src/ShowStateStore.cpp \
+ *       lib/ChaosShow/src/StateJournal.cpp -o heap_soak && ./heap_soak
+ */
+
+#include "BoardProfile.h"
+#include "CommandLog.h"
+#include "ControlPage.h"
+#include "FixedString.h"
+#include "MeshRouter.h"
+#include "PartitionStore.h"
+#include "SerialConsole.h"
+#include "ShowCommand.h"
+#include "ShowExecutor.h"
+#include "ShowStateStore.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+static const size_t HEAP_SIZE = 160 * 1024;   // Typical free heap with WiFi up
+static const uint32_t CUE_MS = 500;           // A console cue every half second
+static const uint32_t PAGE_MS = 5000;         // Page refresh every 5 s
+static const uint32_t BUTTON_MS = 20000;      // A button press every 20 s or so
+static const uint32_t SAMPLE_MS = 30UL * 60 * 1000;
+
+// ---------------------------------------------------------------------------
+// First-fit heap model
+// ---------------------------------------------------------------------------
+
+struct Block {
+  size_t size;     // Payload bytes
+  bool free;
+  Block* next;
+};
+
+static unsigned char heap[HEAP_SIZE];
+static Block* heapHead = 0;
+static size_t heapUsed = 0;
+static unsigned long allocCount = 0;
+
+static size_t align8(size_t n) {
+  return (n + 7) & ~(size_t)7;
+}
+
+static void heapInit() {
+  heapHead = (Block*)heap;
+  heapHead->size = HEAP_SIZE - sizeof(Block);
+  heapHead->free = true;
+  heapHead->next = 0;
+}
+
+static void* heapAlloc(size_t n) {
+  if (!heapHead) heapInit();
+  n = align8(n ? n : 1);
+
+  for (Block* b = heapHead; b; b = b->next) {
+    if (!b->free || b->size < n) continue;
+    if (b->size >= n + sizeof(Block) + 8) {
+      Block* rest = (Block*)((unsigned char*)(b + 1) + n);
+      rest->size = b->size - n - sizeof(Block);
+      rest->free = true;
+      rest->next = b->next;
+      b->next = rest;
+      b->size = n;
+    }
+    b->free = false;
+    heapUsed += b->size;
+    allocCount++;
+    return b + 1;
+  }
+  return 0;
+}
+
+static void heapFree(void* p) {
+  if (!p) return;
+  Block* b = (Block*)p - 1;
+  b->free = true;
+  heapUsed -= b->size;
+
+  // Coalesce neighbours (the list is in address order)
+  for (Block* c = heapHead; c; c = c->next) {
+    while (c->free && c->next && c->next->free) {
+      c->size += sizeof(Block) + c->next->size;
+      c->next = c->next->next;
+    }
+  }
+}
+
+static size_t largestFree() {
+  if (!heapHead) heapInit();
+  size_t best = 0;
+  for (Block* b = heapHead; b; b = b->next) {
+    if (b->free && b->size > best) best = b->size;
+  }
+  return best;
+}
+
+void* operator new(size_t n) {
+  void* p = heapAlloc(n);
+  if (!p) {
+    fprintf(stderr, "heap exhausted (%zu bytes used)\n", heapUsed);
+    abort();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { heapFree(p); }
+void operator delete(void* p, size_t) noexcept { heapFree(p); }
+
+
+// ---------------------------------------------------------------------------
+// Master board - src/main.cpp's web routes and the mesh sketch's console
+// ---------------------------------------------------------------------------
+
+static bool legacy = false;
+static uint32_t now = 0;
+static unsigned long cues = 0;
+static unsigned long requests = 0;
+static unsigned long delivered = 0;
+static unsigned long rxDropped = 0;
+static unsigned long truncatedPages = 0;
+static unsigned long legacyBytes = 0;   // Keeps the legacy strings from being optimized out
+
+static ShowExecutor executor;
+static SerialConsole console;
+static MeshRouter master;
+static ShowStateStore stateStore;
+static PartitionStore logStore;
+static CommandRecorder recorder;
+static uint32_t messageCounter = 0;
+static int32_t viewerCount = 0;
+
+static FixedString<32> currentScene = "Welcome";
+static FixedString<CONTROL_PAGE_SIZE> page;
+static std::string* legacyScene = 0;
+
+static const char* const sceneNames[] = {
+  "Welcome", "Scene 1: Introduction", "Scene 2: Main Act", "Scene 3: Finale"
+};
+#define SCENE_NAME_COUNT (sizeof(sceneNames) / sizeof(sceneNames[0]))
+
+static void setScene(const char* label, int32_t n) {
+  if (legacy) {
+    // The old `String currentScene`
+    *legacyScene = label;
+    if (n >= 0) *legacyScene += std::to_string(n);
+    return;
+  }
+  currentScene = label;
+  if (n >= 0) currentScene += n;
+}
+
+static void onShowStart(const ShowCommand&, void*) { setScene("Opening", -1); }
+static void onShowStop(const ShowCommand&, void*)  { setScene("Ended", -1); }
+static void onScene(const ShowCommand& cmd, void*) {
+  if (cmd.value1 >= 0 && (size_t)cmd.value1 < SCENE_NAME_COUNT) setScene(sceneNames[cmd.value1], -1);
+  else setScene("Scene ", cmd.value1);
+}
+
+static void runCommand(uint8_t id, int32_t value1 = 0) {
+  ShowCommand cmd = { id, value1, 0 };
+  bool ok = executor.execute(cmd, now);
+  recorder.record(cmd, SOURCE_WEB, ok ? OUTCOME_EXECUTED : OUTCOME_REJECTED, now * 1000);
+}
+
+static void handleRoot() {
+  if (legacy) {
+    // The old handleRoot(): one growing String per request
+    std::string html = "<!DOCTYPE html><html><head>";
+    for (int i = 0; i < 24; i++) html += "<div class='card'>..........................................................</div>";
+    html += "<div class='status'>📺 Show Status: <strong>" + std::string(executor.state().showRunning ? "LIVE" : "Off Air") + "</strong></div>";
+    html += "<div class='status'>👥 Viewers: <strong>" + std::to_string(viewerCount) + "</strong></div>";
+    html += "<div class='status'>🎭 Current Scene: <strong>" + *legacyScene + "</strong></div>";
+    html += "</body></html>";
+    legacyBytes += html.size();
+    viewerCount++;
+    return;
+  }
+
+  ControlPageInfo info;
+  info.showRunning = executor.state().showRunning;
+  info.viewers = viewerCount;
+  info.scene = currentScene.c_str();
+  info.ip = "192.168.4.1";
+  info.freeHeap = (uint32_t)(HEAP_SIZE - heapUsed);
+  info.largestBlock = (uint32_t)largestFree();
+  renderControlPage(page, info);
+  if (page.truncated()) truncatedPages++;
+  viewerCount++;
+}
+
+static void handleStart()  { runCommand(CMD_SHOW_START); }
+static void handleStop()   { runCommand(CMD_SHOW_STOP); }
+static void handleScene1() { runCommand(CMD_SCENE, 1); }
+static void handleScene2() { runCommand(CMD_SCENE, 2); }
+static void handleScene3() { runCommand(CMD_SCENE, 3); }
+
+// What server.on() registers; WebServer itself isn't modelled
+struct Route {
+  const char* path;
+  void (*handler)();
+};
+
+static const Route routes[] = {
+  { "/", handleRoot }, { "/start", handleStart }, { "/stop", handleStop },
+  { "/scene1", handleScene1 }, { "/scene2", handleScene2 }, { "/scene3", handleScene3 },
+};
+#define ROUTE_COUNT (sizeof(routes) / sizeof(routes[0]))
+
+static void serve(const char* path) {
+  for (size_t i = 0; i < ROUTE_COUNT; i++) {
+    if (strcmp(routes[i].path, path) == 0) {
+      routes[i].handler();
+      requests++;
+      return;
+    }
+  }
+}
+
+// The mesh sketch's sendCommand()
+static void sendCommand(uint8_t id, int32_t val1) {
+  ShowCommand cmd = { id, val1, 0 };
+  ShowFrame frame;
+  showFrameEncode(frame, cmd, 1, messageCounter++, now);
+
+  bool sent = master.send(MESH_BROADCAST, (const uint8_t*)&frame, sizeof(frame), now);
+  recorder.record(cmd, SOURCE_SERIAL, sent ? OUTCOME_SENT : OUTCOME_SEND_FAILED, now * 1000);
+  executor.execute(cmd, now);
+  cues++;
+
+  if (legacy) {
+    // The old `"📤 Sent command: " + String(cmd)`
+    std::string msg = "📤 Sent command: " + std::string(showCommandName(id));
+    legacyBytes += msg.size();
+  }
+}
+
+static void cStart(uint8_t, char**, void*)           { sendCommand(CMD_SHOW_START, 0); }
+static void cStop(uint8_t, char**, void*)            { sendCommand(CMD_SHOW_STOP, 0); }
+static void cOn(uint8_t, char**, void*)              { sendCommand(CMD_LED_ON, 0); }
+static void cScene(uint8_t, char* argv[], void*)     { sendCommand(CMD_SCENE, consoleInt(argv[1])); }
+static void cPattern(uint8_t, char* argv[], void*)   { sendCommand(CMD_PATTERN, consoleInt(argv[1])); }
+
+static const ConsoleCommand commands[] = {
+  { "start", cStart }, { "stop", cStop }, { "on", cOn },
+  { "scene", cScene }, { "pattern", cPattern },
+};
+
+// ---------------------------------------------------------------------------
+// Fixture - the mesh sketch's receive path
+// ---------------------------------------------------------------------------
+
+// Frame handed from the ESP-NOW callback to radioWork()
+struct rx_frame {
+  uint8_t mac[6];
+  uint8_t len;
+  uint8_t data[MESH_MAX_FRAME];
+};
+
+// xQueueCreateStatic() over the same storage the sketch reserves
+static rx_frame rxQueueStorage[Board::rxQueueLen];
+static uint8_t rxHead = 0;
+static uint8_t rxCount = 0;
+
+static MeshRouter fixture;
+static ShowExecutor fixtureExecutor;
+static unsigned long filteredCount = 0;
+
+static void OnDataRecv(const uint8_t* mac, const uint8_t* data, int len) {
+  if (len <= 0 || len > MESH_MAX_FRAME) return;
+  if (rxCount == Board::rxQueueLen) {
+    rxDropped++;
+    return;
+  }
+
+  rx_frame& frame = rxQueueStorage[(rxHead + rxCount) % Board::rxQueueLen];
+  memcpy(frame.mac, mac, 6);
+  frame.len = (uint8_t)len;
+  memcpy(frame.data, data, len);
+  rxCount++;
+}
+
+static void radioWork() {
+  while (rxCount) {
+    rx_frame frame = rxQueueStorage[rxHead];
+    rxHead = (rxHead + 1) % Board::rxQueueLen;
+    rxCount--;
+    fixture.onFrame(frame.mac, frame.data, frame.len, now);
+  }
+  fixture.update(now);
+}
+
+static void meshDeliver(void*, const MeshHeader& hdr, const uint8_t* payload) {
+  if (!showFrameForMe(payload, hdr.len, fixtureExecutor.state().address)) {
+    filteredCount++;
+    return;
+  }
+
+  ShowFrame msg;
+  if (!showFrameDecode(payload, hdr.len, msg)) return;
+  if (fixtureExecutor.execute(showFrameCommand(msg), now)) delivered++;
+}
+
+// Master -> fixture over a perfect link
+static void masterSend(void*, const uint8_t*, const uint8_t* frame, size_t len) {
+  static const uint8_t masterMac[6] = { 2, 0, 1, 0, 0, 0 };
+  OnDataRecv(masterMac, frame, (int)len);
+}
+static void fixtureSend(void*, const uint8_t*, const uint8_t*, size_t) {}
+static void masterDeliver(void*, const MeshHeader&, const uint8_t*) {}
+
+// ---------------------------------------------------------------------------
+// Soak
+// ---------------------------------------------------------------------------
+
+static uint32_t rng = 0x9E3779B9;
+static uint32_t nextRand() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+// A flat heap only means something if allocations are actually counted
+static bool heapHooked() {
+  unsigned long allocs = allocCount;
+  size_t used = heapUsed;
+  void* p = ::operator new(64);
+  bool counted = allocCount == allocs + 1 && heapUsed >= used + 64;
+  ::operator delete(p);
+  return counted && heapUsed == used;
+}
+
+static void setup() {
+  if (legacy) legacyScene = new std::string("Welcome");
+
+  executor.on(CMD_SHOW_START, onShowStart);
+  executor.on(CMD_SHOW_STOP, onShowStop);
+  executor.on(CMD_SCENE, onScene);
+  stateStore.begin();
+  stateStore.restore(executor, now);
+
+  bool logOk = logStore.begin(CMDLOG_PARTITION, CMDLOG_MAX_SECTORS);
+  recorder.begin(logOk ? &logStore : 0, 0);
+
+  console.begin(commands, sizeof(commands) / sizeof(commands[0]));
+  master.begin(1, masterSend, masterDeliver);
+  fixture.begin(2, fixtureSend, meshDeliver);
+}
+
+int main(int argc, char** argv) {
+  double hours = 8;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--legacy") == 0) legacy = true;
+    else hours = atof(argv[i]);
+  }
+
+  if (!heapHooked()) {
+    printf("# FAIL: operator new is not reaching the heap model\n");
+    return 1;
+  }
+  setup();
+  if (!recorder.hasStore()) {
+    printf("# FAIL: no cmdlog partition\n");
+    return 1;
+  }
+
+  const uint32_t endMs = (uint32_t)(hours * 3600.0 * 1000.0);
+  uint32_t nextCue = 0, nextPage = 0, nextButton = BUTTON_MS, nextSample = 0;
+  const size_t baseUsed = heapUsed;
+  const size_t baseLargest = largestFree();
+  const unsigned long baseAllocs = allocCount;
+  bool flat = true;
+
+  printf("minute,cues,requests,heap_used,largest_free,allocs\n");
+
+  for (now = 0; now <= endMs; now += 10) {
+    if (now >= nextCue) {
+      // A scripted console line, delivered in two partial reads
+      char line[32];
+      switch (nextRand() % 6) {
+        case 0:  snprintf(line, sizeof(line), "start\r\n"); break;
+        case 1:  snprintf(line, sizeof(line), "stop\r\n"); break;
+        case 2:  snprintf(line, sizeof(line), "on\n"); break;
+        case 3:  snprintf(line, sizeof(line), "pattern %u\n", (unsigned)(nextRand() % 4)); break;
+        default: snprintf(line, sizeof(line), "scene%u\n", (unsigned)(nextRand() % 12)); break;
+      }
+      size_t len = strlen(line);
+      size_t split = nextRand() % len;
+      console.push(line, split);
+      console.push(line + split, len - split);
+      nextCue += CUE_MS;
+    }
+
+    if (now >= nextButton) {
+      // A button, then the browser follows the redirect back to "/"
+      serve(routes[1 + nextRand() % (ROUTE_COUNT - 1)].path);
+      serve("/");
+      nextButton += BUTTON_MS / 2 + nextRand() % BUTTON_MS;
+    }
+
+    if (now >= nextPage) {
+      serve("/");
+      nextPage += PAGE_MS;
+    }
+
+    // Both loop()s
+    master.update(now);
+    radioWork();
+    stateStore.update(executor);
+    recorder.flush();
+    executor.ledLevel(now);
+    fixtureExecutor.ledLevel(now);
+
+    if (now >= nextSample) {
+      size_t largest = largestFree();
+      printf("%lu,%lu,%lu,%zu,%zu,%lu\n", (unsigned long)(now / 60000), cues, requests,
+             heapUsed, largest, allocCount);
+      if (heapUsed != baseUsed || largest != baseLargest || allocCount != baseAllocs) {
+        flat = false;
+      }
+      nextSample += SAMPLE_MS;
+    }
+  }
+
+  const CommandLogStats& log = recorder.stats();
+  bool ok = flat && delivered == cues && rxDropped == 0 && filteredCount == 0 &&
+            console.stats().unknown == 0 && log.overflow == 0 && truncatedPages == 0;
+  printf("# %s%s: heap_used %zu, largest_free %zu, %lu allocations after setup, "
+         "%lu/%lu cues delivered, %lu requests, %lu records logged\n",
+         ok ? "PASS" : "FAIL", legacy ? " (legacy)" : "", heapUsed, largestFree(),
+         allocCount - baseAllocs, delivered, cues, requests, (unsigned long)recorder.stored());
+  if (legacy) printf("# legacy: %lu bytes of strings built\n", legacyBytes);
+  return ok ? 0 : 1;
+}
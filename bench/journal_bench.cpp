@@ -0,0 +1,164 @@
+/**
+ * ESP Chas TV - State journal power-cut test
+ *
+ * Runs StateJournal on a RAM model of NOR flash (erase sets 0xFF, writes
+ * only clear bits) and pulls the plug at random points: in the middle of
+ * a record write, a sector header write or a sector erase. After every
+ * cut it remounts, like a fixture rebooting, and checks the restored
+ * state is the last completed save or the one that was being written -
+ * never anything older, never garbage.
+ *
+ * Prints CSV:
+ *   sectors,changes,power_cuts,restore_ok,torn_seen,erases,
+ *   min_sector_erases,max_sector_erases,max_slots_scanned,mount_us
+ *
+ * min/max_sector_erases show wear levelling; max_slots_scanned and
+ * mount_us (host time per mount) bound the restore cost at boot.
+ *
+ * Build & run (host):
+ *   g++ -O2 -Ilib/ChaosShow/src bench/journal_bench.cpp \
+ *       lib/ChaosShow/src/StateJournal.cpp -o journal_bench && ./journal_bench
+ */
+
+#include "StateJournal.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const uint32_t SECTOR_SIZE = 4096;
+static const int CHANGES = 200000;
+static const uint32_t CUT_ONE_IN = 500;   // Chance of a cut per flash operation
+
+struct PowerCut {};
+
+static uint32_t rng = 0xC0FFEE11;
+static uint32_t nextRand() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+class NorFlash : public JournalStore {
+public:
+  explicit NorFlash(uint16_t sectors)
+    : mem(sectors * SECTOR_SIZE, 0x00), eraseCount(sectors, 0), _sectors(sectors) {}
+
+  uint32_t sectorSize() const { return SECTOR_SIZE; }
+  uint16_t sectorCount() const { return _sectors; }
+
+  bool read(uint32_t addr, void* buf, size_t len) {
+    memcpy(buf, &mem[addr], len);
+    return true;
+  }
+
+  bool write(uint32_t addr, const void* buf, size_t len) {
+    size_t cut = maybeCut(len);
+    const uint8_t* p = (const uint8_t*)buf;
+    for (size_t i = 0; i < len && i < cut; i++) mem[addr + i] &= p[i];
+    if (cut < len) throw PowerCut();
+    return true;
+  }
+
+  bool erase(uint16_t sector) {
+    size_t cut = maybeCut(SECTOR_SIZE);
+    eraseCount[sector]++;
+    uint8_t* s = &mem[sector * SECTOR_SIZE];
+    if (cut < SECTOR_SIZE) {
+      // Interrupted erase: some bytes erased, the rest left as they were
+      for (size_t i = 0; i < cut; i++) s[nextRand() % SECTOR_SIZE] = 0xFF;
+      throw PowerCut();
+    }
+    memset(s, 0xFF, SECTOR_SIZE);
+    return true;
+  }
+
+  bool armed;
+  std::vector<uint8_t> mem;
+  std::vector<uint32_t> eraseCount;
+
+private:
+  // Bytes that make it before the power goes (len = no cut)
+  size_t maybeCut(size_t len) {
+    if (!armed || nextRand() % CUT_ONE_IN) return len;
+    return nextRand() % len;
+  }
+
+  uint16_t _sectors;
+};
+
+static void run(uint16_t sectors) {
+  NorFlash flash(sectors);   // Starts as garbage (0x00), not erased
+  flash.armed = true;
+
+  StateJournal journal;
+  journal.mount(&flash);
+
+  uint32_t committed = 0;
+  bool haveCommitted = false;
+  long cuts = 0, ok = 0, torn = 0, mounts = 0;
+  uint16_t maxScanned = 0;
+  double mountNs = 0;
+  uint32_t erases = 0;
+
+  for (int i = 0; i < CHANGES; i++) {
+    uint32_t value = nextRand();
+    uint8_t blob[12];
+    for (int b = 0; b < 12; b++) blob[b] = (uint8_t)(value >> (b % 4 * 8));
+
+    try {
+      if (journal.save(blob, sizeof(blob))) {
+        committed = value;
+        haveCommitted = true;
+      }
+      continue;
+    } catch (const PowerCut&) {
+      cuts++;
+    }
+
+    // Reboot: remount from flash only
+    erases += journal.stats().erases;
+    flash.armed = false;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    journal = StateJournal();
+    journal.mount(&flash);
+    mountNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    mounts++;
+    flash.armed = true;
+
+    if (journal.stats().scanned > maxScanned) maxScanned = journal.stats().scanned;
+    torn += journal.stats().torn;
+
+    uint8_t got[12];
+    bool loaded = journal.load(got, sizeof(got));
+    uint32_t v = 0;
+    if (loaded) memcpy(&v, got, 4);
+
+    if ((!haveCommitted && !loaded) || (loaded && (v == committed || v == value))) ok++;
+    if (loaded) {
+      committed = v;
+      haveCommitted = true;
+    }
+  }
+  erases += journal.stats().erases;
+
+  uint32_t minE = flash.eraseCount[0], maxE = flash.eraseCount[0];
+  for (uint16_t s = 1; s < sectors; s++) {
+    if (flash.eraseCount[s] < minE) minE = flash.eraseCount[s];
+    if (flash.eraseCount[s] > maxE) maxE = flash.eraseCount[s];
+  }
+
+  printf("%u,%d,%ld,%ld,%ld,%u,%u,%u,%u,%.1f\n", sectors, CHANGES, cuts, ok, torn,
+         erases, minE, maxE, maxScanned, mounts ? mountNs / mounts / 1000.0 : 0.0);
+}
+
+int main() {
+  printf("sectors,changes,power_cuts,restore_ok,torn_seen,erases,"
+         "min_sector_erases,max_sector_erases,max_slots_scanned,mount_us\n");
+  run(2);
+  run(4);
+  run(16);
+  return 0;
+}
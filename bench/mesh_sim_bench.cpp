@@ -0,0 +1,328 @@
+/**
+ * ESP Chas TV - ESP-NOW mesh simulator
+ *
+ * Drops 10 / 100 / 500 virtual nodes at random on a venue floor (average
+ * 12 neighbours each) and runs the real MeshRouter from lib/ChaosShow
+ * on every node. The radio model is a shared 1 Mbps channel with carrier
+ * sense, half-duplex nodes, hidden-terminal collisions and 2% random
+ * loss. Unicast frames get up to 3 link-layer retries, like ESP-NOW's
+ * acknowledged unicast; broadcasts get none.
+ *
+ * For each size it floods cues from node 0 and then sends a unicast
+ * reply back to node 0 from a random node, and prints CSV:
+ *   coverage       - fraction of reachable nodes that got the flood
+ *   tx_per_flood   - radio transmissions per flood
+ *   amplification  - tx_per_flood / nodes (1.0 = every node sent once)
+ *   per_hop_ms     - mean delivery latency divided by hop count
+ *   p95_ms         - 95th percentile flood delivery latency
+ *   unicast_*      - reverse-path unicast success / transmissions
+ *
+ * Modes compare plain flooding (no jitter, no suppression) with the
+ * default jittered + suppressed rebroadcast.
+ *
+ * Build & run (host):
+ *   g++ -O2 -Ilib/ChaosShow/src bench/mesh_sim_bench.cpp \
+ *       lib/ChaosShow/src/MeshRouter.cpp -o mesh_bench && ./mesh_bench
+ */
+
+#include "MeshRouter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+static const int FLOODS = 20;
+static const double AVG_DEGREE = 12.0;
+static const double LOSS = 0.02;
+static const uint64_t PROC_US = 300;     // recv callback -> loop() -> router
+static const uint64_t STEP_US = 100;
+static const int UNICAST_RETRIES = 3;
+
+static uint32_t rngState = 0xC0FFEE;
+static uint32_t rng() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+static double rngUnit() { return (rng() & 0xFFFFFF) / (double)0x1000000; }
+
+// ESP-NOW at 1 Mbps: long preamble + MAC/vendor overhead + payload
+static uint64_t airtimeUs(size_t len) { return 192 + (len + 43) * 8; }
+
+struct Frame {
+  int dest;  // -1 = broadcast
+  int retries;
+  std::vector<uint8_t> bytes;
+};
+
+struct Rx {
+  int from;
+  int to;
+  uint64_t end;
+  bool corrupted;
+  Frame frame;
+};
+
+struct Node {
+  MeshRouter router;
+  uint8_t mac[6];
+  double x, y;
+  std::vector<int> neighbours;
+  std::deque<Frame> txQueue;
+  uint64_t txUntil;
+  uint64_t nextTry;
+  uint64_t busyUntil;    // Channel heard busy until
+  int currentRx;         // Index into rxList, -1 = none
+  uint64_t deliveredAt;
+  int hops;
+};
+
+static std::vector<Node> nodes;
+static std::vector<Rx> rxList;
+static uint64_t nowUs;
+static uint32_t transmissions;
+static int unicastTarget = -1;
+static bool unicastArrived;
+static int unicastHops;
+
+static int macToIndex(const uint8_t* mac) { return (mac[4] << 8) | mac[5]; }
+
+static void onSend(void* ctx, const uint8_t* mac, const uint8_t* frame, size_t len) {
+  Node* n = (Node*)ctx;
+  Frame f;
+  f.dest = mac ? macToIndex(mac) : -1;
+  f.retries = 0;
+  f.bytes.assign(frame, frame + len);
+  n->txQueue.push_back(f);
+}
+
+static void onDeliver(void* ctx, const MeshHeader& hdr, const uint8_t* payload) {
+  (void)payload;
+  Node* n = (Node*)ctx;
+  if (hdr.dest == MESH_BROADCAST) {
+    if (!n->deliveredAt) {
+      n->deliveredAt = nowUs;
+      n->hops = hdr.hops + 1;
+    }
+  } else if ((int)(n - &nodes[0]) == unicastTarget) {
+    unicastArrived = true;
+    unicastHops = hdr.hops + 1;
+  }
+}
+
+static void buildVenue(int count, uint32_t seed, uint8_t jitter, uint8_t suppress) {
+  rngState = seed * 2654435761UL ^ 0x5BD1E995;
+  for (int i = 0; i < 16; i++) rng();
+  nodes.clear();
+  nodes.resize(count);
+  rxList.clear();
+
+  // Radio range 1.0; pick the floor size for the target density
+  double side = std::sqrt(count * M_PI / AVG_DEGREE);
+  for (int i = 0; i < count; i++) {
+    Node& n = nodes[i];
+    uint8_t mac[6] = { 0x02, 0xCA, 0x05, 0x00, (uint8_t)(i >> 8), (uint8_t)i };
+    memcpy(n.mac, mac, 6);
+    n.x = rngUnit() * side;
+    n.y = rngUnit() * side;
+    n.router.begin(i + 1, onSend, onDeliver, &n);
+    n.router.setTtl(32);
+    n.router.setJitter(jitter);
+    n.router.setSuppressCount(suppress);
+  }
+  for (int i = 0; i < count; i++) {
+    for (int j = 0; j < count; j++) {
+      double dx = nodes[i].x - nodes[j].x, dy = nodes[i].y - nodes[j].y;
+      if (i != j && dx * dx + dy * dy <= 1.0) nodes[i].neighbours.push_back(j);
+    }
+  }
+}
+
+static int reachableFrom(int src) {
+  std::vector<bool> seen(nodes.size(), false);
+  std::vector<int> stack(1, src);
+  seen[src] = true;
+  int n = 0;
+  while (!stack.empty()) {
+    int i = stack.back();
+    stack.pop_back();
+    n++;
+    for (int j : nodes[i].neighbours) {
+      if (!seen[j]) {
+        seen[j] = true;
+        stack.push_back(j);
+      }
+    }
+  }
+  return n;
+}
+
+static void startTransmit(Node& n, int self) {
+  Frame f = n.txQueue.front();
+  n.txQueue.pop_front();
+  uint64_t end = nowUs + airtimeUs(f.bytes.size());
+  n.txUntil = end;
+  transmissions++;
+
+  for (int j : n.neighbours) {
+    Node& r = nodes[j];
+    Rx rx = { self, j, end, false, f };
+    // Half duplex, or overlapping another reception = collision
+    if (r.txUntil > nowUs) rx.corrupted = true;
+    if (r.currentRx >= 0 && rxList[r.currentRx].end > nowUs) {
+      rx.corrupted = true;
+      rxList[r.currentRx].corrupted = true;
+    }
+    if (rngUnit() < LOSS) rx.corrupted = true;
+    rxList.push_back(rx);
+    r.currentRx = (int)rxList.size() - 1;
+    r.busyUntil = std::max(r.busyUntil, end);
+  }
+}
+
+static void step() {
+  uint32_t nowMs = (uint32_t)(nowUs / 1000);
+
+  // Finished receptions (after processing delay) go to the router
+  for (size_t i = 0; i < rxList.size();) {
+    Rx& rx = rxList[i];
+    if (rx.end + PROC_US > nowUs) {
+      i++;
+      continue;
+    }
+    if (!rx.corrupted && (rx.frame.dest < 0 || rx.frame.dest == rx.to)) {
+      Node& r = nodes[rx.to];
+      r.router.onFrame(nodes[rx.from].mac, rx.frame.bytes.data(), rx.frame.bytes.size(), nowMs);
+    } else if (rx.corrupted && rx.frame.dest == rx.to && rx.frame.retries < UNICAST_RETRIES) {
+      // No ACK: the sender's MAC retries the unicast
+      Frame retry = rx.frame;
+      retry.retries++;
+      nodes[rx.from].txQueue.push_front(retry);
+    }
+    // Keep currentRx indices valid: swap-remove and fix up
+    size_t last = rxList.size() - 1;
+    for (Node& n : nodes) {
+      if (n.currentRx == (int)i) n.currentRx = -1;
+      else if (n.currentRx == (int)last) n.currentRx = (int)i;
+    }
+    rxList[i] = rxList[last];
+    rxList.pop_back();
+  }
+
+  for (size_t i = 0; i < nodes.size(); i++) {
+    Node& n = nodes[i];
+    if (n.router.hasPending()) n.router.update(nowMs);
+    if (n.txQueue.empty() || n.txUntil > nowUs || n.nextTry > nowUs) continue;
+    // Carrier sense with a short random backoff
+    if (n.busyUntil > nowUs) {
+      n.nextTry = n.busyUntil + 50 + rng() % 300;
+      continue;
+    }
+    startTransmit(n, (int)i);
+  }
+}
+
+static bool idle() {
+  if (!rxList.empty()) return false;
+  for (Node& n : nodes) {
+    if (n.router.hasPending() || !n.txQueue.empty() || n.txUntil > nowUs) return false;
+  }
+  return true;
+}
+
+static void runUntilIdle() {
+  uint64_t limit = nowUs + 5000000;
+  do {
+    nowUs += STEP_US;
+    step();
+  } while (!idle() && nowUs < limit);
+}
+
+static void run(int count, const char* mode, uint8_t jitter, uint8_t suppress) {
+  double coverage = 0, txPerFlood = 0, perHop = 0, hopsSum = 0;
+  std::vector<double> latencies;
+  int unicastOk = 0;
+  double unicastTx = 0, unicastHopSum = 0;
+
+  for (int f = 0; f < FLOODS; f++) {
+    buildVenue(count, 0x1000 + count * 7 + f, jitter, suppress);
+    for (Node& n : nodes) {
+      n.txUntil = n.nextTry = n.busyUntil = 0;
+      n.currentRx = -1;
+      n.deliveredAt = 0;
+      n.hops = 0;
+    }
+    nowUs = 1000000;
+    int reachable = reachableFrom(0);
+
+    // Flood a cue from the master (node 0)
+    uint8_t cue[44] = { 'S', 'C', 'E', 'N', 'E' };
+    transmissions = 0;
+    uint64_t start = nowUs;
+    nodes[0].router.send(MESH_BROADCAST, cue, sizeof(cue), (uint32_t)(nowUs / 1000));
+    runUntilIdle();
+
+    int got = 0;
+    double hopLat = 0;
+    for (size_t i = 1; i < nodes.size(); i++) {
+      Node& n = nodes[i];
+      if (!n.deliveredAt) continue;
+      got++;
+      double ms = (n.deliveredAt - start) / 1000.0;
+      latencies.push_back(ms);
+      hopLat += ms / n.hops;
+      hopsSum += n.hops;
+    }
+    coverage += reachable > 1 ? got / (double)(reachable - 1) : 1.0;
+    txPerFlood += transmissions;
+    perHop += got ? hopLat / got : 0;
+
+    // Unicast back to the master along learned reverse paths
+    int from = 1 + (int)(rng() % (count - 1));
+    if (nodes[from].deliveredAt) {
+      unicastTarget = 0;
+      unicastArrived = false;
+      transmissions = 0;
+      nodes[from].router.send(1, cue, sizeof(cue), (uint32_t)(nowUs / 1000));
+      runUntilIdle();
+      if (unicastArrived) {
+        unicastOk++;
+        unicastHopSum += unicastHops;
+      }
+      unicastTx += transmissions;
+      unicastTarget = -1;
+    }
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  double p95 = latencies.empty() ? 0 : latencies[(size_t)(latencies.size() * 0.95)];
+  double delivered = latencies.empty() ? 1 : latencies.size();
+
+  printf("%d,%s,%.3f,%.1f,%.2f,%.2f,%.3f,%.1f,%.2f,%.1f,%.1f\n",
+         count, mode,
+         coverage / FLOODS,
+         txPerFlood / FLOODS,
+         txPerFlood / FLOODS / count,
+         hopsSum / delivered,
+         perHop / FLOODS,
+         p95,
+         unicastOk / (double)FLOODS,
+         unicastTx / FLOODS,
+         unicastOk ? unicastHopSum / unicastOk : 0.0);
+}
+
+int main() {
+  static const int sizes[] = { 10, 100, 500 };
+
+  printf("nodes,mode,coverage,tx_per_flood,amplification,avg_hops,per_hop_ms,p95_ms,"
+         "unicast_ok,unicast_tx,unicast_hops\n");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    run(sizes[s], "plain", 0, 0);
+    run(sizes[s], "jitter+suppress", MESH_JITTER_MS, MESH_SUPPRESS_COUNT);
+  }
+  return 0;
+}
@@ -0,0 +1,363 @@
+/**
+ * ESP Chas TV - Command log replay
+ *
+ * Replays a recorded command log (CommandLog.h) through ShowExecutor on
+ * the host, either as fast as possible - real show traffic as an
+ * executor throughput benchmark - or at the original pace to rehearse a
+ * show away from the stage.
+ *
+ * Input is either a dump of the "cmdlog" flash partition:
+ *   esptool.py read_flash 0x360000 0x80000 cmdlog.bin
+ * or a serial capture with the recorder's stream turned on ("log
+ * capture on" on the console), e.g. `pio device monitor | tee show.txt`.
+ * Lines without the "@CL " prefix are ignored.
+ *
+ *   ./replay_bench                 # synthetic 8-hour show, self-check
+ *   ./replay_bench cmdlog.bin      # throughput on a real log
+ *   ./replay_bench show.txt --realtime   # rehearse at 1x, prints each cue
+ *   ./replay_bench show.txt --list       # print the records, no replay
+ *
+ * Prints CSV:
+ *   input,records,sessions,torn,replayed,mismatched,read_ns_per_record,
+ *   exec_ns_per_cmd,cmds_per_s,check
+ *
+ * exec_ns_per_cmd is ShowExecutor alone on records already in memory
+ * (best of several passes); read_ns_per_record adds the flash log
+ * reader. `mismatched` counts commands whose outcome differs from the
+ * recording; the synthetic run also checks that the flash ring and the
+ * capture both give back exactly what was recorded.
+ *
+ * Build & run (host):
+ *   g++ -O2 -Ilib/ChaosShow/src bench/replay_bench.cpp \
+ *       lib/ChaosShow/src/CommandLog.cpp lib/ChaosShow/src/ShowCommand.cpp \
+ *       lib/ChaosShow/src/ShowExecutor.cpp -o replay_bench && ./replay_bench
+ */
+
+#include "CommandLog.h"
+#include "ShowExecutor.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t SECTOR_SIZE = 4096;
+static const uint32_t SHOW_HOURS = 8;
+static const uint32_t CUE_MS = 500;              // Average time between cues
+static const uint32_t REBOOT_EVERY_MS = 2UL * 60 * 60 * 1000;
+static const double MIN_BENCH_NS = 200e6;        // Executor passes run at least this long
+
+typedef std::chrono::steady_clock Clock;
+
+static uint32_t rng = 0x5EED1234;
+static uint32_t nextRand() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+// NOR flash in RAM: erase sets 0xFF, writes only clear bits
+class RamFlash : public JournalStore {
+public:
+  explicit RamFlash(uint16_t sectors) : mem(sectors * SECTOR_SIZE, 0xFF), _sectors(sectors) {}
+
+  uint32_t sectorSize() const { return SECTOR_SIZE; }
+  uint16_t sectorCount() const { return _sectors; }
+
+  bool read(uint32_t addr, void* buf, size_t len) {
+    if (addr + len > mem.size()) return false;
+    memcpy(buf, &mem[addr], len);
+    return true;
+  }
+
+  bool write(uint32_t addr, const void* buf, size_t len) {
+    if (addr + len > mem.size()) return false;
+    const uint8_t* p = (const uint8_t*)buf;
+    for (size_t i = 0; i < len; i++) mem[addr + i] &= p[i];
+    return true;
+  }
+
+  bool erase(uint16_t sector) {
+    memset(&mem[sector * SECTOR_SIZE], 0xFF, SECTOR_SIZE);
+    return true;
+  }
+
+  std::vector<uint8_t> mem;
+
+private:
+  uint16_t _sectors;
+};
+
+static bool sameRecord(const CommandRecord& a, const CommandRecord& b) {
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Replay targets
+// ---------------------------------------------------------------------------
+
+struct HostNode {
+  ShowExecutor executor;
+  uint32_t t0Us;
+  bool print;
+};
+
+// Every command is executed - that is what the fixtures did with it.
+// Sends and forwards can't be repeated on the host, so they keep their
+// recorded outcome.
+static uint8_t replayOne(void* ctx, const CommandRecord& rec) {
+  HostNode* node = (HostNode*)ctx;
+  uint32_t nowMs = (uint32_t)(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                  Clock::now().time_since_epoch()).count());
+  bool ok = node->executor.execute(commandRecordCommand(rec), nowMs);
+
+  if (node->print) {
+    uint32_t us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                      Clock::now().time_since_epoch()).count() - node->t0Us;
+    printf("%10.3f s  %-10s %6d %6d  %-7s %s\n", us / 1e6, showCommandName(rec.id),
+           (int)rec.value1, (int)rec.value2, commandSourceName(rec.source),
+           commandOutcomeName(rec.outcome));
+    fflush(stdout);
+  }
+
+  if (rec.outcome == OUTCOME_EXECUTED || rec.outcome == OUTCOME_REJECTED) {
+    return ok ? OUTCOME_EXECUTED : OUTCOME_REJECTED;
+  }
+  return rec.outcome;
+}
+
+static double executorNsPerCmd(const std::vector<CommandRecord>& records) {
+  std::vector<ShowCommand> cmds;
+  for (size_t i = 0; i < records.size(); i++) {
+    if (records[i].id != CMD_NONE) cmds.push_back(commandRecordCommand(records[i]));
+  }
+  if (cmds.empty()) return 0;
+
+  double best = 0, total = 0;
+  uint32_t sink = 0;
+  while (total < MIN_BENCH_NS) {
+    ShowExecutor executor;
+    uint32_t now = 0;
+    Clock::time_point t0 = Clock::now();
+    for (size_t i = 0; i < cmds.size(); i++) {
+      executor.execute(cmds[i], now);
+      now += 500;
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    sink += executor.state().commandCount;
+    total += ns;
+    if (best == 0 || ns < best) best = ns;
+  }
+  if (sink == 0) printf("# nothing executed\n");
+  return best / cmds.size();
+}
+
+// Replay the whole log fast and print the CSV row
+static bool report(const char* input, RamFlash& flash, const char* check) {
+  CommandLogReader reader;
+  reader.begin(&flash);
+
+  std::vector<CommandRecord> records;
+  CommandRecord rec;
+  Clock::time_point t0 = Clock::now();
+  while (reader.next(rec)) records.push_back(rec);
+  double readNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+
+  HostNode node;
+  node.print = false;
+  CommandReplayer replayer;
+  replayer.start(&reader, replayOne, &node, REPLAY_FAST, 0);
+  while (replayer.update(0)) {}
+  const ReplayStats& rs = replayer.stats();
+
+  double execNs = executorNsPerCmd(records);
+  printf("%s,%zu,%u,%u,%u,%u,%.1f,%.1f,%.0f,%s\n", input, records.size(), rs.sessions,
+         reader.torn(), rs.replayed, rs.mismatched,
+         records.empty() ? 0.0 : readNs / records.size(), execNs,
+         execNs > 0 ? 1e9 / execNs : 0.0, check);
+  return rs.mismatched == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Synthetic show
+// ---------------------------------------------------------------------------
+
+static void captureLine(void* ctx, const CommandRecord& rec) {
+  char line[CMDLOG_LINE_SIZE];
+  commandRecordToLine(rec, line);
+  ((std::vector<std::string>*)ctx)->push_back(std::string("noise before ") + line);
+}
+
+static int synthetic() {
+  RamFlash flash(CMDLOG_MAX_SECTORS);
+  std::vector<std::string> capture;
+  std::vector<CommandRecord> expected;
+
+  // A fresh recorder per boot, as after a power cycle
+  CommandRecorder* recorder = new CommandRecorder();
+  recorder->setStream(captureLine, &capture);
+  ShowExecutor executor;
+
+  uint32_t nowUs = 0;
+  uint64_t elapsedMs = 0, nextReboot = REBOOT_EVERY_MS;
+  uint32_t overflow = 0;
+  recorder->begin(&flash, nowUs);
+
+  while (elapsedMs < (uint64_t)SHOW_HOURS * 3600 * 1000) {
+    uint32_t gapMs = CUE_MS / 2 + nextRand() % CUE_MS;
+    elapsedMs += gapMs;
+    nowUs += gapMs * 1000 + nextRand() % 1000;
+
+    if (elapsedMs >= nextReboot) {
+      nextReboot += REBOOT_EVERY_MS;
+      recorder->flush();
+      overflow += recorder->stats().overflow;
+      delete recorder;
+      recorder = new CommandRecorder();
+      recorder->setStream(captureLine, &capture);
+      recorder->begin(&flash, nowUs);
+      continue;
+    }
+
+    // Mostly scene and LED cues, the odd unknown id from a newer sender
+    static const uint8_t ids[] = { CMD_SCENE, CMD_SCENE, CMD_LED_ON, CMD_LED_OFF, CMD_PATTERN,
+                                   CMD_SHOW_START, CMD_SHOW_STOP, CMD_PING, CMD_COUNT + 3 };
+    ShowCommand cmd = { ids[nextRand() % sizeof(ids)], (int32_t)(nextRand() % 4), 0 };
+    uint8_t source = (uint8_t)(SOURCE_SERIAL + nextRand() % (SOURCE_MESH - SOURCE_SERIAL + 1));
+    uint8_t outcome = executor.execute(cmd, elapsedMs) ? OUTCOME_EXECUTED : OUTCOME_REJECTED;
+    recorder->record(cmd, source, outcome, nowUs);
+    if (nextRand() % 2 == 0) recorder->flush();   // loop() mostly runs between cues
+  }
+  recorder->flush();
+  overflow += recorder->stats().overflow;
+  delete recorder;
+
+  // Everything recorded, in order, straight from the capture
+  for (size_t i = 0; i < capture.size(); i++) {
+    CommandRecord rec;
+    if (commandRecordFromLine(capture[i].c_str(), rec)) expected.push_back(rec);
+  }
+  bool captureOk = expected.size() == capture.size() && overflow == 0;
+
+  // The flash ring holds the newest part of it
+  CommandLogReader reader;
+  reader.begin(&flash);
+  std::vector<CommandRecord> stored;
+  CommandRecord rec;
+  while (reader.next(rec)) stored.push_back(rec);
+  bool flashOk = !stored.empty() && stored.size() <= expected.size();
+  size_t offset = expected.size() - stored.size();
+  for (size_t i = 0; flashOk && i < stored.size(); i++) {
+    flashOk = sameRecord(stored[i], expected[offset + i]);
+  }
+
+  // Importing the capture rebuilds the same log
+  RamFlash imported(CMDLOG_MAX_SECTORS);
+  CommandRecorder importer;
+  importer.begin(&imported, 0);
+  for (size_t i = 0; i < expected.size(); i++) importer.append(expected[i]);
+
+  printf("input,records,sessions,torn,replayed,mismatched,read_ns_per_record,"
+         "exec_ns_per_cmd,cmds_per_s,check\n");
+  bool ok = report("synthetic_flash", flash, flashOk ? "ok" : "FAIL");
+  ok = report("synthetic_capture", imported, captureOk ? "ok" : "FAIL") && ok;
+  return ok && flashOk && captureOk ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Logs from a device
+// ---------------------------------------------------------------------------
+
+static bool loadFile(const char* path, std::vector<uint8_t>& data) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* path = 0;
+  bool realtime = false, list = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--realtime") == 0) realtime = true;
+    else if (strcmp(argv[i], "--list") == 0) list = true;
+    else path = argv[i];
+  }
+  if (!path) return synthetic();
+
+  std::vector<uint8_t> data;
+  if (!loadFile(path, data)) {
+    fprintf(stderr, "can't read %s\n", path);
+    return 2;
+  }
+
+  // A partition dump is whole sectors with a header at the start of one;
+  // anything else is treated as a capture
+  RamFlash flash(CMDLOG_MAX_SECTORS);
+  CommandLogReader probe;
+  bool dump = false;
+  if (data.size() % SECTOR_SIZE == 0 && data.size() / SECTOR_SIZE >= 2) {
+    RamFlash raw((uint16_t)(data.size() / SECTOR_SIZE));
+    raw.mem = data;
+    CommandRecord rec;
+    probe.begin(&raw);
+    dump = probe.next(rec);
+    if (dump) flash = raw;
+  }
+  if (!dump) {
+    CommandRecorder importer;
+    importer.begin(&flash, 0);
+    std::string line;
+    for (size_t i = 0; i <= data.size(); i++) {
+      if (i == data.size() || data[i] == '\n') {
+        CommandRecord rec;
+        if (commandRecordFromLine(line.c_str(), rec)) importer.append(rec);
+        line.clear();
+      } else {
+        line += (char)data[i];
+      }
+    }
+  }
+
+  if (list) {
+    CommandLogReader reader;
+    reader.begin(&flash);
+    CommandRecord rec;
+    printf("dt_us,command,value1,value2,source,outcome\n");
+    while (reader.next(rec)) {
+      printf("%u,%s,%d,%d,%s,%s\n", rec.dtUs, showCommandName(rec.id), (int)rec.value1,
+             (int)rec.value2, commandSourceName(rec.source), commandOutcomeName(rec.outcome));
+    }
+    return 0;
+  }
+
+  if (realtime) {
+    HostNode node;
+    node.print = true;
+    node.t0Us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                    Clock::now().time_since_epoch()).count();
+    CommandLogReader reader;
+    reader.begin(&flash);
+    CommandReplayer replayer;
+    replayer.start(&reader, replayOne, &node, REPLAY_REALTIME, node.t0Us);
+    for (;;) {
+      uint32_t now = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                         Clock::now().time_since_epoch()).count();
+      if (!replayer.update(now)) break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    printf("# %u commands, %u mismatched, worst %u us late\n", replayer.stats().replayed,
+           replayer.stats().mismatched, replayer.stats().maxLateUs);
+    return 0;
+  }
+
+  printf("input,records,sessions,torn,replayed,mismatched,read_ns_per_record,"
+         "exec_ns_per_cmd,cmds_per_s,check\n");
+  return report(dump ? "flash_dump" : "capture", flash, "-") ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+/**
+ * ESP Chas TV - Host stand-in for ESP-IDF <esp_attr.h>
+ *
+ * Placement attributes mean nothing off the chip: RTC and PSRAM
+ * variables become plain globals, IRAM functions plain functions. Only
+ * for the native build (bench/, [env:native]); never on a board.
+ */
+
+#ifndef CHAOS_SHIM_ESP_ATTR_H
+#define CHAOS_SHIM_ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define EXT_RAM_ATTR
+#define EXT_RAM_BSS_ATTR
+
+#endif
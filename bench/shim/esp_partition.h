@@ -0,0 +1,125 @@
+/**
+ * ESP Chas TV - Host stand-in for ESP-IDF <esp_partition.h>
+ *
+ * The data partitions of partitions.csv as RAM, with NOR flash rules:
+ * erased bytes read 0xFF, a write can only clear bits, and erases work
+ * on whole 4 KB sectors. Enough for PartitionStore - and everything on
+ * top of it (StateJournal, ShowStateStore, CommandLog, NodeConfig) - to
+ * run unchanged in the native build. Contents last until the process
+ * exits, like flash across a reboot.
+ */
+
+#ifndef CHAOS_SHIM_ESP_PARTITION_H
+#define CHAOS_SHIM_ESP_PARTITION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                 0
+#define ESP_FAIL               -1
+#define ESP_ERR_INVALID_ARG    0x102
+#define ESP_ERR_INVALID_SIZE   0x104
+
+typedef enum {
+  ESP_PARTITION_TYPE_APP = 0x00,
+  ESP_PARTITION_TYPE_DATA = 0x01
+} esp_partition_type_t;
+
+typedef enum {
+  ESP_PARTITION_SUBTYPE_ANY = 0xff
+} esp_partition_subtype_t;
+
+typedef struct {
+  esp_partition_type_t type;
+  uint8_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+  bool encrypted;
+} esp_partition_t;
+
+#define SHIM_FLASH_SECTOR 4096
+
+struct ShimPartition {
+  esp_partition_t part;
+  uint8_t* mem;
+};
+
+// Data partitions from partitions.csv (app slots and nvs aren't used)
+inline ShimPartition* shimPartitions(size_t* count) {
+  static uint8_t nodecfg[0x2000];
+  static uint8_t cmdlog[0x80000];
+  static uint8_t showstate[0x10000];
+  static ShimPartition table[] = {
+    { { ESP_PARTITION_TYPE_DATA, 0x42, 0x35E000, sizeof(nodecfg),   "nodecfg",   false }, nodecfg },
+    { { ESP_PARTITION_TYPE_DATA, 0x41, 0x360000, sizeof(cmdlog),    "cmdlog",    false }, cmdlog },
+    { { ESP_PARTITION_TYPE_DATA, 0x40, 0x3E0000, sizeof(showstate), "showstate", false }, showstate },
+  };
+  static bool erased = false;
+  if (!erased) {
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+      memset(table[i].mem, 0xFF, table[i].part.size);
+    }
+    erased = true;
+  }
+  *count = sizeof(table) / sizeof(table[0]);
+  return table;
+}
+
+inline uint8_t* shimPartitionMem(const esp_partition_t* part) {
+  size_t count;
+  ShimPartition* table = shimPartitions(&count);
+  for (size_t i = 0; i < count; i++) {
+    if (&table[i].part == part) return table[i].mem;
+  }
+  return 0;
+}
+
+inline const esp_partition_t* esp_partition_find_first(esp_partition_type_t type,
+                                                       esp_partition_subtype_t subtype,
+                                                       const char* label) {
+  size_t count;
+  ShimPartition* table = shimPartitions(&count);
+  for (size_t i = 0; i < count; i++) {
+    const esp_partition_t& p = table[i].part;
+    if (p.type != type) continue;
+    if (subtype != ESP_PARTITION_SUBTYPE_ANY && p.subtype != subtype) continue;
+    if (label && strcmp(p.label, label) != 0) continue;
+    return &p;
+  }
+  return 0;
+}
+
+inline esp_err_t esp_partition_read(const esp_partition_t* part, size_t srcOffset,
+                                    void* dst, size_t size) {
+  uint8_t* mem = shimPartitionMem(part);
+  if (!mem || !dst) return ESP_ERR_INVALID_ARG;
+  if (srcOffset > part->size || size > part->size - srcOffset) return ESP_ERR_INVALID_SIZE;
+  memcpy(dst, mem + srcOffset, size);
+  return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* part, size_t dstOffset,
+                                     const void* src, size_t size) {
+  uint8_t* mem = shimPartitionMem(part);
+  if (!mem || !src) return ESP_ERR_INVALID_ARG;
+  if (dstOffset > part->size || size > part->size - dstOffset) return ESP_ERR_INVALID_SIZE;
+  const uint8_t* in = (const uint8_t*)src;
+  for (size_t i = 0; i < size; i++) mem[dstOffset + i] &= in[i];
+  return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* part, size_t offset,
+                                           size_t size) {
+  uint8_t* mem = shimPartitionMem(part);
+  if (!mem) return ESP_ERR_INVALID_ARG;
+  if (offset % SHIM_FLASH_SECTOR || size % SHIM_FLASH_SECTOR) return ESP_ERR_INVALID_ARG;
+  if (offset > part->size || size > part->size - offset) return ESP_ERR_INVALID_SIZE;
+  memset(mem + offset, 0xFF, size);
+  return ESP_OK;
+}
+
+#endif
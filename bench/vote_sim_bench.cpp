@@ -0,0 +1,469 @@
+/**
+ * ESP Chas TV - Audience vote simulator
+ *
+ * 100 / 1,000 / 5,000 virtual voters on a venue floor (average 12
+ * neighbours, master in the middle), each casting one vote at a random
+ * moment in a 3 s voting window. Every node knows its next hop to the
+ * master, as learned from the flood that opened the poll.
+ *
+ * Two modes, same voters (VoteTally from lib/ChaosShow on every node):
+ *   direct     - every vote travels to the master as its own mesh
+ *                unicast; relays only forward. The master dedups per
+ *                voter.
+ *   aggregated - every node runs VoteTally: relays merge what their
+ *                children send and pass one summary per interval to
+ *                their own parent.
+ *   moving     - aggregated, and during the voting window 1% of the
+ *                nodes switch to another parent every 100 ms (a route
+ *                that changed), taking their subtree with them.
+ *
+ * Radio model as in mesh_sim_bench.cpp: shared 1 Mbps channel, carrier
+ * sense, half-duplex nodes, hidden-terminal collisions, 2% random loss,
+ * up to 3 link-layer retries for unicasts, plus a 16-frame send queue
+ * per node (frames beyond that are dropped, like a full ESP-NOW queue).
+ *
+ * Prints CSV:
+ *   voters,mode,max_fan_in,converge_ms,counted,overcount,airtime_s,
+ *   tx_per_voter,master_rx,master_rx_per_s,queue_drops
+ *
+ *   max_fan_in      - most direct children of any node (master included)
+ *   converge_ms     - last vote cast -> master tally exactly right
+ *                     (-1 = not within the 30 s horizon)
+ *   counted         - fraction of votes in the master's tally at the end
+ *   overcount       - most votes the master ever counted beyond those
+ *                     cast so far (a moved subtree counted twice); must
+ *                     be 0
+ *   airtime_s       - transmit airtime summed over every node
+ *   master_rx       - frames the master received
+ *
+ * All totals run until convergence (or the horizon).
+ *
+ * Build & run (host):
+ *   g++ -O2 -Ilib/ChaosShow/src bench/vote_sim_bench.cpp \
+ *       lib/ChaosShow/src/VoteTally.cpp -o vote_bench && ./vote_bench
+ */
+
+#include "MeshRouter.h"
+#include "VoteTally.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <queue>
+#include <vector>
+
+static const double AVG_DEGREE = 12.0;
+static const double LOSS = 0.02;
+static const uint64_t PROC_US = 300;     // recv callback -> loop()
+static const uint64_t STEP_US = 100;
+static const uint32_t TICK_MS = 10;      // loop() calls tally.update()
+static const int UNICAST_RETRIES = 3;
+static const size_t TX_QUEUE_MAX = 16;
+static const uint32_t VOTE_WINDOW_MS = 3000;
+static const uint32_t HORIZON_MS = 30000;
+static const uint8_t OPTIONS = 4;
+
+static uint32_t rngState = 0xC0FFEE;
+static uint32_t rng() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+static double rngUnit() { return (rng() & 0xFFFFFF) / (double)0x1000000; }
+
+// ESP-NOW at 1 Mbps: long preamble + MAC/vendor overhead + payload
+static uint64_t airtimeUs(size_t len) { return 192 + (len + 43) * 8; }
+
+struct Frame {
+  int dest;
+  int retries;
+  uint8_t len;
+  uint8_t bytes[sizeof(MeshHeader) + sizeof(VoteSummary)];
+};
+
+struct Rx {
+  int from;
+  int to;
+  bool corrupted;
+  Frame frame;
+};
+
+struct Node {
+  VoteTally tally;
+  double x, y;
+  std::vector<int> neighbours;
+  int parent;
+  int hops;
+  int children;
+  uint32_t voteAt;
+  uint8_t choice;
+  bool voted;
+  std::deque<Frame> txQueue;
+  bool active;
+  uint64_t txUntil;
+  uint64_t nextTry;
+  uint64_t busyUntil;    // Channel heard busy until
+  uint64_t rxUntil;      // Receiving something until
+  int currentRx;         // Addressed reception in progress, -1 = none
+};
+
+// Master side of direct mode: last vote per voter
+struct DirectVote {
+  uint32_t version;
+  int8_t choice;
+};
+
+static std::vector<Node> nodes;
+static std::vector<Rx> rxPool;
+static std::vector<int> rxFree;
+static std::priority_queue<std::pair<uint64_t, int>,
+                           std::vector<std::pair<uint64_t, int> >,
+                           std::greater<std::pair<uint64_t, int> > > rxDue;
+static std::vector<int> activeNodes;
+static std::vector<DirectVote> directVotes;
+static uint32_t directCounts[OPTIONS];
+static bool aggregated;
+static bool moving;
+static uint64_t nowUs;
+static uint64_t airtimeTotalUs;
+static uint32_t transmissions, masterRx, queueDrops;
+
+static void enqueue(int node, const Frame& f, bool front) {
+  Node& n = nodes[node];
+  if (front) {
+    n.txQueue.push_front(f);
+  } else if (n.txQueue.size() >= TX_QUEUE_MAX) {
+    queueDrops++;
+    return;
+  } else {
+    n.txQueue.push_back(f);
+  }
+  if (!n.active) {
+    n.active = true;
+    activeNodes.push_back(node);
+  }
+}
+
+// VoteTally -> parent. Aggregated: a bare 32-byte summary to `parent`
+// (node IDs are index + 1). Direct: wrapped in a mesh header and
+// forwarded hop by hop to the master.
+static bool onSend(void* ctx, uint32_t parent, const uint8_t* data, size_t len) {
+  int self = (int)(intptr_t)ctx;
+  Node& n = nodes[self];
+  int dest = parent ? (int)parent - 1 : n.parent;
+  if (dest < 0) return false;
+
+  Frame f;
+  f.dest = dest;
+  f.retries = 0;
+  if (aggregated) {
+    f.len = (uint8_t)len;
+    memcpy(f.bytes, data, len);
+  } else {
+    MeshHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.origin = self + 1;
+    hdr.dest = 0;
+    hdr.magic = MESH_MAGIC;
+    hdr.flags = MESH_FLAG_UNICAST;
+    hdr.len = (uint8_t)len;
+    f.len = (uint8_t)(sizeof(hdr) + len);
+    memcpy(f.bytes, &hdr, sizeof(hdr));
+    memcpy(f.bytes + sizeof(hdr), data, len);
+  }
+  // loop() runs update() somewhere inside the tick, not on its edge
+  if (n.txQueue.empty()) n.nextTry = std::max(n.nextTry, nowUs + rng() % (TICK_MS * 1000));
+  enqueue(self, f, false);
+  return true;
+}
+
+static void buildVenue(int voters, uint32_t seed) {
+  rngState = seed * 2654435761UL ^ 0x5BD1E995;
+  for (int i = 0; i < 16; i++) rng();
+  int count = voters + 1;
+  nodes.clear();
+  nodes.resize(count);
+
+  // Radio range 1.0; pick the floor size for the target density
+  double side = std::sqrt(count * M_PI / AVG_DEGREE);
+  for (int i = 0; i < count; i++) {
+    Node& n = nodes[i];
+    n.x = i == 0 ? side / 2 : rngUnit() * side;
+    n.y = i == 0 ? side / 2 : rngUnit() * side;
+    n.parent = -1;
+    n.hops = -1;
+    n.children = 0;
+    n.voteAt = (uint32_t)(rngUnit() * VOTE_WINDOW_MS);
+    n.choice = (uint8_t)(rng() % OPTIONS);
+    n.voted = false;
+    n.active = false;
+    n.txUntil = n.nextTry = n.busyUntil = n.rxUntil = 0;
+    n.currentRx = -1;
+  }
+
+  // Grid buckets keep neighbour search linear
+  int cells = (int)std::ceil(side);
+  std::vector<std::vector<int> > grid(cells * cells);
+  for (int i = 0; i < count; i++) {
+    int cx = std::min(cells - 1, (int)nodes[i].x), cy = std::min(cells - 1, (int)nodes[i].y);
+    grid[cy * cells + cx].push_back(i);
+  }
+  for (int i = 0; i < count; i++) {
+    int cx = std::min(cells - 1, (int)nodes[i].x), cy = std::min(cells - 1, (int)nodes[i].y);
+    for (int gy = std::max(0, cy - 1); gy <= std::min(cells - 1, cy + 1); gy++) {
+      for (int gx = std::max(0, cx - 1); gx <= std::min(cells - 1, cx + 1); gx++) {
+        for (int j : grid[gy * cells + gx]) {
+          double dx = nodes[i].x - nodes[j].x, dy = nodes[i].y - nodes[j].y;
+          if (i != j && dx * dx + dy * dy <= 1.0) nodes[i].neighbours.push_back(j);
+        }
+      }
+    }
+  }
+
+  // Reverse path from the poll flood: any neighbour one hop closer
+  std::vector<int> frontier(1, 0);
+  nodes[0].hops = 0;
+  while (!frontier.empty()) {
+    std::vector<int> next;
+    for (int i : frontier) {
+      for (int j : nodes[i].neighbours) {
+        if (nodes[j].hops < 0) {
+          nodes[j].hops = nodes[i].hops + 1;
+          next.push_back(j);
+        }
+      }
+    }
+    for (int j : next) {
+      std::vector<int> closer;
+      for (int k : nodes[j].neighbours) {
+        if (nodes[k].hops == nodes[j].hops - 1) closer.push_back(k);
+      }
+      nodes[j].parent = closer[rng() % closer.size()];
+    }
+    frontier.swap(next);
+  }
+}
+
+static void startTransmit(int self) {
+  Node& n = nodes[self];
+  Frame f = n.txQueue.front();
+  n.txQueue.pop_front();
+  uint64_t end = nowUs + airtimeUs(f.len);
+  n.txUntil = end;
+  transmissions++;
+  airtimeTotalUs += end - nowUs;
+
+  for (int j : n.neighbours) {
+    Node& r = nodes[j];
+    bool clash = r.rxUntil > nowUs;
+    if (clash && r.currentRx >= 0) rxPool[r.currentRx].corrupted = true;
+    r.rxUntil = std::max(r.rxUntil, end);
+    r.busyUntil = std::max(r.busyUntil, end);
+    if (j != f.dest) continue;
+
+    int idx;
+    if (rxFree.empty()) {
+      idx = (int)rxPool.size();
+      rxPool.push_back(Rx());
+    } else {
+      idx = rxFree.back();
+      rxFree.pop_back();
+    }
+    Rx& rx = rxPool[idx];
+    rx.from = self;
+    rx.to = j;
+    rx.corrupted = clash || r.txUntil > nowUs || rngUnit() < LOSS;
+    rx.frame = f;
+    r.currentRx = idx;
+    rxDue.push(std::make_pair(end + PROC_US, idx));
+  }
+}
+
+static void deliver(Rx& rx, uint32_t nowMs) {
+  Node& r = nodes[rx.to];
+  const uint8_t* data = rx.frame.bytes;
+  if (rx.to == 0) masterRx++;
+
+  if (aggregated) {
+    r.tally.onSummary(data, rx.frame.len, nowMs);
+    return;
+  }
+
+  if (rx.to != 0) {
+    Frame f = rx.frame;
+    f.dest = r.parent;
+    f.retries = 0;
+    enqueue(rx.to, f, false);
+    return;
+  }
+
+  // Master: last vote per voter wins
+  VoteSummary s;
+  memcpy(&s, data + sizeof(MeshHeader), sizeof(s));
+  DirectVote& v = directVotes[s.origin - 1];
+  if (v.choice >= 0 && (int32_t)(s.version - v.version) <= 0) return;
+  if (v.choice >= 0) directCounts[v.choice]--;
+  v.version = s.version;
+  v.choice = -1;
+  for (uint8_t o = 0; o < OPTIONS; o++) {
+    if (s.counts[o]) v.choice = (int8_t)o;
+  }
+  if (v.choice >= 0) directCounts[v.choice]++;
+}
+
+static void step() {
+  uint32_t nowMs = (uint32_t)(nowUs / 1000);
+
+  while (!rxDue.empty() && rxDue.top().first <= nowUs) {
+    int idx = rxDue.top().second;
+    rxDue.pop();
+    Rx& rx = rxPool[idx];
+    if (nodes[rx.to].currentRx == idx) nodes[rx.to].currentRx = -1;
+    if (!rx.corrupted) {
+      deliver(rx, nowMs);
+    } else if (rx.frame.retries < UNICAST_RETRIES) {
+      // No ACK: the sender's MAC retries the unicast
+      Frame retry = rx.frame;
+      retry.retries++;
+      enqueue(rx.from, retry, true);
+    }
+    rxFree.push_back(idx);
+  }
+
+  for (size_t a = 0; a < activeNodes.size();) {
+    int i = activeNodes[a];
+    Node& n = nodes[i];
+    if (n.txQueue.empty()) {
+      n.active = false;
+      activeNodes[a] = activeNodes.back();
+      activeNodes.pop_back();
+      continue;
+    }
+    a++;
+    if (n.txUntil > nowUs || n.nextTry > nowUs) continue;
+    // Carrier sense with a short random backoff
+    if (n.busyUntil > nowUs) {
+      n.nextTry = n.busyUntil + 50 + rng() % 300;
+      continue;
+    }
+    startTransmit(i);
+  }
+}
+
+static uint32_t masterCount(uint8_t option) {
+  return aggregated ? nodes[0].tally.count(option) : directCounts[option];
+}
+
+// Point a node at another neighbour one hop closer to the master, if it has one
+static void moveParent(int i) {
+  Node& n = nodes[i];
+  std::vector<int> closer;
+  for (int k : n.neighbours) {
+    if (nodes[k].hops == n.hops - 1 && k != n.parent) closer.push_back(k);
+  }
+  if (!closer.empty()) n.parent = closer[rng() % closer.size()];
+}
+
+static void run(int voters, const char* mode, bool aggregate, bool moves) {
+  aggregated = aggregate;
+  moving = moves;
+  buildVenue(voters, 0x2000 + voters);
+  rxPool.clear();
+  rxFree.clear();
+  while (!rxDue.empty()) rxDue.pop();
+  activeNodes.clear();
+  directVotes.assign(nodes.size(), DirectVote());
+  for (DirectVote& v : directVotes) v.choice = -1;
+  memset(directCounts, 0, sizeof(directCounts));
+  airtimeTotalUs = 0;
+  transmissions = masterRx = queueDrops = 0;
+
+  // Every reachable node votes; they all heard the poll open at t = 0
+  uint32_t truth[OPTIONS] = { 0 };
+  uint32_t lastVote = 0, cast = 0;
+  int maxFanIn = 0;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    Node& n = nodes[i];
+    bool root = (i == 0);
+    n.tally.begin((uint32_t)i + 1, root ? 0 : onSend, (void*)(intptr_t)i);
+    n.tally.open(1, OPTIONS, 0);
+    if (n.parent >= 0) nodes[n.parent].children++;
+    if (!root && n.hops > 0) {
+      truth[n.choice]++;
+      cast++;
+      lastVote = std::max(lastVote, n.voteAt);
+    } else {
+      n.voted = true;   // Master and unreachable nodes don't vote
+    }
+  }
+  for (Node& n : nodes) maxFanIn = std::max(maxFanIn, n.children);
+
+  int convergeMs = -1;
+  uint32_t castSoFar[OPTIONS] = { 0 };
+  uint32_t overcount = 0;
+  nowUs = 0;
+  for (uint32_t ms = 0; ms <= HORIZON_MS; ms += TICK_MS) {
+    if (moving && ms < lastVote && ms % 100 == 0) {
+      for (size_t k = 0; k < nodes.size() / 100 + 1; k++) {
+        int i = 1 + (int)(rng() % (nodes.size() - 1));
+        if (nodes[i].hops > 1) moveParent(i);
+      }
+    }
+
+    for (size_t i = 1; i < nodes.size(); i++) {
+      Node& n = nodes[i];
+      if (!n.voted && n.voteAt <= ms) {
+        n.tally.vote(n.choice);
+        n.voted = true;
+        castSoFar[n.choice]++;
+      }
+      if (aggregated) n.tally.setParent(n.parent >= 0 ? (uint32_t)n.parent + 1 : 0);
+      // Direct mode: relays only forward, so only their own vote is sent
+      n.tally.update(ms);
+    }
+
+    if (ms >= lastVote) {
+      bool done = true;
+      for (uint8_t o = 0; o < OPTIONS; o++) done = done && masterCount(o) == truth[o];
+      if (done) {
+        convergeMs = (int)(ms - lastVote);
+        break;
+      }
+    }
+
+    for (uint64_t end = nowUs + TICK_MS * 1000; nowUs < end; nowUs += STEP_US) step();
+
+    uint32_t extra = 0;
+    for (uint8_t o = 0; o < OPTIONS; o++) {
+      if (masterCount(o) > castSoFar[o]) extra += masterCount(o) - castSoFar[o];
+    }
+    overcount = std::max(overcount, extra);
+  }
+
+  uint32_t counted = 0;
+  for (uint8_t o = 0; o < OPTIONS; o++) counted += std::min(masterCount(o), truth[o]);
+  double seconds = std::max(nowUs, (uint64_t)1) / 1e6;
+
+  printf("%d,%s,%d,%d,%.3f,%u,%.2f,%.1f,%u,%.0f,%u\n",
+         voters, mode, maxFanIn, convergeMs,
+         cast ? counted / (double)cast : 1.0, overcount,
+         airtimeTotalUs / 1e6,
+         cast ? transmissions / (double)cast : 0.0,
+         masterRx, masterRx / seconds, queueDrops);
+}
+
+int main() {
+  static const int sizes[] = { 100, 1000, 5000 };
+
+  printf("voters,mode,max_fan_in,converge_ms,counted,overcount,airtime_s,tx_per_voter,"
+         "master_rx,master_rx_per_s,queue_drops\n");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    run(sizes[s], "direct", false, false);
+    run(sizes[s], "aggregated", true, false);
+    run(sizes[s], "moving", true, true);
+  }
+  return 0;
+}
@@ -11,39 +11,136 @@
  * - <20ms latency
  * - Up to 250m range
  * - Synchronized LED effects
+ * - Same command frame and executor as the web, mesh and LoRa sketches
+ *   (lib/ChaosShow: ShowCommand.h, ShowExecutor.h)
  * 
  * USAGE:
- * 1. Upload this code to multiple ESP32 boards
- * 2. One board acts as MASTER (set IS_MASTER to true)
- * 3. Other boards are SLAVES (set IS_MASTER to false)
- * 4. Master sends commands via serial or web interface
- * 5. All slaves execute commands simultaneously
+ * 1. Upload the same build to every ESP32 board
+ * 2. Boards start as receivers (slaves). Make one the MASTER by typing
+ *    "role master" on its serial console - the role is saved in flash
+ *    (lib/ChaosShow: NodeConfig.h), "role receiver" turns it back
+ * 3. Master sends commands via serial or web interface
+ * 4. All slaves execute commands simultaneously
+ *
+ * GROUPS / ZONES:
+ * Every board can be put in groups (e.g. 1 = left wing, 2 = balcony) and
+ * given a device number. Prefix a command to target part of the audience:
+ *   zone 1,3 scene 2      - only boards in group 1 or 3
+ *   range 1-40 on         - only devices 1..40
+ * Boards drop frames that aren't theirs straight from the radio buffer.
+ * Assign from the master (the setting is saved on the board):
+ *   setgroups <node|all> 1,3
+ *   setdevice <node> 17
+ *
+ * COMMAND LOG:
+ * Every command sent or received is recorded with its timestamp, source
+ * and outcome on the "cmdlog" flash partition (lib/ChaosShow: CommandLog.h).
+ * On any board's serial console:
+ *   log                 - what's recorded
+ *   log capture on|off  - also print each record as an "@CL ..." line
+ *   log dump            - print the whole flash log as "@CL ..." lines
+ *   log replay [fast]   - replay the log here: the master re-sends its
+ *                         cues, slaves re-execute (1x or flat out)
+ *   log stop | log clear
+ * Save captures and dumps to a file and replay them on a computer with
+ * bench/replay_bench.cpp.
+ *
+ * FLEET UPDATES:
+ * Every board takes config and firmware broadcast by the gateway
+ * (05-gateway, lib/ChaosShow: FleetUpdate.h) - all boards at once, so a
+ * 60-fixture rig updates in about the time one board takes. A config
+ * blob sets role, groups and device number per node; a firmware image
+ * (whole or a delta against the running version) goes to the other OTA
+ * slot, is checked and only then booted. "fleet" on the console shows
+ * the versions and any transfer in progress.
+ * Updates must be signed with the fleet key, and a board without one
+ * takes none: set it once per board with "fleetkey <64 hex digits>" (it
+ * goes to NVS, which firmware updates don't touch).
  */
 
+#include <BoardProfile.h>
+
+#if !CHAOS_WITH_ESPNOW
+#error "This sketch needs ESP-NOW - build it with an env that has CHAOS_WITH_ESPNOW=1"
+#endif
+
 #include <esp_now.h>
 #include <WiFi.h>
+#include <ShowCommand.h>
+#include <ShowExecutor.h>
+#include <EspNowTransport.h>
+#include <SerialConsole.h>
+#include <ShowStateStore.h>
+#include <CommandLog.h>
+#include <PartitionStore.h>
+#include <NodeConfig.h>
+#include <FleetUpdate.h>
+#include <esp_ota_ops.h>
+#include <Preferences.h>
 
 // Configuration
-#define IS_MASTER true  // Set to false for slave devices
 #define LED_PIN 2
+#define FLEET_QUEUE_LEN 24   // Chunks come every 5 ms, a flash erase takes ~50
+#define FLEET_KEY_NVS "fleet"   // NVS namespace of the fleet key
+
+// Fleet frame handed from the WiFi task to loop()
+typedef struct fleet_frame {
+  uint8_t len;
+  uint8_t data[FLEET_MAX_FRAME];
+} fleet_frame;
 
-// Broadcast address (FF:FF:FF:FF:FF:FF sends to all)
-uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+// Cue handed from the WiFi task to loop(): the raw ShowFrame bytes
+typedef struct cue_frame {
+  uint8_t data[sizeof(ShowFrame)];
+} cue_frame;
 
-// Message structure
-typedef struct struct_message {
-  char command[32];    // Command name
-  int value1;          // Parameter 1
-  int value2;          // Parameter 2
-  unsigned long timestamp; // For sync timing
-} struct_message;
+EspNowTransport espnow;
+ShowExecutor executor;
+SerialConsole console;
+ShowStateStore stateStore;   // Survives resets: RTC memory + flash journal
+PartitionStore logStore;
+CommandRecorder recorder;    // Every command in and out, on the "cmdlog" partition
+CommandLogReader logReader;
+CommandReplayer replayer;
+PartitionStore configStore;
+NodeConfigStore nodeConfig;  // Master or receiver - saved, not compiled in
 
-struct_message outgoingMsg;
-struct_message incomingMsg;
+// Fleet updates: config blobs in RAM, firmware into the idle OTA slot
+FleetReceiver fleet;
+FleetRamSlot<FLEET_CONFIG_MAX> configSlot;
+PartitionStore firmwareSlot;
+PartitionStore runningImage;  // What deltas are patched against
+QueueHandle_t fleetQueue;
+uint8_t fleetQueueStorage[FLEET_QUEUE_LEN * sizeof(fleet_frame)];
+StaticQueue_t fleetQueueBuffer;
+bool fleetWasReceiving = false;
+Preferences prefs;           // The fleet key - never in the firmware, which is broadcast
+QueueHandle_t cueQueue;
+uint8_t cueQueueStorage[Board::rxQueueLen * sizeof(cue_frame)];
+StaticQueue_t cueQueueBuffer;
+uint32_t restartAt = 0;
 
-// LED state
-int ledPattern = 0;
-unsigned long lastPatternChange = 0;
+uint32_t nodeId = 0;
+uint32_t messageCounter = 0;
+uint32_t filteredCount = 0;   // Frames dropped by the group/range filter
+
+// Addressing for the command line being dispatched (zone/range prefix)
+uint32_t lineGroups = 0;
+uint16_t lineRangeLo = 0, lineRangeHi = 0;
+bool lineRange = false;
+
+bool executeCommand(const ShowCommand& cmd);
+void runCue(const ShowFrame& frame);
+void printAddress();
+void applyRole();
+
+/**
+ * Record a command. Nothing is recorded while a replay runs, so a replay
+ * never feeds on its own output.
+ */
+void logCommand(const ShowCommand& cmd, uint8_t source, uint8_t outcome) {
+  if (!replayer.running()) recorder.record(cmd, source, outcome, micros());
+}
 
 /**
  * Callback when data is sent
@@ -54,167 +151,519 @@ void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
 }
 
 /**
- * Callback when data is received
+ * Callback when data is received - runs in the WiFi task, so cues are
+ * only queued and run from loop(), never alongside the console, a replay
+ * or the recorder
  */
 void OnDataRecv(const uint8_t * mac, const uint8_t *incomingData, int len) {
-  memcpy(&incomingMsg, incomingData, sizeof(incomingMsg));
-  
+  // Fleet transfers are flash work - hand them to loop()
+  if (len > 0 && len <= FLEET_MAX_FRAME && incomingData[0] == FLEET_MAGIC) {
+    fleet_frame frame;
+    frame.len = len;
+    memcpy(frame.data, incomingData, len);
+    xQueueSend(fleetQueue, &frame, 0);
+    return;
+  }
+
+  // Not our zone - drop it before copying anything
+  if (!showFrameForMe(incomingData, len, executor.state().address)) {
+    filteredCount++;
+    return;
+  }
+
+  if (len != sizeof(ShowFrame)) return;
+
+  cue_frame cue;
+  memcpy(cue.data, incomingData, len);
+  xQueueSend(cueQueue, &cue, 0);
+}
+
+/**
+ * Run the cues queued by OnDataRecv()
+ */
+void receiveCues() {
+  cue_frame cue;
+  while (xQueueReceive(cueQueue, &cue, 0) == pdTRUE) {
+    ShowFrame frame;
+    if (!showFrameDecode(cue.data, sizeof(cue.data), frame)) continue;
+    runCue(frame);
+  }
+}
+
+/**
+ * Print, run and record one cue
+ */
+void runCue(const ShowFrame& frame) {
   Serial.println("\n📨 Message Received:");
   Serial.print("  Command: ");
-  Serial.println(incomingMsg.command);
+  Serial.println(showCommandName(frame.command));
   Serial.print("  Value1: ");
-  Serial.println(incomingMsg.value1);
+  Serial.println(frame.value1);
   Serial.print("  Value2: ");
-  Serial.println(incomingMsg.value2);
+  Serial.println(frame.value2);
   Serial.print("  Latency: ");
-  Serial.print(millis() - incomingMsg.timestamp);
+  Serial.print(millis() - frame.timestamp);
   Serial.println("ms");
   
   // Execute command
-  executeCommand(incomingMsg.command, incomingMsg.value1, incomingMsg.value2);
+  ShowCommand cmd = showFrameCommand(frame);
+  bool ok = executeCommand(cmd);
+  logCommand(cmd, SOURCE_ESPNOW, ok ? OUTCOME_EXECUTED : OUTCOME_REJECTED);
 }
 
 /**
  * Execute received command
  */
-void executeCommand(const char* cmd, int val1, int val2) {
-  if (strcmp(cmd, "LED_ON") == 0) {
-    digitalWrite(LED_PIN, HIGH);
-    Serial.println("💡 LED ON");
-    
-  } else if (strcmp(cmd, "LED_OFF") == 0) {
-    digitalWrite(LED_PIN, LOW);
-    Serial.println("💡 LED OFF");
-    
-  } else if (strcmp(cmd, "PATTERN") == 0) {
-    ledPattern = val1;
-    Serial.print("🎨 Pattern changed to: ");
-    Serial.println(val1);
-    
-  } else if (strcmp(cmd, "SHOW_START") == 0) {
-    Serial.println("🎬 SHOW STARTED!");
-    ledPattern = 1; // Start blinking
-    
-  } else if (strcmp(cmd, "SHOW_STOP") == 0) {
-    Serial.println("⏹️ SHOW STOPPED!");
-    ledPattern = 0;
-    digitalWrite(LED_PIN, LOW);
-    
-  } else if (strcmp(cmd, "SCENE") == 0) {
-    Serial.print("🎭 Scene changed to: ");
-    Serial.println(val1);
-    ledPattern = val1 + 10; // Different pattern per scene
-    
-  } else {
+bool executeCommand(const ShowCommand& cmd) {
+  if (!executor.execute(cmd, millis())) {
     Serial.println("❓ Unknown command");
+    return false;
+  }
+  
+  const ShowState& state = executor.state();
+  switch (cmd.id) {
+    case CMD_LED_ON:     Serial.println("💡 LED ON"); break;
+    case CMD_LED_OFF:    Serial.println("💡 LED OFF"); break;
+    case CMD_SHOW_START: Serial.println("🎬 SHOW STARTED!"); break;
+    case CMD_SHOW_STOP:  Serial.println("⏹️ SHOW STOPPED!"); break;
+    case CMD_PATTERN:
+      Serial.print("🎨 Pattern changed to: ");
+      Serial.println(state.ledPattern);
+      break;
+    case CMD_SCENE:
+      Serial.print("🎭 Scene changed to: ");
+      Serial.println(state.scene);
+      break;
+    case CMD_SET_GROUPS:
+    case CMD_SET_DEVICE:
+      printAddress();
+      break;
   }
+  return true;
 }
 
 /**
- * Send command to all devices
+ * Print this board's node ID, groups and device number
  */
-void sendCommand(const char* cmd, int val1 = 0, int val2 = 0) {
-  strcpy(outgoingMsg.command, cmd);
-  outgoingMsg.value1 = val1;
-  outgoingMsg.value2 = val2;
-  outgoingMsg.timestamp = millis();
-  
-  esp_err_t result = esp_now_send(broadcastAddress, (uint8_t *) &outgoingMsg, sizeof(outgoingMsg));
+void printAddress() {
+  const ShowAddress& address = executor.state().address;
+  Serial.print("🆔 Node ");
+  Serial.print(nodeId, HEX);
+  Serial.print(" | groups 0x");
+  Serial.print(address.groups, HEX);
+  Serial.print(" | device ");
+  Serial.println(address.device);
+}
+
+/**
+ * Send command to all devices (or the zone/range of the current line)
+ */
+bool sendCommand(uint8_t id, int val1 = 0, int val2 = 0) {
+  ShowCommand cmd = { id, val1, val2 };
+  ShowFrame frame;
+  showFrameEncode(frame, cmd, nodeId, messageCounter++, millis());
+  if (lineGroups) showFrameSetGroups(frame, lineGroups);
+  if (lineRange) showFrameSetRange(frame, lineRangeLo, lineRangeHi);
   
-  if (result == ESP_OK) {
-    Serial.println("📤 Sent command: " + String(cmd));
+  bool sent = espnow.send((uint8_t *) &frame, sizeof(frame));
+  logCommand(cmd, SOURCE_SERIAL, sent ? OUTCOME_SENT : OUTCOME_SEND_FAILED);
+  if (sent) {
+    Serial.print("📤 Sent command: ");
+    Serial.println(showCommandName(id));
   } else {
     Serial.println("❌ Error sending command");
   }
+  return sent;
 }
 
 /**
- * Process serial commands (for master)
+ * Command log: serial capture, replay and the "log" console command
  */
-void processSerialCommand() {
-  if (Serial.available() > 0) {
-    String input = Serial.readStringUntil('\n');
-    input.trim();
-    
-    if (input == "start") {
-      sendCommand("SHOW_START");
-    } else if (input == "stop") {
-      sendCommand("SHOW_STOP");
-    } else if (input == "on") {
-      sendCommand("LED_ON");
-    } else if (input == "off") {
-      sendCommand("LED_OFF");
-    } else if (input.startsWith("scene")) {
-      int sceneNum = input.substring(5).toInt();
-      sendCommand("SCENE", sceneNum);
-    } else if (input.startsWith("pattern")) {
-      int patternNum = input.substring(7).toInt();
-      sendCommand("PATTERN", patternNum);
+void streamRecord(void* ctx, const CommandRecord& rec) {
+  char line[CMDLOG_LINE_SIZE];
+  commandRecordToLine(rec, line);
+  Serial.println(line);
+}
+
+// The master re-sends what it sent; everything else runs here again
+uint8_t replayCommand(void* ctx, const CommandRecord& rec) {
+  ShowCommand cmd = commandRecordCommand(rec);
+  if (rec.outcome == OUTCOME_SENT || rec.outcome == OUTCOME_SEND_FAILED) {
+    return sendCommand(cmd.id, cmd.value1, cmd.value2) ? OUTCOME_SENT : OUTCOME_SEND_FAILED;
+  }
+  return executeCommand(cmd) ? OUTCOME_EXECUTED : OUTCOME_REJECTED;
+}
+
+void printLogStatus() {
+  const CommandLogStats& st = recorder.stats();
+  Serial.print("📼 Log: ");
+  Serial.print(recorder.hasStore() ? recorder.stored() : 0);
+  Serial.print(" records in flash | recorded ");
+  Serial.print(st.recorded);
+  Serial.print(" | dropped ");
+  Serial.print(st.overflow + st.writeFailed);
+  Serial.print(" | capture ");
+  Serial.println(recorder.streaming() ? "on" : "off");
+  if (replayer.running()) {
+    Serial.print("▶️ Replaying: ");
+    Serial.print(replayer.stats().replayed);
+    Serial.println(" commands so far");
+  }
+}
+
+void updateReplay() {
+  if (!replayer.running() || replayer.update(micros())) return;
+  const ReplayStats& st = replayer.stats();
+  Serial.print("📼 Replay done: ");
+  Serial.print(st.replayed);
+  Serial.print(" commands, ");
+  Serial.print(st.mismatched);
+  Serial.print(" different outcome, worst ");
+  Serial.print(st.maxLateUs / 1000);
+  Serial.println(" ms late");
+}
+
+void cmdLog(uint8_t argc, char* argv[], void* ctx) {
+  const char* sub = argv[1] ? argv[1] : "";
+  if (strcasecmp(sub, "capture") == 0) {
+    bool on = argv[2] && strcasecmp(argv[2], "on") == 0;
+    recorder.setStream(on ? streamRecord : 0);
+  } else if (strcasecmp(sub, "dump") == 0) {
+    CommandRecord rec;
+    logReader.begin(&logStore);
+    while (logReader.next(rec)) streamRecord(0, rec);
+  } else if (strcasecmp(sub, "replay") == 0) {
+    recorder.flush();
+    logReader.begin(&logStore);
+    bool fast = argv[2] && strcasecmp(argv[2], "fast") == 0;
+    replayer.start(&logReader, replayCommand, 0, fast ? REPLAY_FAST : REPLAY_REALTIME, micros());
+    Serial.println(fast ? "▶️ Replaying as fast as possible" : "▶️ Replaying at 1x");
+    return;
+  } else if (strcasecmp(sub, "stop") == 0) {
+    replayer.stop();
+  } else if (strcasecmp(sub, "clear") == 0) {
+    replayer.stop();
+    recorder.clear();
+  } else if (sub[0]) {
+    Serial.println("Usage: log [capture on|off | dump | replay [fast] | stop | clear]");
+    return;
+  }
+  printLogStatus();
+}
+
+/**
+ * Fleet updates: apply a config blob, boot a new firmware image
+ */
+bool fleetSend(void* ctx, const uint8_t* data, size_t len) {
+  return espnow.send(data, len);
+}
+
+bool commitConfig(void* ctx, const FleetAnnounce& object, JournalStore* slot) {
+  FleetConfigEntry entry;
+  if (!fleetConfigFind(configSlot.data(), object.imageSize, nodeId, entry) || entry.role >= ROLE_COUNT) {
+    return false;
+  }
+  nodeConfig.apply(entry, object.version);
+  // Groups and device go through the executor like setgroups/setdevice,
+  // so the show state store saves them
+  if (entry.groups) {
+    ShowCommand cmd = { CMD_SET_GROUPS, (int32_t)nodeId, (int32_t)entry.groups };
+    executor.execute(cmd, millis());
+  }
+  if (entry.device) {
+    ShowCommand cmd = { CMD_SET_DEVICE, (int32_t)nodeId, entry.device };
+    executor.execute(cmd, millis());
+  }
+  applyRole();
+  printAddress();
+  return true;
+}
+
+// The image is already checked against its CRC; esp_ota_set_boot_partition
+// checks it's a valid app for this chip before switching
+bool commitFirmware(void* ctx, const FleetAnnounce& object, JournalStore* slot) {
+  if (esp_ota_set_boot_partition(esp_ota_get_next_update_partition(0)) != ESP_OK) return false;
+  restartAt = millis() + 1000;   // Let the DONE report go out first
+  return true;
+}
+
+/**
+ * Hand the saved fleet key (if any) to the receiver
+ */
+void loadFleetKey() {
+  uint8_t key[FLEET_KEY_SIZE];
+  prefs.begin(FLEET_KEY_NVS, true);
+  bool ok = prefs.getBytes("key", key, sizeof(key)) == sizeof(key);
+  prefs.end();
+  fleet.setKey(ok ? key : 0);
+}
+
+void printFleetStatus() {
+  Serial.print("📦 Firmware v");
+  Serial.print(fleet.version(FLEET_FIRMWARE));
+  Serial.print(" | config v");
+  Serial.print(fleet.version(FLEET_CONFIG));
+  Serial.print(" | last: ");
+  Serial.print(fleetStatusName(fleet.lastStatus()));
+  Serial.println(fleet.hasKey() ? " | key set" : " | no key, updates off");
+  if (fleet.receiving()) {
+    Serial.print("📥 Receiving ");
+    Serial.print(fleet.kind() == FLEET_FIRMWARE ? "firmware" : "config");
+    Serial.print(": ");
+    Serial.print(fleet.received());
+    Serial.print("/");
+    Serial.print(fleet.chunkCount());
+    Serial.println(" chunks");
+  }
+}
+
+void updateFleet() {
+  fleet_frame frame;
+  while (xQueueReceive(fleetQueue, &frame, 0) == pdTRUE) {
+    fleet.onMessage(frame.data, frame.len, millis());
+  }
+  fleet.update(millis());
+
+  if (fleet.receiving() != fleetWasReceiving) {
+    fleetWasReceiving = fleet.receiving();
+    if (fleetWasReceiving) {
+      printFleetStatus();
     } else {
-      Serial.println("Unknown command. Try: start, stop, on, off, scene1-3, pattern0-9");
+      Serial.print("📦 Fleet update: ");
+      Serial.println(fleetStatusName(fleet.lastStatus()));
     }
   }
+  if (restartAt && (int32_t)(millis() - restartAt) >= 0) {
+    Serial.println("🔄 Restarting into the new firmware");
+    ESP.restart();
+  }
+}
+
+void cmdFleet(uint8_t argc, char* argv[], void* ctx) {
+  printFleetStatus();
+}
+
+// fleetkey <64 hex digits> | fleetkey clear
+void cmdFleetKey(uint8_t argc, char* argv[], void* ctx) {
+  uint8_t key[FLEET_KEY_SIZE];
+  if (argc < 2) {
+    Serial.println(fleet.hasKey() ? "🔑 Fleet key set" : "🔑 No fleet key - fleet updates are off");
+    return;
+  }
+  bool clear = strcasecmp(argv[1], "clear") == 0;
+  if (!clear && !fleetHexDecode(argv[1], key, sizeof(key))) {
+    Serial.println("Usage: fleetkey [<64 hex digits> | clear]");
+    return;
+  }
+  prefs.begin(FLEET_KEY_NVS, false);
+  bool saved = clear ? prefs.remove("key") : prefs.putBytes("key", key, sizeof(key)) == sizeof(key);
+  prefs.end();
+  if (!saved) Serial.println("⚠️ Fleet key not saved");
+  loadFleetKey();
+  printFleetStatus();
+}
+
+// role [master|receiver]
+void cmdRole(uint8_t argc, char* argv[], void* ctx) {
+  if (argv[1]) {
+    uint8_t role = nodeRoleFromName(argv[1]);
+    if (role == ROLE_COUNT) {
+      Serial.println("Usage: role [master|receiver]");
+      return;
+    }
+    if (!nodeConfig.setRole(role)) Serial.println("⚠️ Not saved - back to the old role after a reset");
+    applyRole();
+    return;
+  }
+  Serial.print("🎭 Role: ");
+  Serial.println(nodeRoleName(nodeConfig.role()));
+}
+
+/**
+ * Serial command handlers (master only)
+ */
+void cmdStart(uint8_t argc, char* argv[], void* ctx)   { sendCommand(CMD_SHOW_START); }
+void cmdStop(uint8_t argc, char* argv[], void* ctx)    { sendCommand(CMD_SHOW_STOP); }
+void cmdOn(uint8_t argc, char* argv[], void* ctx)      { sendCommand(CMD_LED_ON); }
+void cmdOff(uint8_t argc, char* argv[], void* ctx)     { sendCommand(CMD_LED_OFF); }
+void cmdScene(uint8_t argc, char* argv[], void* ctx)   { sendCommand(CMD_SCENE, consoleInt(argv[1])); }
+void cmdPattern(uint8_t argc, char* argv[], void* ctx) { sendCommand(CMD_PATTERN, consoleInt(argv[1])); }
+
+// "all" -> 0 (every addressed node), otherwise a node ID in hex
+uint32_t parseNode(const char* arg) {
+  if (!arg || strcasecmp(arg, "all") == 0) return 0;
+  return (uint32_t)strtoul(arg, 0, 16);
+}
+
+// zone 1,3 <command...>
+void cmdZone(uint8_t argc, char* argv[], void* ctx) {
+  uint32_t mask = argc >= 3 ? showGroupMask(argv[1]) : 0;
+  if (!mask) {
+    Serial.println("Usage: zone <group,group,...> <command>");
+    return;
+  }
+  lineGroups = mask;
+  console.dispatch(argc - 2, argv + 2);
+  lineGroups = 0;
+}
+
+// range 1-40 <command...>
+void cmdRange(uint8_t argc, char* argv[], void* ctx) {
+  const char* dash = argv[1] ? strchr(argv[1], '-') : 0;
+  if (argc < 3 || !dash) {
+    Serial.println("Usage: range <lo>-<hi> <command>");
+    return;
+  }
+  lineRangeLo = (uint16_t)atoi(argv[1]);
+  lineRangeHi = (uint16_t)atoi(dash + 1);
+  lineRange = true;
+  console.dispatch(argc - 2, argv + 2);
+  lineRange = false;
+}
+
+void cmdSetGroups(uint8_t argc, char* argv[], void* ctx) {
+  uint32_t mask = argc >= 3 ? showGroupMask(argv[2]) : 0;
+  if (!mask) {
+    Serial.println("Usage: setgroups <node|all> <group,group,...>");
+    return;
+  }
+  sendCommand(CMD_SET_GROUPS, (int)parseNode(argv[1]), (int)mask);
+}
+
+void cmdSetDevice(uint8_t argc, char* argv[], void* ctx) {
+  if (argc < 3) {
+    Serial.println("Usage: setdevice <node|all> <number>");
+    return;
+  }
+  sendCommand(CMD_SET_DEVICE, (int)parseNode(argv[1]), consoleInt(argv[2]));
+}
+
+void cmdStatus(uint8_t argc, char* argv[], void* ctx) {
+  printAddress();
+  Serial.print("🚫 Filtered frames: ");
+  Serial.println(filteredCount);
+}
+
+void cmdUnknown(uint8_t argc, char* argv[], void* ctx) {
+  Serial.println("Unknown command. Try: start, stop, on, off, scene1-3, pattern0-9, zone, range, setgroups, setdevice, status, log, role, fleet, fleetkey");
+}
+
+const ConsoleCommand serialCommands[] = {
+  { "start",   cmdStart },
+  { "stop",    cmdStop },
+  { "on",      cmdOn },
+  { "off",     cmdOff },
+  { "scene",   cmdScene },
+  { "pattern", cmdPattern },
+  { "zone",      cmdZone },
+  { "range",     cmdRange },
+  { "setgroups", cmdSetGroups },
+  { "setdevice", cmdSetDevice },
+  { "status",    cmdStatus },
+  { "log",       cmdLog },
+  { "role",      cmdRole },
+  { "fleet",     cmdFleet },
+  { "fleetkey",  cmdFleetKey },
+};
+
+// Slaves only take log, status, role, fleet and fleetkey
+const ConsoleCommand slaveCommands[] = {
+  { "log",       cmdLog },
+  { "status",    cmdStatus },
+  { "role",      cmdRole },
+  { "fleet",     cmdFleet },
+  { "fleetkey",  cmdFleetKey },
+};
+
+/**
+ * Console commands for the board's role
+ */
+void applyRole() {
+  if (nodeConfig.isMaster()) {
+    console.begin(serialCommands, sizeof(serialCommands) / sizeof(serialCommands[0]), 0, cmdUnknown);
+    Serial.println("\n📝 Commands:");
+    Serial.println("  start  - Start show");
+    Serial.println("  stop   - Stop show");
+    Serial.println("  on     - LED on");
+    Serial.println("  off    - LED off");
+    Serial.println("  scene1 - Scene 1");
+    Serial.println("  scene2 - Scene 2");
+    Serial.println("  scene3 - Scene 3");
+    Serial.println("  pattern0-9 - LED patterns");
+    Serial.println("  zone 1,3 <cmd>    - Only groups 1 and 3");
+    Serial.println("  range 1-40 <cmd>  - Only devices 1..40");
+    Serial.println("  setgroups <node|all> 1,3 - Assign groups");
+    Serial.println("  setdevice <node> 17      - Assign device number");
+    Serial.println("  status - Address and filter count");
+    Serial.println("  log [capture|dump|replay|stop|clear] - Command log");
+    Serial.println("  role [master|receiver] - Show or change this board's role");
+    Serial.println("  fleet  - Firmware/config versions and updates");
+    Serial.println("  fleetkey <hex> - Key fleet updates must be signed with");
+    Serial.println("\n🎬 Ready for commands!\n");
+  } else {
+    console.begin(slaveCommands, sizeof(slaveCommands) / sizeof(slaveCommands[0]), 0, cmdUnknown);
+    Serial.println("\n👂 Listening for commands... (log, status, role, fleet, fleetkey on the console)\n");
+  }
+}
+
+/**
+ * Process serial commands - only takes bytes that have already arrived,
+ * so a half-typed line never stalls the LED or the radio
+ */
+void processSerialCommand() {
+  int n = Serial.available();
+  while (n-- > 0) {
+    console.push((char)Serial.read());
+  }
 }
 
 /**
  * Update LED based on current pattern
  */
 void updateLED() {
-  unsigned long now = millis();
-  
-  switch (ledPattern) {
-    case 0: // Off
-      digitalWrite(LED_PIN, LOW);
-      break;
-      
-    case 1: // Slow blink
-      if (now - lastPatternChange > 1000) {
-        digitalWrite(LED_PIN, !digitalRead(LED_PIN));
-        lastPatternChange = now;
-      }
-      break;
-      
-    case 2: // Fast blink
-      if (now - lastPatternChange > 200) {
-        digitalWrite(LED_PIN, !digitalRead(LED_PIN));
-        lastPatternChange = now;
-      }
-      break;
-      
-    case 3: // Strobe
-      if (now - lastPatternChange > 50) {
-        digitalWrite(LED_PIN, !digitalRead(LED_PIN));
-        lastPatternChange = now;
-      }
-      break;
-      
-    case 10: // Scene 1 - slow pulse
-    case 11: // Scene 2 - medium pulse
-    case 12: // Scene 3 - fast pulse
-      int interval = 1000 / (ledPattern - 9);
-      if (now - lastPatternChange > interval) {
-        digitalWrite(LED_PIN, !digitalRead(LED_PIN));
-        lastPatternChange = now;
-      }
-      break;
-  }
+  digitalWrite(LED_PIN, executor.ledLevel(millis()) ? HIGH : LOW);
 }
 
 void setup() {
   Serial.begin(115200);
   pinMode(LED_PIN, OUTPUT);
+
+  // A fixture that rebooted mid-show picks up its last scene
+  stateStore.begin();
+  StateSource restored = stateStore.restore(executor, millis());
+  updateLED();
+  
+  // Command log continues where it left off
+  bool logOk = logStore.begin(CMDLOG_PARTITION, CMDLOG_MAX_SECTORS);
+  recorder.begin(logOk ? &logStore : 0, micros());
+
+  // Role and fleet config version
+  bool configOk = configStore.begin(NODE_CONFIG_PARTITION);
+  nodeConfig.begin(configOk ? &configStore : 0);
   
   // Set device as WiFi Station
   WiFi.mode(WIFI_STA);
+  nodeId = (uint32_t)(ESP.getEfuseMac() >> 16);
+  executor.setNodeId(nodeId);
   
   Serial.println("\n\n🎬 ESP-NOW Synchronized Show Control");
   Serial.println("=====================================");
   Serial.print("📱 MAC Address: ");
   Serial.println(WiFi.macAddress());
   Serial.print("🎭 Role: ");
-  Serial.println(IS_MASTER ? "MASTER" : "SLAVE");
+  Serial.print(nodeRoleName(nodeConfig.role()));
+  Serial.println(nodeConfig.loaded() ? "" : " (default)");
+  Serial.print("📦 Firmware v");
+  Serial.println(CHAOS_FW_VERSION);
+  Serial.print("💾 Show state: ");
+  Serial.println(stateSourceName(restored));
+  printLogStatus();
+  printAddress();
   Serial.println("=====================================\n");
   
+  fleetQueue = xQueueCreateStatic(FLEET_QUEUE_LEN, sizeof(fleet_frame), fleetQueueStorage, &fleetQueueBuffer);
+  cueQueue = xQueueCreateStatic(Board::rxQueueLen, sizeof(cue_frame), cueQueueStorage, &cueQueueBuffer);
+
   // Initialize ESP-NOW
   if (esp_now_init() != ESP_OK) {
     Serial.println("❌ Error initializing ESP-NOW");
@@ -228,40 +677,35 @@ void setup() {
   esp_now_register_recv_cb(OnDataRecv);
   
   // Register peer (broadcast)
-  esp_now_peer_info_t peerInfo;
-  memset(&peerInfo, 0, sizeof(peerInfo));
-  memcpy(peerInfo.peer_addr, broadcastAddress, 6);
-  peerInfo.channel = 0;  
-  peerInfo.encrypt = false;
-  
-  if (esp_now_add_peer(&peerInfo) != ESP_OK){
+  if (!espnow.begin()) {
     Serial.println("❌ Failed to add peer");
     return;
   }
   
   Serial.println("✅ Peer registered");
-  
-  if (IS_MASTER) {
-    Serial.println("\n📝 Commands:");
-    Serial.println("  start  - Start show");
-    Serial.println("  stop   - Stop show");
-    Serial.println("  on     - LED on");
-    Serial.println("  off    - LED off");
-    Serial.println("  scene1 - Scene 1");
-    Serial.println("  scene2 - Scene 2");
-    Serial.println("  scene3 - Scene 3");
-    Serial.println("  pattern0-9 - LED patterns");
-    Serial.println("\n🎬 Ready for commands!\n");
-  } else {
-    Serial.println("\n👂 Listening for commands...\n");
+
+  // Fleet updates. This image made it this far, so keep it (if the
+  // bootloader was waiting to roll it back).
+  fleet.begin(nodeId, Board::kind, fleetSend);
+  loadFleetKey();
+  fleet.accept(FLEET_CONFIG, &configSlot, 0, nodeConfig.config().configVersion, commitConfig);
+  if (firmwareSlot.begin(esp_ota_get_next_update_partition(0), FLEET_MAX_SECTORS) &&
+      runningImage.begin(esp_ota_get_running_partition(), FLEET_MAX_SECTORS)) {
+    fleet.accept(FLEET_FIRMWARE, &firmwareSlot, &runningImage, CHAOS_FW_VERSION, commitFirmware);
   }
+  esp_ota_mark_app_valid_cancel_rollback();
+
+  applyRole();
 }
 
 void loop() {
-  if (IS_MASTER) {
-    processSerialCommand();
-  }
+  receiveCues();
+  processSerialCommand();
+  recorder.flush();
+  updateReplay();
+  updateFleet();
   
   updateLED();
+  stateStore.update(executor);
   delay(10);
 }
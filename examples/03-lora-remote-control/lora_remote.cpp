@@ -15,6 +15,18 @@
  * - Very low power consumption
  * - Works without any infrastructure
  * - Frequency hopping for reliability
+ * - Optional forward error correction (FEC) so receivers can rebuild
+ *   lost cues without a round-trip (see `fec` serial command)
+ * - Non-blocking round-trip probes and a per-peer link quality table
+ *   (RSSI, SNR, RTT, loss) shown by the `status` command
+ * - Same command frame and executor as the web and ESP-NOW sketches
+ *   (lib/ChaosShow: ShowCommand.h, ShowExecutor.h)
+ * - Command log: every cue sent or received is recorded to flash with
+ *   its timestamp, source and outcome, and can be captured over serial
+ *   or replayed (see `log` serial command and CommandLog.h)
+ * - One build for both ends: transmitter or receiver is a setting saved
+ *   in flash - `role transmitter` / `role receiver` on the serial console
+ *   (NodeConfig.h)
  * 
  * WIRING (if using separate LoRa module):
  * LoRa Module  ->  ESP32
@@ -28,8 +40,25 @@
  * DIO0         ->  GPIO 26
  */
 
+#include <BoardProfile.h>
+
+#if !CHAOS_WITH_LORA
+#error "This sketch needs LoRa - build it with an env that has CHAOS_WITH_LORA=1"
+#endif
+
 #include <SPI.h>
 #include <LoRa.h>
+#include <FecCodec.h>
+#include <PeerTable.h>
+#include <ShowCommand.h>
+#include <ShowExecutor.h>
+#include <LoRaTransport.h>
+#include <SerialConsole.h>
+#include <ShowStateStore.h>
+#include <BootTimer.h>
+#include <CommandLog.h>
+#include <PartitionStore.h>
+#include <NodeConfig.h>
 
 // Pin definitions (adjust for your board)
 #define LORA_SCK     5
@@ -45,22 +74,86 @@
 // 915E6 for North America
 #define LORA_FREQUENCY 915E6
 
+// Radio settings: maximum range, ~2.5 s on air per cue
+#define LORA_SF          12
+#define LORA_BANDWIDTH   125E3
+#define LORA_CODING_RATE 8     // 4/8
+#define LORA_PREAMBLE    8
+
 // Configuration
-#define IS_TRANSMITTER true  // Set to false for receiver - MUST RECOMPILE after changing!
 #define LED_PIN 2
 
-// Message structure
-struct LoRaMessage {
-  char command[16];
-  int value1;
-  int value2;
-  uint32_t messageId;
-};
+// FEC defaults (tune per show with the `fec <k> <m>` command)
+#define FEC_DEFAULT_K    4     // Cues per block
+#define FEC_DEFAULT_M    2     // Repair packets per block
+#define FEC_FLUSH_PACKETS 2    // Close a partial block after this many idle airtimes
+
+// Probe replies: wait for the sender to switch to RX, then spread
+// replies from many receivers over PONG_SLOTS time slots. A slot is one
+// PONG's airtime plus the guard (see pongSlotMs), so replies in
+// different slots never overlap.
+#define PONG_GUARD_MS    50
+#define PONG_SLOTS       8
 
+// Messages are ShowFrames (lib/ChaosShow/src/ShowCommand.h)
+LoRaTransport lora;
+ShowExecutor executor;
+SerialConsole console;
+ShowStateStore stateStore;   // Survives resets: RTC memory + flash journal
+BootTimer bootTimer;
+PartitionStore logStore;
+CommandRecorder recorder;    // Every cue in and out, on the "cmdlog" partition
+CommandLogReader logReader;
+CommandReplayer replayer;
+PartitionStore configStore;
+NodeConfigStore nodeConfig;  // Transmitter or receiver, saved in flash
 uint32_t messageCounter = 0;
-int ledState = LOW;
-int currentScene = 0;
-bool showRunning = false;
+
+// Forward error correction state
+FecEncoder fecEncoder;
+FecDecoder fecDecoder;
+bool fecEnabled = false;
+unsigned long fecLastSend = 0;   // End of the last cue's transmit
+uint32_t fecFlushMs = 0;         // Set from the airtime in initLoRa()
+uint8_t fecRepairNext = 0;
+bool fecRepairing = false;
+
+// Newest cue executed per sender. A cue rebuilt from repair packets
+// arrives after the rest of its block, so it only runs if nothing later
+// from the same sender has run yet.
+#define SEQ_SENDERS 8
+struct SenderSeq {
+  uint32_t sender;   // 0 = free
+  uint32_t seq;
+};
+SenderSeq senderSeqs[SEQ_SENDERS];
+uint8_t senderSeqNext = 0;
+
+// Link quality
+uint32_t nodeId = 0;
+uint32_t filteredCount = 0;   // Cues for other groups/devices
+uint32_t staleCount = 0;      // Rebuilt cues dropped: a later cue had already run
+PeerTable peerTable;
+LinkProbe linkProbe(peerTable);
+unsigned long probeIntervalMs = 0;   // 0 = only probe on `ping`
+unsigned long lastProbeAt = 0;
+bool pongPending = false;
+uint16_t pongSeq = 0;
+unsigned long pingHeardAt = 0;
+unsigned long pongDueAt = 0;
+uint32_t pongSlotMs = 0;     // Set from the radio settings in setup()
+
+bool executeCommand(const ShowCommand& cmd);
+void printHelp();
+void printStatus();
+void printPeers();
+
+/**
+ * Time on air of a `len` byte packet with the settings above
+ */
+uint32_t airtimeMs(size_t len) {
+  return loraAirtimeMs(len, LORA_SF, LORA_BANDWIDTH, LORA_CODING_RATE, LORA_PREAMBLE);
+}
 
 /**
  * Initialize LoRa module
@@ -79,10 +172,10 @@ bool initLoRa() {
   }
   
   // Configure LoRa for maximum range
-  LoRa.setSpreadingFactor(12);        // SF12 = max range, slowest
-  LoRa.setSignalBandwidth(125E3);     // 125kHz bandwidth
-  LoRa.setCodingRate4(8);             // Error correction
-  LoRa.setPreambleLength(8);          // Preamble length
+  LoRa.setSpreadingFactor(LORA_SF);           // SF12 = max range, slowest
+  LoRa.setSignalBandwidth(LORA_BANDWIDTH);    // 125kHz bandwidth
+  LoRa.setCodingRate4(LORA_CODING_RATE);      // Error correction
+  LoRa.setPreambleLength(LORA_PREAMBLE);      // Preamble length
   LoRa.setTxPower(20);                // Max power (20dBm)
   LoRa.enableCrc();                   // Enable CRC checking
   
@@ -92,34 +185,301 @@ bool initLoRa() {
   Serial.println(" MHz");
   Serial.print("📶 TX Power: 20 dBm");
   Serial.println();
+
+  // Size the PONG slots from the longest packet we send (a FEC-wrapped
+  // frame), and wait for the PING's own airtime plus every slot
+  uint32_t cueMs = airtimeMs(sizeof(ShowFrame));
+  pongSlotMs = airtimeMs(FEC_HEADER_SIZE + sizeof(ShowFrame)) + PONG_GUARD_MS;
+  fecFlushMs = FEC_FLUSH_PACKETS * airtimeMs(FEC_HEADER_SIZE + sizeof(ShowFrame));
+  linkProbe.setTimeout(cueMs + PONG_GUARD_MS + PONG_SLOTS * pongSlotMs + 1000);
+  Serial.print("⏱️ Airtime per cue: ");
+  Serial.print(cueMs);
+  Serial.print(" ms, probe replies within ");
+  Serial.print(linkProbe.timeout() / 1000);
+  Serial.println(" s");
   
   return true;
 }
 
+/**
+ * Put one raw packet on air
+ */
+bool transmitPacket(const uint8_t* data, size_t len) {
+  return lora.send(data, len);
+}
+
+/**
+ * Record a cue. Nothing is recorded while a replay runs, so a replay
+ * never feeds on its own output. PING/PONG are link probes, not cues:
+ * a probe every 30 s would fill the log and come back on replay.
+ */
+void logCommand(const ShowCommand& cmd, uint8_t source, uint8_t outcome) {
+  if (cmd.id == CMD_PING || cmd.id == CMD_PONG) return;
+  if (!replayer.running()) recorder.record(cmd, source, outcome, micros());
+}
+
+/**
+ * Send the next repair packet of the current FEC block.
+ * Called from loop() so repair traffic never holds up serial input.
+ */
+void sendNextRepair() {
+  if (fecRepairNext < fecEncoder.repairCount()) {
+    uint8_t packet[FEC_MAX_PACKET];
+    size_t len = fecEncoder.makeRepair(fecRepairNext, packet);
+    transmitPacket(packet, len);
+    fecRepairNext++;
+  }
+
+  if (fecRepairNext >= fecEncoder.repairCount()) {
+    Serial.print("🛡️ FEC block closed: ");
+    Serial.print(fecEncoder.pending());
+    Serial.print(" cues + ");
+    Serial.print(fecEncoder.repairCount());
+    Serial.println(" repair");
+    fecEncoder.closeBlock();
+    fecRepairing = false;
+    fecRepairNext = 0;
+  }
+}
+
+/**
+ * Close the FEC block when it is full, or when no cue has followed the
+ * last one for FEC_FLUSH_PACKETS packets' airtime. Timed from the end
+ * of the transmit: at SF12 sending a cue alone takes seconds.
+ */
+void updateFec() {
+  if (!fecEnabled) return;
+
+  if (!fecRepairing && fecEncoder.pending() > 0) {
+    if (fecEncoder.blockFull() || millis() - fecLastSend > fecFlushMs) {
+      fecRepairing = true;
+      fecRepairNext = 0;
+    }
+  }
+
+  if (fecRepairing) {
+    sendNextRepair();
+  }
+}
+
 /**
  * Send command via LoRa
  */
-void sendLoRaCommand(const char* cmd, int val1 = 0, int val2 = 0) {
-  LoRaMessage msg;
-  strncpy(msg.command, cmd, 15);
-  msg.command[15] = '\0';
-  msg.value1 = val1;
-  msg.value2 = val2;
-  msg.messageId = messageCounter++;
+bool sendLoRaCommand(uint8_t id, int val1 = 0, int val2 = 0) {
+  ShowCommand cmd = { id, val1, val2 };
+  ShowFrame msg;
+  showFrameEncode(msg, cmd, nodeId, messageCounter++, millis());
+  bool sent;
   
-  // Send packet
-  LoRa.beginPacket();
-  LoRa.write((uint8_t*)&msg, sizeof(msg));
-  LoRa.endPacket();
+  if (fecEnabled) {
+    // Finish the previous block's repairs before starting a new one.
+    // A burst of cues (pasted lines, a fast replay) can fill a block
+    // before loop() gets to close it, so close it here.
+    if (fecEncoder.blockFull()) {
+      fecRepairing = true;
+    }
+    while (fecRepairing) {
+      sendNextRepair();
+    }
+    uint8_t packet[FEC_MAX_PACKET];
+    size_t len = fecEncoder.addData((uint8_t*)&msg, packet);
+    sent = len > 0 && transmitPacket(packet, len);
+    fecLastSend = millis();
+  } else {
+    sent = transmitPacket((uint8_t*)&msg, sizeof(msg));
+  }
+  logCommand(cmd, SOURCE_SERIAL, sent ? OUTCOME_SENT : OUTCOME_SEND_FAILED);
   
-  Serial.print("📤 Sent: ");
-  Serial.print(cmd);
+  Serial.print(sent ? "📤 Sent: " : "❌ Send failed: ");
+  Serial.print(showCommandName(id));
   Serial.print(" [");
   Serial.print(val1);
   Serial.print(",");
   Serial.print(val2);
   Serial.print("] #");
-  Serial.println(msg.messageId);
+  Serial.println(msg.seq);
+  return sent;
+}
+
+/**
+ * Enable FEC with k cues + m repair packets per block, or disable it
+ */
+void configureFec(bool enable, int k = FEC_DEFAULT_K, int m = FEC_DEFAULT_M) {
+  // Flush whatever is in flight under the old settings
+  if (fecEnabled && fecEncoder.pending() > 0) {
+    fecRepairing = true;
+    while (fecRepairing) {
+      sendNextRepair();
+    }
+  }
+
+  if (!enable) {
+    fecEnabled = false;
+    Serial.println("🛡️ FEC disabled");
+    return;
+  }
+
+  if (k < 1 || k > FEC_MAX_K || m < 0 || m > FEC_MAX_M) {
+    Serial.print("❌ FEC needs k=1..");
+    Serial.print(FEC_MAX_K);
+    Serial.print(", m=0..");
+    Serial.println(FEC_MAX_M);
+    return;
+  }
+
+  fecEncoder.configure(k, m, sizeof(ShowFrame));
+  fecEnabled = true;
+  Serial.print("🛡️ FEC enabled: k=");
+  Serial.print(k);
+  Serial.print(" m=");
+  Serial.print(m);
+  Serial.print(" (");
+  Serial.print(100 * m / k);
+  Serial.println("% overhead)");
+}
+
+/**
+ * Broadcast a round-trip probe. Replies are matched in handleProbe().
+ */
+void sendProbe() {
+  uint16_t seq = linkProbe.startProbe(millis());
+  sendLoRaCommand(CMD_PING, seq);
+}
+
+/**
+ * PING/PONG handling. Never blocks: a PING only schedules the PONG,
+ * which updateProbes() sends from loop() once it is due.
+ * Returns true if the message was a probe.
+ */
+bool handleProbe(const ShowFrame& msg) {
+  if (msg.command == CMD_PING) {
+    Serial.println("🏓 PING received! Scheduling PONG...");
+    pongPending = true;
+    pongSeq = (uint16_t)msg.value1;
+    pingHeardAt = millis();
+    pongDueAt = pingHeardAt + PONG_GUARD_MS + (nodeId % PONG_SLOTS) * pongSlotMs;
+    return true;
+  }
+
+  if (msg.command == CMD_PONG) {
+    int32_t rtt = linkProbe.onReply(msg.sender, (uint16_t)msg.value1, msg.value2, millis());
+    Serial.print("🏓 PONG from ");
+    Serial.print(msg.sender, HEX);
+    if (rtt >= 0) {
+      Serial.print(" RTT: ");
+      Serial.print(rtt);
+      Serial.println(" ms");
+    } else {
+      Serial.println(" (late or duplicate)");
+    }
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * Send due PONGs, expire old probes and run periodic probing
+ */
+void updateProbes() {
+  unsigned long now = millis();
+
+  if (pongPending && (long)(now - pongDueAt) >= 0) {
+    pongPending = false;
+    // Tell the prober how long we held the reply so it can subtract it
+    sendLoRaCommand(CMD_PONG, pongSeq, now - pingHeardAt);
+  }
+
+  linkProbe.update(now);
+
+  if (probeIntervalMs > 0 && now - lastProbeAt >= probeIntervalMs) {
+    lastProbeAt = now;
+    sendProbe();
+  }
+}
+
+/**
+ * Remember `seq` as the newest cue executed from `sender`
+ */
+void noteSenderSeq(uint32_t sender, uint32_t seq) {
+  for (uint8_t i = 0; i < SEQ_SENDERS; i++) {
+    if (senderSeqs[i].sender == sender) {
+      senderSeqs[i].seq = seq;
+      return;
+    }
+  }
+  senderSeqs[senderSeqNext].sender = sender;
+  senderSeqs[senderSeqNext].seq = seq;
+  senderSeqNext = (uint8_t)((senderSeqNext + 1) % SEQ_SENDERS);
+}
+
+/**
+ * True if a later cue from `sender` than `seq` has already run
+ */
+bool supersededCue(uint32_t sender, uint32_t seq) {
+  for (uint8_t i = 0; i < SEQ_SENDERS; i++) {
+    if (senderSeqs[i].sender == sender) return (int32_t)(seq - senderSeqs[i].seq) <= 0;
+  }
+  return false;
+}
+
+/**
+ * Print and execute one received message
+ */
+void handleLoRaMessage(const ShowFrame& msg, bool recovered) {
+  int rssi = LoRa.packetRssi();
+  float snr = LoRa.packetSnr();
+  
+  // A recovered message was rebuilt later from other packets, so the
+  // radio readings (and any probe timing) don't belong to it
+  if (!recovered) {
+    peerTable.onPacket(msg.sender, rssi, snr, millis());
+    if (handleProbe(msg)) return;
+  } else if (supersededCue(msg.sender, msg.seq)) {
+    // Running it now would undo the later cues (e.g. SCENE 1 after SCENE 2)
+    staleCount++;
+    Serial.print("🛡️ Recovered cue #");
+    Serial.print(msg.seq);
+    Serial.println(" skipped: a later cue already ran");
+    return;
+  }
+  
+  Serial.println(recovered ? "\n🛡️ Message Recovered (FEC):" : "\n📨 Message Received:");
+  Serial.print("  Command: ");
+  Serial.println(showCommandName(msg.command));
+  Serial.print("  Values: [");
+  Serial.print(msg.value1);
+  Serial.print(",");
+  Serial.print(msg.value2);
+  Serial.println("]");
+  Serial.print("  Message ID: ");
+  Serial.println(msg.seq);
+  Serial.print("  RSSI: ");
+  Serial.print(rssi);
+  Serial.println(" dBm");
+  Serial.print("  SNR: ");
+  Serial.print(snr);
+  Serial.println(" dB");
+  
+  // Execute command. Received cues always set the newest seq, even a
+  // lower one: the sender may have rebooted and started counting again.
+  noteSenderSeq(msg.sender, msg.seq);
+  ShowCommand cmd = showFrameCommand(msg);
+  bool ok = executeCommand(cmd);
+  logCommand(cmd, SOURCE_LORA, ok ? OUTCOME_EXECUTED : OUTCOME_REJECTED);
+}
+
+/**
+ * FEC decoder callback - payload is always a ShowFrame
+ */
+void onFecDeliver(const uint8_t* payload, uint8_t len, bool recovered) {
+  if (!showFrameForMe(payload, len, executor.state().address)) {
+    filteredCount++;
+    return;
+  }
+  ShowFrame msg;
+  if (!showFrameDecode(payload, len, msg)) return;
+  handleLoRaMessage(msg, recovered);
 }
 
 /**
@@ -128,116 +488,205 @@ void sendLoRaCommand(const char* cmd, int val1 = 0, int val2 = 0) {
 void receiveLoRa() {
   int packetSize = LoRa.parsePacket();
   
-  if (packetSize == sizeof(LoRaMessage)) {
-    LoRaMessage msg;
-    LoRa.readBytes((uint8_t*)&msg, sizeof(msg));
-    
-    int rssi = LoRa.packetRssi();
-    float snr = LoRa.packetSnr();
-    
-    Serial.println("\n📨 Message Received:");
-    Serial.print("  Command: ");
-    Serial.println(msg.command);
-    Serial.print("  Values: [");
-    Serial.print(msg.value1);
-    Serial.print(",");
-    Serial.print(msg.value2);
-    Serial.println("]");
-    Serial.print("  Message ID: ");
-    Serial.println(msg.messageId);
-    Serial.print("  RSSI: ");
-    Serial.print(rssi);
-    Serial.println(" dBm");
-    Serial.print("  SNR: ");
-    Serial.print(snr);
-    Serial.println(" dB");
+  if (packetSize == sizeof(ShowFrame)) {
+    // Plain packet (FEC off on the transmitter)
+    uint8_t packet[sizeof(ShowFrame)];
+    LoRa.readBytes(packet, packetSize);
+    if (!showFrameForMe(packet, packetSize, executor.state().address)) {
+      filteredCount++;
+      return;
+    }
+    ShowFrame msg;
+    if (showFrameDecode(packet, packetSize, msg)) {
+      handleLoRaMessage(msg, false);
+    }
     
-    // Execute command
-    executeCommand(msg.command, msg.value1, msg.value2);
+  } else if (packetSize == FEC_HEADER_SIZE + sizeof(ShowFrame)) {
+    uint8_t packet[FEC_MAX_PACKET];
+    LoRa.readBytes(packet, packetSize);
+    fecDecoder.receive(packet, packetSize);
   }
 }
 
 /**
  * Execute received command
  */
-void executeCommand(const char* cmd, int val1, int val2) {
-  if (strcmp(cmd, "LED_ON") == 0) {
-    digitalWrite(LED_PIN, HIGH);
-    ledState = HIGH;
-    Serial.println("💡 LED ON");
-    
-  } else if (strcmp(cmd, "LED_OFF") == 0) {
-    digitalWrite(LED_PIN, LOW);
-    ledState = LOW;
-    Serial.println("💡 LED OFF");
-    
-  } else if (strcmp(cmd, "LED_TOGGLE") == 0) {
-    ledState = !ledState;
-    digitalWrite(LED_PIN, ledState);
-    Serial.println("💡 LED TOGGLED");
-    
-  } else if (strcmp(cmd, "SHOW_START") == 0) {
-    showRunning = true;
-    Serial.println("🎬 SHOW STARTED!");
-    digitalWrite(LED_PIN, HIGH);
-    
-  } else if (strcmp(cmd, "SHOW_STOP") == 0) {
-    showRunning = false;
-    Serial.println("⏹️ SHOW STOPPED!");
-    digitalWrite(LED_PIN, LOW);
-    
-  } else if (strcmp(cmd, "SCENE") == 0) {
-    currentScene = val1;
-    Serial.print("🎭 Scene changed to: ");
-    Serial.println(val1);
-    
-  } else if (strcmp(cmd, "PING") == 0) {
-    Serial.println("🏓 PING received! Sending PONG...");
-    if (IS_TRANSMITTER == false) {
-      delay(100);
-      sendLoRaCommand("PONG");
-    }
-    
-  } else if (strcmp(cmd, "PONG") == 0) {
-    Serial.println("🏓 PONG received!");
-    
-  } else {
+bool executeCommand(const ShowCommand& cmd) {
+  if (!executor.execute(cmd, millis())) {
     Serial.print("❓ Unknown command: ");
-    Serial.println(cmd);
+    Serial.println(cmd.id);
+    return false;
+  }
+  
+  switch (cmd.id) {
+    case CMD_LED_ON:     Serial.println("💡 LED ON"); break;
+    case CMD_LED_OFF:    Serial.println("💡 LED OFF"); break;
+    case CMD_LED_TOGGLE: Serial.println("💡 LED TOGGLED"); break;
+    case CMD_SHOW_START: Serial.println("🎬 SHOW STARTED!"); break;
+    case CMD_SHOW_STOP:  Serial.println("⏹️ SHOW STOPPED!"); break;
+    case CMD_SCENE:
+      Serial.print("🎭 Scene changed to: ");
+      Serial.println(cmd.value1);
+      break;
+    default:
+      // Probes are answered in handleProbe(); a recovered one is stale
+      break;
   }
+  return true;
 }
 
 /**
- * Process serial commands (for transmitter)
+ * Command log: serial capture, replay and the `log` console command
  */
-void processSerialCommand() {
-  if (Serial.available() > 0) {
-    String input = Serial.readStringUntil('\n');
-    input.trim();
-    input.toLowerCase();
-    
-    if (input == "start") {
-      sendLoRaCommand("SHOW_START");
-    } else if (input == "stop") {
-      sendLoRaCommand("SHOW_STOP");
-    } else if (input == "on") {
-      sendLoRaCommand("LED_ON");
-    } else if (input == "off") {
-      sendLoRaCommand("LED_OFF");
-    } else if (input == "toggle") {
-      sendLoRaCommand("LED_TOGGLE");
-    } else if (input == "ping") {
-      sendLoRaCommand("PING");
-    } else if (input.startsWith("scene")) {
-      int sceneNum = input.substring(5).toInt();
-      sendLoRaCommand("SCENE", sceneNum);
-    } else if (input == "help") {
-      printHelp();
-    } else if (input == "status") {
-      printStatus();
-    } else {
-      Serial.println("❓ Unknown command. Type 'help' for commands.");
+void streamRecord(void* ctx, const CommandRecord& rec) {
+  char line[CMDLOG_LINE_SIZE];
+  commandRecordToLine(rec, line);
+  Serial.println(line);
+}
+
+// The transmitter re-sends what it sent; received cues run here again
+uint8_t replayCommand(void* ctx, const CommandRecord& rec) {
+  ShowCommand cmd = commandRecordCommand(rec);
+  if (rec.outcome == OUTCOME_SENT || rec.outcome == OUTCOME_SEND_FAILED) {
+    return sendLoRaCommand(cmd.id, cmd.value1, cmd.value2) ? OUTCOME_SENT : OUTCOME_SEND_FAILED;
+  }
+  return executeCommand(cmd) ? OUTCOME_EXECUTED : OUTCOME_REJECTED;
+}
+
+void printLogStatus() {
+  const CommandLogStats& st = recorder.stats();
+  Serial.print("  Command log: ");
+  Serial.print(recorder.hasStore() ? recorder.stored() : 0);
+  Serial.print(" records in flash, ");
+  Serial.print(st.overflow + st.writeFailed);
+  Serial.print(" dropped, capture ");
+  Serial.print(recorder.streaming() ? "on" : "off");
+  if (replayer.running()) {
+    Serial.print(", replaying (");
+    Serial.print(replayer.stats().replayed);
+    Serial.print(" so far)");
+  }
+  Serial.println();
+}
+
+void updateReplay() {
+  if (!replayer.running() || replayer.update(micros())) return;
+  const ReplayStats& st = replayer.stats();
+  Serial.print("📼 Replay done: ");
+  Serial.print(st.replayed);
+  Serial.print(" cues, ");
+  Serial.print(st.mismatched);
+  Serial.print(" different outcome, worst ");
+  Serial.print(st.maxLateUs / 1000);
+  Serial.println(" ms late");
+}
+
+/**
+ * Serial command handlers
+ */
+void cmdStart(uint8_t argc, char* argv[], void* ctx)  { sendLoRaCommand(CMD_SHOW_START); }
+void cmdStop(uint8_t argc, char* argv[], void* ctx)   { sendLoRaCommand(CMD_SHOW_STOP); }
+void cmdOn(uint8_t argc, char* argv[], void* ctx)     { sendLoRaCommand(CMD_LED_ON); }
+void cmdOff(uint8_t argc, char* argv[], void* ctx)    { sendLoRaCommand(CMD_LED_OFF); }
+void cmdToggle(uint8_t argc, char* argv[], void* ctx) { sendLoRaCommand(CMD_LED_TOGGLE); }
+void cmdScene(uint8_t argc, char* argv[], void* ctx)  { sendLoRaCommand(CMD_SCENE, consoleInt(argv[1])); }
+void cmdPing(uint8_t argc, char* argv[], void* ctx)   { sendProbe(); }
+void cmdHelp(uint8_t argc, char* argv[], void* ctx)   { printHelp(); }
+void cmdStatus(uint8_t argc, char* argv[], void* ctx) { printStatus(); }
+
+void cmdProbe(uint8_t argc, char* argv[], void* ctx) {
+  probeIntervalMs = consoleInt(argv[1]) * 1000UL;
+  // Let every reply slot of one probe pass before the next PING goes out
+  if (probeIntervalMs > 0 && probeIntervalMs < linkProbe.timeout()) {
+    probeIntervalMs = (linkProbe.timeout() + 999) / 1000 * 1000;
+  }
+  Serial.print("🏓 Auto probe every ");
+  Serial.print(probeIntervalMs / 1000);
+  Serial.println(probeIntervalMs ? " s" : " s (off)");
+}
+
+void cmdFec(uint8_t argc, char* argv[], void* ctx) {
+  if (argv[1] && strcasecmp(argv[1], "off") == 0) {
+    configureFec(false);
+  } else {
+    configureFec(true, consoleInt(argv[1], FEC_DEFAULT_K), consoleInt(argv[2], FEC_DEFAULT_M));
+  }
+}
+
+void cmdLog(uint8_t argc, char* argv[], void* ctx) {
+  const char* sub = argv[1] ? argv[1] : "";
+  if (strcasecmp(sub, "capture") == 0) {
+    bool on = argv[2] && strcasecmp(argv[2], "on") == 0;
+    recorder.setStream(on ? streamRecord : 0);
+  } else if (strcasecmp(sub, "dump") == 0) {
+    CommandRecord rec;
+    logReader.begin(&logStore);
+    while (logReader.next(rec)) streamRecord(0, rec);
+  } else if (strcasecmp(sub, "replay") == 0) {
+    recorder.flush();
+    logReader.begin(&logStore);
+    bool fast = argv[2] && strcasecmp(argv[2], "fast") == 0;
+    replayer.start(&logReader, replayCommand, 0, fast ? REPLAY_FAST : REPLAY_REALTIME, micros());
+    Serial.println(fast ? "▶️ Replaying as fast as possible" : "▶️ Replaying at 1x");
+    return;
+  } else if (strcasecmp(sub, "stop") == 0) {
+    replayer.stop();
+  } else if (strcasecmp(sub, "clear") == 0) {
+    replayer.stop();
+    recorder.clear();
+  } else if (sub[0]) {
+    Serial.println("Usage: log [capture on|off | dump | replay [fast] | stop | clear]");
+    return;
+  }
+  printLogStatus();
+}
+
+const char* roleLabel() {
+  return nodeConfig.isMaster() ? "TRANSMITTER" : "RECEIVER";
+}
+
+// role [transmitter|receiver]
+void cmdRole(uint8_t argc, char* argv[], void* ctx) {
+  if (argv[1]) {
+    uint8_t role = nodeRoleFromName(argv[1]);
+    if (role == ROLE_COUNT) {
+      Serial.println("Usage: role [transmitter|receiver]");
+      return;
     }
+    if (!nodeConfig.setRole(role)) Serial.println("⚠️ Not saved - back to the old role after a reset");
+  }
+  Serial.print("🎭 Role: ");
+  Serial.println(roleLabel());
+}
+
+void cmdUnknown(uint8_t argc, char* argv[], void* ctx) {
+  Serial.println("❓ Unknown command. Type 'help' for commands.");
+}
+
+const ConsoleCommand serialCommands[] = {
+  { "start",  cmdStart },
+  { "stop",   cmdStop },
+  { "on",     cmdOn },
+  { "off",    cmdOff },
+  { "toggle", cmdToggle },
+  { "scene",  cmdScene },
+  { "ping",   cmdPing },
+  { "probe",  cmdProbe },
+  { "fec",    cmdFec },
+  { "help",   cmdHelp },
+  { "status", cmdStatus },
+  { "log",    cmdLog },
+  { "role",   cmdRole },
+};
+
+/**
+ * Process serial commands - only takes bytes that have already arrived,
+ * so a half-typed line never stalls the radio or the LED
+ */
+void processSerialCommand() {
+  int n = Serial.available();
+  while (n-- > 0) {
+    console.push((char)Serial.read());
   }
 }
 
@@ -252,44 +701,122 @@ void printHelp() {
   Serial.println("  off       - LED off");
   Serial.println("  toggle    - Toggle LED");
   Serial.println("  scene1-9  - Change scene");
-  Serial.println("  ping      - Test connection");
+  Serial.println("  ping      - Test connection (measures RTT)");
+  Serial.println("  probeN    - Probe every N seconds (probe0 = off)");
+  Serial.println("  fec K M   - FEC: K cues + M repair packets per block");
+  Serial.println("  fec off   - Disable FEC");
   Serial.println("  status    - Show system status");
+  Serial.println("  log       - Command log (capture on|off, dump, replay [fast], stop, clear)");
+  Serial.println("  role      - Show or change the role (transmitter|receiver)");
   Serial.println("  help      - Show this help");
   Serial.println();
 }
 
+/**
+ * Print the link quality table
+ */
+void printPeers() {
+  unsigned long now = millis();
+
+  Serial.print("\n📶 Peers (");
+  Serial.print(peerTable.size());
+  Serial.println("):");
+  if (peerTable.size() == 0) {
+    Serial.println("  (none heard yet)");
+    return;
+  }
+  Serial.println("  Node      RSSI   SNR    RTT    Loss  Seen");
+  for (uint8_t i = 0; i < peerTable.size(); i++) {
+    const PeerStats& p = peerTable.at(i);
+    char line[80];
+    snprintf(line, sizeof(line), "  %08lX  %4d  %5.1f  %5lu  %3u%%  %lus ago",
+             (unsigned long)p.id, p.rssi(), p.snr(),
+             (unsigned long)p.rttMs(), p.lossPercent(),
+             (unsigned long)((now - p.lastSeen) / 1000));
+    Serial.println(line);
+  }
+}
+
 /**
  * Print system status
  */
 void printStatus() {
   Serial.println("\n📊 System Status:");
   Serial.print("  Role: ");
-  Serial.println(IS_TRANSMITTER ? "TRANSMITTER" : "RECEIVER");
+  Serial.println(roleLabel());
   Serial.print("  Frequency: ");
   Serial.print(LORA_FREQUENCY / 1E6);
   Serial.println(" MHz");
   Serial.print("  Messages sent: ");
   Serial.println(messageCounter);
   Serial.print("  LED State: ");
-  Serial.println(ledState ? "ON" : "OFF");
+  Serial.println(executor.ledLevel(millis()) ? "ON" : "OFF");
   Serial.print("  Show Running: ");
-  Serial.println(showRunning ? "YES" : "NO");
+  Serial.println(executor.state().showRunning ? "YES" : "NO");
   Serial.print("  Current Scene: ");
-  Serial.println(currentScene);
+  Serial.println(executor.state().scene);
+  Serial.print("  FEC: ");
+  if (fecEnabled) {
+    Serial.print("k=");
+    Serial.print(fecEncoder.k());
+    Serial.print(" m=");
+    Serial.println(fecEncoder.m());
+  } else {
+    Serial.println("off");
+  }
+  Serial.print("  FEC recovered/lost/stale: ");
+  Serial.print(fecDecoder.recoveredCount());
+  Serial.print("/");
+  Serial.print(fecDecoder.lostCount());
+  Serial.print("/");
+  Serial.println(staleCount);
+  Serial.print("  Node ID: ");
+  Serial.println(nodeId, HEX);
+  Serial.print("  Groups/device: 0x");
+  Serial.print(executor.state().address.groups, HEX);
+  Serial.print(" / ");
+  Serial.println(executor.state().address.device);
+  Serial.print("  Filtered (other zones): ");
+  Serial.println(filteredCount);
+  printLogStatus();
+  printPeers();
   Serial.println();
 }
 
 void setup() {
+  bootTimer.mark("core", micros());
   Serial.begin(115200);
   pinMode(LED_PIN, OUTPUT);
-  digitalWrite(LED_PIN, LOW);
   
-  delay(1000);
+  // Back in the last scene before the radio is even up
+  stateStore.begin();
+  StateSource restored = stateStore.restore(executor, millis());
+  digitalWrite(LED_PIN, executor.ledLevel(millis()) ? HIGH : LOW);
+  bootTimer.mark("state", micros());
+  
+  // Command log continues where it left off
+  bool logOk = logStore.begin(CMDLOG_PARTITION, CMDLOG_MAX_SECTORS);
+  recorder.begin(logOk ? &logStore : 0, micros());
+  bootTimer.mark("log", micros());
+  
+  // Transmitter or receiver
+  bool configOk = configStore.begin(NODE_CONFIG_PARTITION);
+  nodeConfig.begin(configOk ? &configStore : 0);
+  bootTimer.mark("config", micros());
+  
+  nodeId = (uint32_t)(ESP.getEfuseMac() >> 16);
+  executor.setNodeId(nodeId);
+  fecEncoder.configure(FEC_DEFAULT_K, FEC_DEFAULT_M, sizeof(ShowFrame));
+  fecDecoder.onDeliver(onFecDeliver);
   
   Serial.println("\n\n🎬 LoRa Long-Range Remote Control");
   Serial.println("====================================");
   Serial.print("🎭 Mode: ");
-  Serial.println(IS_TRANSMITTER ? "TRANSMITTER" : "RECEIVER");
+  Serial.print(roleLabel());
+  Serial.println(nodeConfig.loaded() ? "" : " (default)");
+  Serial.print("💾 Show state: ");
+  Serial.println(stateSourceName(restored));
+  printLogStatus();
   Serial.println("====================================\n");
   
   // Initialize LoRa
@@ -301,42 +828,46 @@ void setup() {
       delay(200);
     }
   }
+  bootTimer.mark("lora", micros());
+  
+  console.begin(serialCommands, sizeof(serialCommands) / sizeof(serialCommands[0]), 0, cmdUnknown);
+  
+  FixedString<160> report;
+  bootTimer.format(report);
+  Serial.print("⏱️ Boot: ");
+  Serial.println(report.c_str());
   
-  if (IS_TRANSMITTER) {
+  if (nodeConfig.isMaster()) {
     Serial.println("📡 Transmitter ready!");
     printHelp();
   } else {
     Serial.println("📻 Receiver ready!");
-    Serial.println("👂 Listening for commands...\n");
-  }
-  
-  // Flash LED to indicate ready
-  for (int i = 0; i < 3; i++) {
-    digitalWrite(LED_PIN, HIGH);
-    delay(200);
-    digitalWrite(LED_PIN, LOW);
-    delay(200);
+    Serial.println("👂 Listening for commands... (`role transmitter` to send)\n");
   }
 }
 
 void loop() {
-  if (IS_TRANSMITTER) {
-    // Transmitter mode: send commands from serial
-    processSerialCommand();
-    
-  } else {
-    // Receiver mode: listen for LoRa messages
-    receiveLoRa();
-  }
+  // Serial console on both roles (`status` shows the peer table)
+  processSerialCommand();
   
-  // Show heartbeat on LED if show is running
-  if (showRunning) {
-    static unsigned long lastBlink = 0;
-    if (millis() - lastBlink > 1000) {
-      digitalWrite(LED_PIN, !digitalRead(LED_PIN));
-      lastBlink = millis();
-    }
+  if (nodeConfig.isMaster()) {
+    // Transmitter mode: close FEC blocks, listen for PONGs
+    updateFec();
   }
   
+  // Listen for LoRa messages
+  receiveLoRa();
+  updateProbes();
+  
+  // LED effect for the current show state (heartbeat while running)
+  digitalWrite(LED_PIN, executor.ledLevel(millis()) ? HIGH : LOW);
+  
+  // Persist show state when a cue changed it
+  stateStore.update(executor);
+  
+  // Command log to flash (and serial capture), then any replay
+  recorder.flush();
+  updateReplay();
+  
   delay(10);
 }
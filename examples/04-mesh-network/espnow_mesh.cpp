@@ -0,0 +1,602 @@
+/**
+ * ESP-NOW Mesh Show Control
+ *
+ * Extends the ESP-NOW sync example (02-espnow-sync) beyond one hop. Every
+ * node relays cues for its neighbours, so a venue larger than one radio
+ * range is covered by the fixtures themselves - no extra infrastructure.
+ *
+ * FEATURES:
+ * - Controlled flooding with TTL (hop limit)
+ * - Duplicate suppression: every node remembers recently seen frames
+ * - Jittered rebroadcast so neighbours don't all transmit at once, and
+ *   cancelled rebroadcasts when enough neighbours already relayed
+ * - Reverse-path route learning: replies to the master travel back
+ *   along the path the cue came in on instead of flooding
+ *
+ * Routing lives in lib/ChaosShow/src/MeshRouter.h. Use
+ * bench/mesh_sim_bench.cpp to see how it behaves with 10-500 nodes.
+ *
+ * On dual-core chips (ESP32, S3) routing runs in its own task on the
+ * protocol core; on the C3 it runs from loop(). See BoardProfile.h.
+ *
+ * USAGE:
+ * 1. Upload this code to every ESP32 board
+ * 2. Type commands into the serial monitor of ANY node - cues reach
+ *    the whole mesh
+ * 3. `to <node> <command>` sends a cue to a single node
+ * 4. `poll 3` opens an audience vote with 3 options; `vote 2` on any
+ *    node votes. Relays merge votes on the way (VoteTally.h), so the
+ *    node running the poll only hears from its direct neighbours.
+ *    `results` shows the tally.
+ * 5. `log` shows the command log: every cue sent or delivered here and
+ *    every vote cast, on the "cmdlog" partition (CommandLog.h). Same
+ *    sub-commands as 02-espnow-sync: capture, dump, replay, stop, clear.
+ */
+
+#include <BoardProfile.h>
+
+#if !CHAOS_WITH_ESPNOW
+#error "This sketch needs ESP-NOW - build it with an env that has CHAOS_WITH_ESPNOW=1"
+#endif
+
+#include <esp_now.h>
+#include <WiFi.h>
+#include <MeshRouter.h>
+#include <ShowCommand.h>
+#include <ShowExecutor.h>
+#include <SerialConsole.h>
+#include <ShowStateStore.h>
+#include <VoteTally.h>
+#include <ShowScheduler.h>
+#include <PartitionStore.h>
+#include <CommandLog.h>
+
+// Configuration
+#define LED_PIN 2
+#define MESH_TTL 8          // Max hops; raise for very large venues
+#define UNICAST_PEERS 6     // Next hops kept registered with ESP-NOW
+#define VOTE_HOPS 4         // Recent tally parents, for withdrawals
+
+// Broadcast address (FF:FF:FF:FF:FF:FF sends to all)
+uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+// Mesh payloads are ShowFrames, the same cue format as 02-espnow-sync
+
+// Frame handed from the ESP-NOW callback to loop()
+typedef struct rx_frame {
+  uint8_t mac[6];
+  uint8_t len;
+  uint8_t data[MESH_MAX_FRAME];
+} rx_frame;
+
+MeshRouter mesh;
+VoteTally tally;
+ShowScheduler radio;         // Radio task or loop(), per board
+ShowExecutor executor;
+SerialConsole console;
+ShowStateStore stateStore;   // Survives resets: RTC memory + flash journal
+PartitionStore logStore;
+CommandRecorder recorder;    // Every cue in and out, on the "cmdlog" partition
+CommandLogReader logReader;
+CommandReplayer replayer;
+QueueHandle_t rxQueue;
+
+// Static storage for the receive queue - nothing allocated at runtime
+uint8_t rxQueueStorage[Board::rxQueueLen * sizeof(rx_frame)];
+StaticQueue_t rxQueueBuffer;
+uint32_t nodeId = 0;
+uint32_t filteredCount = 0;   // Cues for other groups/devices
+uint32_t messageCounter = 0;
+uint32_t commandDest = MESH_BROADCAST;   // Set by `to <node>` for one line
+uint32_t pollMaster = 0;     // Node that opened the current poll
+uint8_t pollNumber = 0;
+
+// Fixed pool of unicast peer slots; the oldest is recycled when full.
+// ESP-NOW's own peer list is capped, and adding every next hop ever
+// seen would eventually fail mid-show.
+uint8_t unicastPeers[UNICAST_PEERS][6];
+uint8_t unicastPeerCount = 0;
+uint8_t unicastPeerNext = 0;
+
+// Next hops the tally has sent to, newest first: a parent we moved away
+// from still has to be reached for its withdrawal
+uint8_t voteHops[VOTE_HOPS][6];
+
+bool executeCommand(const ShowCommand& cmd, uint32_t sender);
+
+/**
+ * Record a command. Called from radioWork() or under the scheduler
+ * Guard, so only one task records at a time. Nothing is recorded while
+ * a replay runs, so a replay never feeds on its own output.
+ */
+void logCommand(const ShowCommand& cmd, uint8_t source, uint8_t outcome) {
+  if (!replayer.running()) recorder.record(cmd, source, outcome, micros());
+}
+
+/**
+ * Router -> radio. mac = NULL means broadcast.
+ */
+void meshSend(void* ctx, const uint8_t* mac, const uint8_t* frame, size_t len) {
+  const uint8_t* dest = mac ? mac : broadcastAddress;
+
+  // Unicast next hops must be registered peers
+  if (mac && !esp_now_is_peer_exist(mac)) {
+    if (unicastPeerCount == UNICAST_PEERS) {
+      esp_now_del_peer(unicastPeers[unicastPeerNext]);
+    } else {
+      unicastPeerCount++;
+    }
+    memcpy(unicastPeers[unicastPeerNext], mac, 6);
+    unicastPeerNext = (unicastPeerNext + 1) % UNICAST_PEERS;
+
+    esp_now_peer_info_t peerInfo;
+    memset(&peerInfo, 0, sizeof(peerInfo));
+    memcpy(peerInfo.peer_addr, mac, 6);
+    peerInfo.channel = 0;
+    peerInfo.encrypt = false;
+    esp_now_add_peer(&peerInfo);
+  }
+
+  esp_now_send(dest, frame, len);
+}
+
+/**
+ * Node IDs are the last four bytes of the station MAC (see setup()), so
+ * a next hop's ID is known from its address
+ */
+uint32_t nodeIdFromMac(const uint8_t* mac) {
+  return (uint32_t)mac[2] | ((uint32_t)mac[3] << 8) |
+         ((uint32_t)mac[4] << 16) | ((uint32_t)mac[5] << 24);
+}
+
+/**
+ * Point the tally at the current route towards whoever opened the poll.
+ * With no route we keep the old parent - its sends fail until one is
+ * learned again.
+ */
+void updateVoteParent() {
+  const uint8_t* hop = mesh.routeTo(pollMaster, millis());
+  if (!hop) return;
+  if (memcmp(hop, voteHops[0], 6) != 0) {
+    memmove(voteHops[1], voteHops[0], (VOTE_HOPS - 1) * 6);
+    memcpy(voteHops[0], hop, 6);
+  }
+  tally.setParent(nodeIdFromMac(hop));
+}
+
+/**
+ * Vote summaries go one hop towards whoever opened the poll, along the
+ * route its poll cue came in on; withdrawals go to a parent we left.
+ * Sent raw - the next hop merges them, it doesn't relay them.
+ */
+bool voteSend(void* ctx, uint32_t parent, const uint8_t* data, size_t len) {
+  if (!parent) return false;
+  for (uint8_t i = 0; i < VOTE_HOPS; i++) {
+    if (nodeIdFromMac(voteHops[i]) == parent) {
+      meshSend(ctx, voteHops[i], data, len);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Router -> application: a cue for this node
+ */
+void meshDeliver(void* ctx, const MeshHeader& hdr, const uint8_t* payload) {
+  // The router relays every cue; only act on the ones for our zone
+  if (!showFrameForMe(payload, hdr.len, executor.state().address)) {
+    filteredCount++;
+    return;
+  }
+
+  ShowFrame msg;
+  if (!showFrameDecode(payload, hdr.len, msg)) return;
+
+  Serial.println("\n📨 Mesh Message:");
+  Serial.print("  Command: ");
+  Serial.println(showCommandName(msg.command));
+  Serial.print("  From: ");
+  Serial.println(hdr.origin, HEX);
+  Serial.print("  Hops: ");
+  Serial.println(hdr.hops + 1);
+
+  ShowCommand cmd = showFrameCommand(msg);
+  bool ok = executeCommand(cmd, msg.sender);
+  logCommand(cmd, SOURCE_MESH, ok ? OUTCOME_EXECUTED : OUTCOME_REJECTED);
+}
+
+/**
+ * Callback when data is received - runs in the WiFi task, so just
+ * queue the frame for radioWork()
+ */
+void OnDataRecv(const uint8_t * mac, const uint8_t *incomingData, int len) {
+  if (len <= 0 || len > MESH_MAX_FRAME) return;
+
+  rx_frame frame;
+  memcpy(frame.mac, mac, 6);
+  frame.len = len;
+  memcpy(frame.data, incomingData, len);
+  xQueueSend(rxQueue, &frame, 0);
+}
+
+/**
+ * Everything the radio needs done: frames in, rebroadcasts and vote
+ * summaries out. Runs in the radio task or from loop(), with the
+ * scheduler lock held.
+ */
+void radioWork(void* ctx) {
+  rx_frame frame;
+  while (xQueueReceive(rxQueue, &frame, 0) == pdTRUE) {
+    // Vote summaries from our children; everything else is mesh traffic
+    if (!tally.onSummary(frame.data, frame.len, millis())) {
+      mesh.onFrame(frame.mac, frame.data, frame.len, millis());
+    }
+  }
+
+  // Jittered rebroadcasts, and our vote summary once per interval
+  mesh.update(millis());
+  if (pollMaster != nodeId) updateVoteParent();
+  tally.update(millis());
+}
+
+/**
+ * Execute received command. Votes only count from this node - the
+ * console or a replay - never from the radio.
+ */
+bool executeCommand(const ShowCommand& cmd, uint32_t sender) {
+  if (cmd.id == CMD_VOTE && (sender != nodeId || !tally.vote((uint8_t)cmd.value2))) {
+    Serial.println("No poll open, or no such option");
+    return false;
+  }
+  if (!executor.execute(cmd, millis())) {
+    Serial.println("❓ Unknown command");
+    return false;
+  }
+
+  switch (cmd.id) {
+    case CMD_LED_ON:     Serial.println("💡 LED ON"); break;
+    case CMD_LED_OFF:    Serial.println("💡 LED OFF"); break;
+    case CMD_SHOW_START: Serial.println("🎬 SHOW STARTED!"); break;
+    case CMD_SHOW_STOP:  Serial.println("⏹️ SHOW STOPPED!"); break;
+    case CMD_PATTERN:
+      Serial.print("🎨 Pattern changed to: ");
+      Serial.println(cmd.value1);
+      break;
+    case CMD_SCENE:
+      Serial.print("🎭 Scene changed to: ");
+      Serial.println(cmd.value1);
+      break;
+    case CMD_POLL_OPEN:
+      // The node that opened the poll is the root of the tally tree
+      pollMaster = sender;
+      pollNumber = (uint8_t)cmd.value1;
+      memset(voteHops, 0, sizeof(voteHops));
+      tally.begin(nodeId, sender == nodeId ? 0 : voteSend);
+      tally.open((uint8_t)cmd.value1, (uint8_t)cmd.value2, millis());
+      Serial.print("🗳️ Poll opened, options: ");
+      Serial.println(tally.options());
+      break;
+    case CMD_VOTE:
+      Serial.println("🗳️ Vote recorded");
+      break;
+  }
+  return true;
+}
+
+/**
+ * Send a cue into the mesh (dest = MESH_BROADCAST for everyone)
+ */
+bool sendCommand(uint32_t dest, uint8_t id, int val1 = 0, int val2 = 0) {
+  ShowCommand cmd = { id, val1, val2 };
+  ShowFrame frame;
+  showFrameEncode(frame, cmd, nodeId, messageCounter++, millis());
+
+  bool sent = mesh.send(dest, (uint8_t*)&frame, sizeof(frame), millis());
+  logCommand(cmd, SOURCE_SERIAL, sent ? OUTCOME_SENT : OUTCOME_SEND_FAILED);
+
+  // The origin doesn't hear its own flood - run it locally too
+  if (dest == MESH_BROADCAST || dest == nodeId) {
+    executeCommand(cmd, nodeId);
+  }
+
+  Serial.print("📤 Sent command: ");
+  Serial.println(showCommandName(id));
+  return sent;
+}
+
+/**
+ * Command log: serial capture, replay and the "log" console command
+ */
+void streamRecord(void* ctx, const CommandRecord& rec) {
+  char line[CMDLOG_LINE_SIZE];
+  commandRecordToLine(rec, line);
+  Serial.println(line);
+}
+
+// Cues this node sent are flooded again (to every node - the
+// destination isn't recorded); delivered cues and votes run here again
+uint8_t replayCommand(void* ctx, const CommandRecord& rec) {
+  ShowCommand cmd = commandRecordCommand(rec);
+  if (rec.outcome == OUTCOME_SENT || rec.outcome == OUTCOME_SEND_FAILED) {
+    return sendCommand(MESH_BROADCAST, cmd.id, cmd.value1, cmd.value2) ? OUTCOME_SENT : OUTCOME_SEND_FAILED;
+  }
+  return executeCommand(cmd, nodeId) ? OUTCOME_EXECUTED : OUTCOME_REJECTED;
+}
+
+void printLogStatus() {
+  const CommandLogStats& st = recorder.stats();
+  Serial.print("📼 Log: ");
+  Serial.print(recorder.hasStore() ? recorder.stored() : 0);
+  Serial.print(" records in flash | recorded ");
+  Serial.print(st.recorded);
+  Serial.print(" | dropped ");
+  Serial.print(st.overflow + st.writeFailed);
+  Serial.print(" | capture ");
+  Serial.println(recorder.streaming() ? "on" : "off");
+  if (replayer.running()) {
+    Serial.print("▶️ Replaying: ");
+    Serial.print(replayer.stats().replayed);
+    Serial.println(" commands so far");
+  }
+}
+
+void updateReplay() {
+  if (!replayer.running() || replayer.update(micros())) return;
+  const ReplayStats& st = replayer.stats();
+  Serial.print("📼 Replay done: ");
+  Serial.print(st.replayed);
+  Serial.print(" commands, ");
+  Serial.print(st.mismatched);
+  Serial.print(" different outcome, worst ");
+  Serial.print(st.maxLateUs / 1000);
+  Serial.println(" ms late");
+}
+
+/**
+ * Print mesh counters
+ */
+void printStatus() {
+  const MeshStats& s = mesh.stats();
+  Serial.println("\n📊 Mesh Status:");
+  Serial.print("  Node ID: ");
+  Serial.println(nodeId, HEX);
+  Serial.print("  Originated: ");
+  Serial.println(s.originated);
+  Serial.print("  Delivered: ");
+  Serial.println(s.delivered);
+  Serial.print("  Forwarded: ");
+  Serial.println(s.forwarded);
+  Serial.print("  Duplicates dropped: ");
+  Serial.println(s.duplicates);
+  Serial.print("  Rebroadcasts suppressed: ");
+  Serial.println(s.suppressed);
+  Serial.print("  TTL expired: ");
+  Serial.println(s.expired);
+  Serial.print("  Routed unicasts: ");
+  Serial.println(s.routedUnicast);
+  Serial.print("  Groups/device: 0x");
+  Serial.print(executor.state().address.groups, HEX);
+  Serial.print(" / ");
+  Serial.println(executor.state().address.device);
+  Serial.print("  Filtered (other zones): ");
+  Serial.println(filteredCount);
+  Serial.println();
+}
+
+/**
+ * Serial command handlers (any node can send)
+ */
+void cmdStart(uint8_t argc, char* argv[], void* ctx)   { sendCommand(commandDest, CMD_SHOW_START); }
+void cmdStop(uint8_t argc, char* argv[], void* ctx)    { sendCommand(commandDest, CMD_SHOW_STOP); }
+void cmdOn(uint8_t argc, char* argv[], void* ctx)      { sendCommand(commandDest, CMD_LED_ON); }
+void cmdOff(uint8_t argc, char* argv[], void* ctx)     { sendCommand(commandDest, CMD_LED_OFF); }
+void cmdScene(uint8_t argc, char* argv[], void* ctx)   { sendCommand(commandDest, CMD_SCENE, consoleInt(argv[1])); }
+void cmdPattern(uint8_t argc, char* argv[], void* ctx) { sendCommand(commandDest, CMD_PATTERN, consoleInt(argv[1])); }
+void cmdStatus(uint8_t argc, char* argv[], void* ctx)  { printStatus(); }
+
+// poll 3 - open a vote with 3 options across the mesh
+void cmdPoll(uint8_t argc, char* argv[], void* ctx) {
+  int options = consoleInt(argv[1]);
+  if (options < 2 || options > VOTE_MAX_OPTIONS) {
+    Serial.println("Usage: poll <2-8 options>");
+    return;
+  }
+  sendCommand(MESH_BROADCAST, CMD_POLL_OPEN, pollNumber + 1, options);
+}
+
+// vote 2 - options are numbered from 1
+void cmdVote(uint8_t argc, char* argv[], void* ctx) {
+  ShowCommand cmd = { CMD_VOTE, tally.poll(), consoleInt(argv[1]) - 1 };
+  bool ok = executeCommand(cmd, nodeId);
+  logCommand(cmd, SOURCE_SERIAL, ok ? OUTCOME_EXECUTED : OUTCOME_REJECTED);
+}
+
+void cmdLog(uint8_t argc, char* argv[], void* ctx) {
+  const char* sub = argc >= 2 ? argv[1] : "";
+  if (strcasecmp(sub, "capture") == 0) {
+    bool on = argc >= 3 && strcasecmp(argv[2], "on") == 0;
+    recorder.setStream(on ? streamRecord : 0);
+  } else if (strcasecmp(sub, "dump") == 0) {
+    CommandRecord rec;
+    logReader.begin(&logStore);
+    while (logReader.next(rec)) streamRecord(0, rec);
+  } else if (strcasecmp(sub, "replay") == 0) {
+    recorder.flush();
+    logReader.begin(&logStore);
+    bool fast = argc >= 3 && strcasecmp(argv[2], "fast") == 0;
+    replayer.start(&logReader, replayCommand, 0, fast ? REPLAY_FAST : REPLAY_REALTIME, micros());
+    Serial.println(fast ? "▶️ Replaying as fast as possible" : "▶️ Replaying at 1x");
+    return;
+  } else if (strcasecmp(sub, "stop") == 0) {
+    replayer.stop();
+  } else if (strcasecmp(sub, "clear") == 0) {
+    replayer.stop();
+    recorder.clear();
+  } else if (sub[0]) {
+    Serial.println("Usage: log [capture on|off | dump | replay [fast] | stop | clear]");
+    return;
+  }
+  printLogStatus();
+}
+
+void cmdResults(uint8_t argc, char* argv[], void* ctx) {
+  const VoteStats& s = tally.stats();
+  Serial.print("\n🗳️ Poll ");
+  Serial.print(tally.poll());
+  Serial.print(" - ");
+  Serial.print(tally.voters());
+  Serial.println(pollMaster == nodeId ? " votes" : " votes in this subtree");
+  for (uint8_t i = 0; i < tally.options(); i++) {
+    Serial.print("  ");
+    Serial.print(i + 1);
+    Serial.print(": ");
+    Serial.println(tally.count(i));
+  }
+  Serial.print("  Children: ");
+  Serial.print(tally.children());
+  Serial.print(" | summaries in/merged/dup: ");
+  Serial.print(s.received);
+  Serial.print("/");
+  Serial.print(s.merged);
+  Serial.print("/");
+  Serial.print(s.duplicates);
+  Serial.print(" | sent: ");
+  Serial.println(s.sent);
+}
+
+void cmdUnknown(uint8_t argc, char* argv[], void* ctx) {
+  Serial.println("Unknown command. Try: start, stop, on, off, scene1-3, pattern0-9, status, poll, vote, results, log, to <node> <cmd>");
+}
+
+/**
+ * "to 7A3F01C2 scene 2" - run the rest of the line for a single node
+ */
+void cmdTo(uint8_t argc, char* argv[], void* ctx) {
+  if (argc < 3) {
+    Serial.println("Usage: to <node id> <command>");
+    return;
+  }
+  commandDest = strtoul(argv[1], NULL, 16);
+  console.dispatch(argc - 2, argv + 2);
+  commandDest = MESH_BROADCAST;
+}
+
+const ConsoleCommand serialCommands[] = {
+  { "start",   cmdStart },
+  { "stop",    cmdStop },
+  { "on",      cmdOn },
+  { "off",     cmdOff },
+  { "scene",   cmdScene },
+  { "pattern", cmdPattern },
+  { "status",  cmdStatus },
+  { "to",      cmdTo },
+  { "poll",    cmdPoll },
+  { "vote",    cmdVote },
+  { "results", cmdResults },
+  { "log",     cmdLog },
+};
+
+/**
+ * Process serial commands - only takes bytes that have already arrived,
+ * so a half-typed line never holds up relaying
+ */
+void processSerialCommand() {
+  int n = Serial.available();
+  while (n-- > 0) {
+    console.push((char)Serial.read());
+  }
+}
+
+/**
+ * Update LED based on current pattern
+ */
+void updateLED() {
+  digitalWrite(LED_PIN, executor.ledLevel(millis()) ? HIGH : LOW);
+}
+
+void setup() {
+  Serial.begin(115200);
+  pinMode(LED_PIN, OUTPUT);
+
+  // A fixture that rebooted mid-show picks up its last scene
+  stateStore.begin();
+  StateSource restored = stateStore.restore(executor, millis());
+  updateLED();
+
+  // Command log continues where it left off
+  bool logOk = logStore.begin(CMDLOG_PARTITION, CMDLOG_MAX_SECTORS);
+  recorder.begin(logOk ? &logStore : 0, micros());
+
+  // Set device as WiFi Station
+  WiFi.mode(WIFI_STA);
+
+  nodeId = (uint32_t)(ESP.getEfuseMac() >> 16);
+  executor.setNodeId(nodeId);
+
+  Serial.println("\n\n🕸️ ESP-NOW Mesh Show Control");
+  Serial.println("=====================================");
+  Serial.print("📱 MAC Address: ");
+  Serial.println(WiFi.macAddress());
+  Serial.print("🆔 Node ID: ");
+  Serial.println(nodeId, HEX);
+  Serial.print("💾 Show state: ");
+  Serial.println(stateSourceName(restored));
+  Serial.print("🧩 Board: ");
+  Serial.print(Board::name());
+  Serial.print(Board::dualCore ? " | radio task on core " : " | cooperative");
+  if (Board::dualCore) Serial.print(Board::radioCore);
+  Serial.print(" | rx queue ");
+  Serial.println(Board::rxQueueLen);
+  Serial.println("=====================================\n");
+
+  rxQueue = xQueueCreateStatic(Board::rxQueueLen, sizeof(rx_frame), rxQueueStorage, &rxQueueBuffer);
+
+  // Initialize ESP-NOW
+  if (esp_now_init() != ESP_OK) {
+    Serial.println("❌ Error initializing ESP-NOW");
+    return;
+  }
+
+  Serial.println("✅ ESP-NOW Initialized");
+
+  esp_now_register_recv_cb(OnDataRecv);
+
+  // Register peer (broadcast)
+  esp_now_peer_info_t peerInfo;
+  memset(&peerInfo, 0, sizeof(peerInfo));
+  memcpy(peerInfo.peer_addr, broadcastAddress, 6);
+  peerInfo.channel = 0;
+  peerInfo.encrypt = false;
+
+  if (esp_now_add_peer(&peerInfo) != ESP_OK){
+    Serial.println("❌ Failed to add peer");
+    return;
+  }
+
+  mesh.begin(nodeId, meshSend, meshDeliver);
+  mesh.setTtl(MESH_TTL);
+  radio.begin(radioWork, 0);
+  console.begin(serialCommands, sizeof(serialCommands) / sizeof(serialCommands[0]), 0, cmdUnknown);
+
+  Serial.println("✅ Mesh ready");
+  Serial.println("\n📝 Commands: start, stop, on, off, scene1-3, pattern0-9, status");
+  Serial.println("   to <node> <command> - send to one node");
+  Serial.println("   poll <n>, vote <n>, results - audience voting");
+  Serial.println("   log [capture on|off | dump | replay [fast] | stop | clear]\n");
+}
+
+void loop() {
+  radio.poll();   // Single core: radio work happens here
+
+  {
+    // Console commands and replays use the router and executor too
+    ShowScheduler::Guard guard(radio);
+    processSerialCommand();
+    updateReplay();
+    updateLED();
+    stateStore.update(executor);
+  }
+  recorder.flush();   // Flash writes, outside the Guard
+  delay(1);
+}
@@ -0,0 +1,785 @@
+/**
+ * Show Gateway: Web -> ESP-NOW + LoRa
+ *
+ * One board that bridges every control path in the project. The web UI
+ * (same routes as src/main.cpp) turns a button press into a ShowFrame,
+ * encodes it ONCE and sends the same bytes over ESP-NOW to nearby
+ * fixtures and over LoRa to far away ones.
+ *
+ * Frames heard on one radio are passed to the other as raw bytes - the
+ * gateway checks the header and remembers (sender, seq) so a cue never
+ * loops back, but it never re-encodes a frame.
+ *
+ * HARDWARE REQUIRED:
+ * - ESP32 with LoRa module (TTGO LoRa32, Heltec WiFi LoRa 32, or similar)
+ *
+ * USAGE:
+ * 1. Upload this code to the gateway board
+ * 2. Flash 02-espnow-sync on ESP-NOW fixtures and 03-lora-remote-control
+ *    (receiver, FEC off) on LoRa fixtures
+ * 3. Connect to the gateway's WiFi and open http://192.168.4.1
+ * 4. Or send any command by name: /cmd?name=PATTERN&v1=2
+ *
+ * Build without a radio by turning it off in platformio.ini
+ * (-DCHAOS_WITH_LORA=0 or -DCHAOS_WITH_ESPNOW=0) - its code is left out.
+ * -DCHAOS_WITH_WEB=0 leaves out the web UI, and with it the access point
+ * and fleet updates (they are started from the web UI): a plain
+ * ESP-NOW <-> LoRa bridge.
+ * On dual-core chips the bridging runs in its own task, so a slow web
+ * client never holds up a cue (BoardProfile.h, ShowScheduler.h). LoRa
+ * has a task of its own: at SF12 a send takes ~2.5 s, so frames for it
+ * are only queued and ESP-NOW, web cues and fleet chunks never wait for
+ * the LoRa airtime.
+ *
+ * FLEET UPDATES (ESP-NOW):
+ * The gateway also distributes config blobs and firmware to every
+ * ESP-NOW fixture at once (FleetUpdate.h):
+ *   /fleet/config?v=2&all=receiver&node=1A2B3C:master:1,3:17
+ *   curl -F image=@delta.bin "http://192.168.4.1/fleet/firmware?version=8&base=7&size=..&crc=.."
+ *   /fleet   - progress of the transfer
+ * scripts/fleet_delta.py makes the firmware payload, signs it with the
+ * fleet key and prints the curl line (with tag=). Config blobs are
+ * signed here, with the key set once on the serial console:
+ *   fleetkey <64 hex digits>
+ * Fixtures take nothing that isn't signed with their key. Firmware over
+ * LoRa isn't offered - at SF12 a 1 MB image would take days of airtime.
+ */
+
+#include <WiFi.h>
+#include <BoardProfile.h>
+#if CHAOS_WITH_WEB
+#include <WebServer.h>
+#endif
+#include <ShowScheduler.h>
+#include <ShowCommand.h>
+#include <ShowExecutor.h>
+#include <ShowTransport.h>
+#include <FixedString.h>
+#include <CommandLog.h>
+#include <PartitionStore.h>
+#if CHAOS_WITH_ESPNOW
+#include <esp_now.h>
+#include <EspNowTransport.h>
+#endif
+
+// Fleet transfers are offered from the web UI, so no web, no fleet
+#define GATEWAY_FLEET (CHAOS_WITH_ESPNOW && CHAOS_WITH_WEB)
+#if GATEWAY_FLEET
+#include <esp_ota_ops.h>
+#include <Preferences.h>
+#include <FleetUpdate.h>
+#include <NodeConfig.h>
+#include <SerialConsole.h>
+#endif
+#if CHAOS_WITH_LORA
+#include <SPI.h>
+#include <LoRa.h>
+#include <LoRaTransport.h>
+#endif
+
+// Access point
+const char* ssid = "ESP_CHAS_GATEWAY";
+const char* password = "chaoslab2024";
+
+// LoRa pins and frequency (same as 03-lora-remote-control)
+#define LORA_SCK     5
+#define LORA_MISO    19
+#define LORA_MOSI    27
+#define LORA_SS      18
+#define LORA_RST     14
+#define LORA_DIO0    26
+#define LORA_FREQUENCY 915E6
+
+#define LED_PIN 2
+#define SEEN_SIZE 32        // Recently bridged (sender, seq) pairs
+
+#define FLEET_QUEUE_LEN 8   // NACK / DONE reports from the fixtures
+#define FLEET_KEY_NVS "fleet"   // NVS namespace of the fleet key
+
+#define LORA_TASK_STACK    3072
+#define LORA_TASK_PRIORITY 1   // Same as loop(): LoRa.endPacket() busy-waits
+
+// ShowFrame bytes handed between tasks: received frames to radioWork()
+// (`source` = SOURCE_ESPNOW / SOURCE_LORA), and frames for the LoRa task
+typedef struct rx_frame {
+  uint8_t len;
+  uint8_t source;
+  uint8_t data[sizeof(ShowFrame)];
+} rx_frame;
+
+#if GATEWAY_FLEET
+// Fleet report handed from the WiFi task to loop()
+typedef struct fleet_frame {
+  uint8_t len;
+  uint8_t data[FLEET_MAX_FRAME];
+} fleet_frame;
+#endif
+
+#if CHAOS_WITH_WEB
+WebServer server(80);
+#endif
+ShowExecutor executor;
+TransportHub hub;
+ShowScheduler radio;         // Bridging task or loop(), per board
+QueueHandle_t rxQueue;
+
+// Static storage for the receive queue - nothing allocated at runtime
+uint8_t rxQueueStorage[Board::rxQueueLen * sizeof(rx_frame)];
+StaticQueue_t rxQueueBuffer;
+#if CHAOS_WITH_ESPNOW
+EspNowTransport espnow;
+#endif
+#if GATEWAY_FLEET
+// Fleet distribution: the config blob in RAM, firmware uploads spooled
+// into this board's idle OTA slot
+FleetSender fleet;
+uint8_t configBlob[FLEET_CONFIG_MAX];
+PartitionStore spool;
+uint32_t spoolSize = 0;
+uint32_t spoolCrc = 0;
+uint16_t spoolErased = 0;   // Sectors erased so far
+bool spoolOk = false;
+QueueHandle_t fleetQueue;
+uint8_t fleetQueueStorage[FLEET_QUEUE_LEN * sizeof(fleet_frame)];
+StaticQueue_t fleetQueueBuffer;
+
+// Key config blobs are signed with, kept in NVS (never in the firmware)
+Preferences prefs;
+SerialConsole console;
+uint8_t fleetKey[FLEET_KEY_SIZE];
+bool fleetKeySet = false;
+#endif
+#if CHAOS_WITH_LORA
+LoRaTransport lora;          // Used by the LoRa task only
+
+// Frames waiting for the LoRa task. The hub gets loraOut, which only
+// queues, so nothing that holds the radio lock waits for the airtime.
+QueueHandle_t loraTxQueue;
+uint8_t loraTxQueueStorage[Board::rxQueueLen * sizeof(rx_frame)];
+StaticQueue_t loraTxQueueBuffer;
+StaticTask_t loraTaskBuffer;
+StackType_t loraTaskStack[Board::dualCore ? LORA_TASK_STACK / sizeof(StackType_t) : 1];
+
+class LoRaQueueTransport : public ShowTransport {
+public:
+  const char* name() const { return "LoRa"; }
+
+  bool send(const uint8_t* data, size_t len) {
+    if (len != sizeof(ShowFrame)) return false;
+    rx_frame frame;
+    frame.len = len;
+    frame.source = SOURCE_NONE;
+    memcpy(frame.data, data, len);
+    return xQueueSend(loraTxQueue, &frame, 0) == pdTRUE;   // Full: dropped, not waited for
+  }
+};
+LoRaQueueTransport loraOut;
+#endif
+
+uint32_t nodeId = 0;
+uint32_t messageCounter = 0;
+uint32_t bridged = 0;
+
+// Every cue issued or bridged, on the "cmdlog" partition. Recorded under
+// the scheduler lock, written to flash from loop().
+PartitionStore logStore;
+CommandRecorder recorder;
+
+#if CHAOS_WITH_WEB
+// Page buffer reused by every request (PSRAM where there is some)
+CHAOS_FRAME_BUFFER FixedString<1024> page;
+#endif
+
+// Loop protection for bridged frames
+struct SeenFrame {
+  uint32_t sender;
+  uint32_t seq;
+};
+SeenFrame seen[SEEN_SIZE];
+uint8_t seenNext = 0;
+
+/**
+ * Remember a frame. Returns false if it was already seen.
+ */
+bool markSeen(uint32_t sender, uint32_t seq) {
+  for (uint8_t i = 0; i < SEEN_SIZE; i++) {
+    if (seen[i].sender == sender && seen[i].seq == seq) return false;
+  }
+  seen[seenNext].sender = sender;
+  seen[seenNext].seq = seq;
+  seenNext = (seenNext + 1) % SEEN_SIZE;
+  return true;
+}
+
+/**
+ * Encode a cue once, fan it out to every radio and run it here too.
+ * `groups` / `rangeLo..rangeHi` limit it to part of the audience (0 = all).
+ */
+void broadcastCommand(uint8_t id, int val1 = 0, int val2 = 0,
+                      uint32_t groups = 0, uint16_t rangeLo = 0, uint16_t rangeHi = 0) {
+  ShowScheduler::Guard guard(radio);   // Shares the hub with bridging
+  ShowCommand cmd = { id, val1, val2 };
+  ShowFrame frame;
+  showFrameEncode(frame, cmd, nodeId, messageCounter++, millis());
+  if (groups) showFrameSetGroups(frame, groups);
+  if (rangeHi) showFrameSetRange(frame, rangeLo, rangeHi);
+  markSeen(frame.sender, frame.seq);
+
+  uint8_t ok = hub.send((const uint8_t*)&frame, sizeof(frame));
+  if (showFrameForMe((const uint8_t*)&frame, sizeof(frame), executor.state().address)) {
+    executor.execute(cmd, millis());
+  }
+  recorder.record(cmd, SOURCE_WEB, ok ? OUTCOME_SENT : OUTCOME_SEND_FAILED, micros());
+
+  Serial.print("📤 ");
+  Serial.print(showCommandName(id));
+  Serial.print(" -> ");
+  Serial.print(ok);
+  Serial.print("/");
+  Serial.print(hub.size());
+  Serial.println(" transports");
+}
+
+/**
+ * Frame received on `from`: pass the same bytes to the others, and run
+ * it here if it's for our groups. Bridging never filters - the gateway
+ * doesn't know who is listening on the other side. `source` is what the
+ * command log records it as.
+ */
+void bridgeFrame(const uint8_t* data, size_t len, ShowTransport* from, uint8_t source) {
+  ShowFrame frame;
+  if (!showFrameDecode(data, len, frame)) return;
+  if (frame.sender == nodeId || !markSeen(frame.sender, frame.seq)) return;
+
+  ShowCommand cmd = showFrameCommand(frame);
+  uint8_t outcome = OUTCOME_FORWARDED;
+  if (showFrameForMe(data, len, executor.state().address)) {
+    outcome = executor.execute(cmd, millis()) ? OUTCOME_EXECUTED : OUTCOME_REJECTED;
+  }
+  hub.send(data, sizeof(ShowFrame), from);
+  bridged++;
+  recorder.record(cmd, source, outcome, micros());
+
+  Serial.print("🔀 ");
+  Serial.print(from->name());
+  Serial.print(" -> others: ");
+  Serial.println(showCommandName(frame.command));
+}
+
+#if CHAOS_WITH_ESPNOW
+/**
+ * ESP-NOW receive callback - runs in the WiFi task, so just queue it
+ */
+void OnDataRecv(const uint8_t * mac, const uint8_t *incomingData, int len) {
+#if GATEWAY_FLEET
+  if (len > 0 && len <= FLEET_MAX_FRAME && incomingData[0] == FLEET_MAGIC) {
+    fleet_frame report;
+    report.len = len;
+    memcpy(report.data, incomingData, len);
+    xQueueSend(fleetQueue, &report, 0);
+    return;
+  }
+#endif
+  if (len != sizeof(ShowFrame)) return;
+
+  rx_frame frame;
+  frame.len = len;
+  frame.source = SOURCE_ESPNOW;
+  memcpy(frame.data, incomingData, len);
+  xQueueSend(rxQueue, &frame, 0);
+}
+#endif
+
+#if CHAOS_WITH_LORA
+/**
+ * Poll LoRa for plain (non-FEC) ShowFrames and queue them for bridging
+ */
+void receiveLoRa() {
+  int packetSize = LoRa.parsePacket();
+  if (packetSize == 0) return;
+
+  if (packetSize != sizeof(ShowFrame)) {
+    // FEC or foreign packet - drain it
+    while (LoRa.available()) LoRa.read();
+    return;
+  }
+
+  rx_frame frame;
+  frame.len = packetSize;
+  frame.source = SOURCE_LORA;
+  LoRa.readBytes(frame.data, packetSize);
+  xQueueSend(rxQueue, &frame, 0);
+}
+
+/**
+ * Everything that touches the LoRa radio: one queued send (blocks for
+ * its airtime, without any lock held), then a receive poll. Runs in the
+ * LoRa task, or from loop() on single-core boards.
+ */
+void serviceLoRa() {
+  rx_frame frame;
+  if (xQueueReceive(loraTxQueue, &frame, 0) == pdTRUE) {
+    lora.send(frame.data, frame.len);
+  }
+  receiveLoRa();
+}
+
+void loraTask(void* arg) {
+  for (;;) {
+    serviceLoRa();
+    vTaskDelay(1);   // Lets the idle task run between back-to-back sends
+  }
+}
+#endif
+
+/**
+ * Bridging: everything heard on one radio goes out on the others. Runs
+ * in the radio task or from loop(), with the scheduler lock held.
+ */
+void radioWork(void* ctx) {
+  rx_frame frame;
+  while (xQueueReceive(rxQueue, &frame, 0) == pdTRUE) {
+#if CHAOS_WITH_LORA
+    if (frame.source == SOURCE_LORA) {
+      bridgeFrame(frame.data, frame.len, &loraOut, SOURCE_LORA);
+      continue;
+    }
+#endif
+#if CHAOS_WITH_ESPNOW
+    bridgeFrame(frame.data, frame.len, &espnow, SOURCE_ESPNOW);
+#endif
+  }
+}
+
+#if CHAOS_WITH_WEB
+/**
+ * Web UI
+ */
+void redirectHome() {
+  server.sendHeader("Location", "/");
+  server.send(303);
+}
+
+void handleRoot() {
+  const ShowState& s = executor.state();
+  page = "<!DOCTYPE html><html><head>";
+  page += "<title>ESP Chas TV Gateway</title>";
+  page += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
+  page += "</head><body style='font-family: Arial, sans-serif; text-align: center;'>";
+  page += "<h1>🎬 ESP Chas TV Gateway</h1>";
+  page += "<p>📺 Show: <strong>";
+  page += s.showRunning ? "LIVE" : "Off Air";
+  page += "</strong></p><p>🎭 Scene: <strong>";
+  page += s.scene;
+  page += "</strong></p><p>📡";
+#if CHAOS_WITH_ESPNOW
+  page += " ESP-NOW sent: ";
+  page += espnow.sent();
+#endif
+#if CHAOS_WITH_LORA
+  page += " LoRa sent: ";
+  page += lora.sent();
+#endif
+  page += "</p><p>🔀 Bridged: ";
+  page += bridged;
+  page += "</p>";
+  page += "<a href='/start'><button>▶️ Start Show</button></a>";
+  page += "<a href='/stop'><button>⏹️ Stop Show</button></a><br>";
+  page += "<a href='/scene1'><button>Scene 1</button></a>";
+  page += "<a href='/scene2'><button>Scene 2</button></a>";
+  page += "<a href='/scene3'><button>Scene 3</button></a>";
+  page += "</body></html>";
+
+  server.send_P(200, "text/html", page.c_str(), page.length());
+}
+
+void handleStart() {
+  broadcastCommand(CMD_SHOW_START);
+  redirectHome();
+}
+
+void handleStop() {
+  broadcastCommand(CMD_SHOW_STOP);
+  redirectHome();
+}
+
+void handleScene1() {
+  broadcastCommand(CMD_SCENE, 1);
+  redirectHome();
+}
+
+void handleScene2() {
+  broadcastCommand(CMD_SCENE, 2);
+  redirectHome();
+}
+
+void handleScene3() {
+  broadcastCommand(CMD_SCENE, 3);
+  redirectHome();
+}
+
+/**
+ * /cmd?name=SCENE&v1=2 - any command by name
+ * Optional: &zone=1,3 (groups) and &lo=1&hi=40 (device range)
+ */
+void handleCommand() {
+  uint8_t id = showCommandFromName(server.arg("name").c_str());
+  if (id == CMD_NONE) {
+    server.send(400, "text/plain", "Unknown command");
+    return;
+  }
+
+  uint32_t groups = 0;
+  if (server.hasArg("zone")) {
+    groups = showGroupMask(server.arg("zone").c_str());
+    if (!groups) {
+      server.send(400, "text/plain", "Bad zone list");
+      return;
+    }
+  }
+
+  broadcastCommand(id, server.arg("v1").toInt(), server.arg("v2").toInt(), groups,
+                   (uint16_t)server.arg("lo").toInt(), (uint16_t)server.arg("hi").toInt());
+  server.send(200, "text/plain", showCommandName(id));
+}
+
+void handleNotFound() {
+  server.send(404, "text/plain", "404: Not Found");
+}
+#endif
+
+#if GATEWAY_FLEET
+/**
+ * Fleet distribution over ESP-NOW
+ */
+bool fleetSend(void* ctx, const uint8_t* data, size_t len) {
+  ShowScheduler::Guard guard(radio);   // Shares ESP-NOW with bridging
+  return espnow.send(data, len);
+}
+
+bool readConfigBlob(void* ctx, uint32_t offset, uint8_t* buf, size_t len) {
+  if (offset > sizeof(configBlob) || len > sizeof(configBlob) - offset) return false;
+  memcpy(buf, configBlob + offset, len);
+  return true;
+}
+
+bool readSpool(void* ctx, uint32_t offset, uint8_t* buf, size_t len) {
+  return spool.read(offset, buf, len);
+}
+
+bool spoolWrite(const uint8_t* data, size_t len) {
+  uint32_t end = spoolSize + len;
+  if (end > (uint32_t)spool.sectorCount() * FLASH_SECTOR_SIZE) return false;
+  while ((uint32_t)spoolErased * FLASH_SECTOR_SIZE < end) {
+    if (!spool.erase(spoolErased++)) return false;
+  }
+  if (!spool.write(spoolSize, data, len)) return false;
+  spoolCrc = fleetCrc32(spoolCrc, data, len);
+  spoolSize = end;
+  return true;
+}
+
+uint8_t boardFromName(const String& name) {
+  if (name == "esp32") return BOARD_ESP32;
+  if (name == "esp32s3") return BOARD_ESP32S3;
+  if (name == "esp32c3") return BOARD_ESP32C3;
+  return Board::kind;
+}
+
+// /fleet - what's being distributed
+void handleFleet() {
+  const FleetSenderStats& st = fleet.stats();
+  page = fleet.active() ? "sending" : "idle";
+  page += " | round ";
+  page += fleet.round();
+  page += " | pending ";
+  page += fleet.pending();
+  page += "/";
+  page += fleet.chunkCount();
+  page += " chunks | sent ";
+  page += (int32_t)st.chunks;
+  page += " (repairs ";
+  page += (int32_t)st.repairs;
+  page += ") | nacks ";
+  page += (int32_t)st.nacks;
+  page += " | boards done ";
+  page += (int32_t)st.done;
+  page += " failed ";
+  page += (int32_t)st.failed;
+  page += "\n";
+  server.send_P(200, "text/plain", page.c_str(), page.length());
+}
+
+// /fleet/config?v=2&all=receiver&node=<hex>:<role>[:<groups>[:<device>]]...
+void handleFleetConfig() {
+  FleetConfigEntry entries[(FLEET_CONFIG_MAX - sizeof(FleetConfigHeader)) / sizeof(FleetConfigEntry)];
+  uint8_t count = 0;
+  uint32_t version = (uint32_t)server.arg("v").toInt();
+  if (version == 0) {
+    server.send(400, "text/plain", "Need v=<config version>, 1 or more");
+    return;
+  }
+
+  for (int i = 0; i < server.args(); i++) {
+    String name = server.argName(i);
+    if (name != "node" && name != "all") continue;
+    if (count == sizeof(entries) / sizeof(entries[0])) {
+      server.send(400, "text/plain", "Too many nodes");
+      return;
+    }
+    FleetConfigEntry& e = entries[count];
+    memset(&e, 0, sizeof(e));
+    char spec[64];
+    strlcpy(spec, server.arg(i).c_str(), sizeof(spec));
+    char* field = spec;
+    if (name == "node") {
+      e.node = (uint32_t)strtoul(field, &field, 16);
+      if (*field++ != ':' || e.node == 0) {
+        server.send(400, "text/plain", "node=<hex id>:<role>[:<groups>[:<device>]]");
+        return;
+      }
+    }
+    char* groups = strchr(field, ':');
+    if (groups) *groups++ = '\0';
+    e.role = nodeRoleFromName(field);
+    char* device = groups ? strchr(groups, ':') : 0;
+    if (device) *device++ = '\0';
+    if (groups && *groups) e.groups = showGroupMask(groups);
+    if (device) e.device = (uint16_t)atoi(device);
+    if (e.role == ROLE_COUNT || (groups && *groups && !e.groups)) {
+      server.send(400, "text/plain", "Bad role or group list");
+      return;
+    }
+    count++;
+  }
+
+  if (!fleetKeySet) {
+    server.send(500, "text/plain", "No fleet key - set one with fleetkey on the serial console");
+    return;
+  }
+  size_t len = fleetConfigBuild(entries, count, configBlob, sizeof(configBlob));
+  FleetOffer offer = { FLEET_CONFIG, FLEET_ANY_BOARD, version, 0, 0, 0, 0, 0, {0} };
+  offer.payloadSize = offer.imageSize = len;
+  offer.payloadCrc = offer.imageCrc = fleetCrc32(0, configBlob, len);
+  fleetTag(fleetKey, FLEET_CONFIG, FLEET_ANY_BOARD, version, configBlob, len, offer.tag);
+  if (count == 0 || !fleet.offer(offer, readConfigBlob, 0, millis())) {
+    server.send(400, "text/plain", "Nothing to send");
+    return;
+  }
+  Serial.print("📦 Fleet config v");
+  Serial.print(version);
+  Serial.print(": ");
+  Serial.print(count);
+  Serial.println(" entries");
+  server.send(200, "text/plain", "Sending config");
+}
+
+// POST /fleet/firmware body: spool it, the offer happens when it's all in
+void handleFirmwareUpload() {
+  HTTPUpload& upload = server.upload();
+  if (upload.status == UPLOAD_FILE_START) {
+    fleet.cancel();   // The spool is about to be overwritten
+    spoolSize = spoolCrc = 0;
+    spoolErased = 0;
+    spoolOk = spool.begin(esp_ota_get_next_update_partition(0), FLEET_MAX_SECTORS);
+  } else if (upload.status == UPLOAD_FILE_WRITE && spoolOk) {
+    spoolOk = spoolWrite(upload.buf, upload.currentSize);
+  }
+}
+
+// ?version=8&base=7&size=<image bytes>&crc=<image crc32>&board=esp32&tag=<hex>
+// base=0 (or missing) for a whole image. The tag comes from fleet_delta.py.
+void handleFirmwareOffer() {
+  if (!spoolOk || spoolSize == 0) {
+    server.send(500, "text/plain", "Upload failed or too big for the OTA slot");
+    return;
+  }
+  FleetOffer offer;
+  offer.kind = FLEET_FIRMWARE;
+  offer.board = boardFromName(server.arg("board"));
+  offer.version = (uint32_t)server.arg("version").toInt();
+  offer.baseVersion = (uint32_t)server.arg("base").toInt();
+  offer.payloadSize = spoolSize;
+  offer.payloadCrc = spoolCrc;
+  offer.imageSize = offer.baseVersion ? (uint32_t)server.arg("size").toInt() : spoolSize;
+  offer.imageCrc = offer.baseVersion ? (uint32_t)strtoul(server.arg("crc").c_str(), 0, 0) : spoolCrc;
+  if (!fleetHexDecode(server.arg("tag").c_str(), offer.tag, sizeof(offer.tag))) {
+    server.send(400, "text/plain", "Need tag=<64 hex digits> from fleet_delta.py --key");
+    return;
+  }
+  if (offer.version == 0 || offer.imageSize == 0 || !fleet.offer(offer, readSpool, 0, millis())) {
+    server.send(400, "text/plain", "Need version (and size/crc for a delta)");
+    return;
+  }
+  Serial.print("📦 Fleet firmware v");
+  Serial.print(offer.version);
+  Serial.print(offer.baseVersion ? " (delta) " : " ");
+  Serial.print(spoolSize);
+  Serial.println(" bytes");
+  server.send(200, "text/plain", "Sending firmware");
+}
+
+void loadFleetKey() {
+  prefs.begin(FLEET_KEY_NVS, true);
+  fleetKeySet = prefs.getBytes("key", fleetKey, sizeof(fleetKey)) == sizeof(fleetKey);
+  prefs.end();
+}
+
+// fleetkey <64 hex digits> | fleetkey clear
+void cmdFleetKey(uint8_t argc, char* argv[], void* ctx) {
+  uint8_t key[FLEET_KEY_SIZE];
+  bool clear = argc >= 2 && strcasecmp(argv[1], "clear") == 0;
+  if (argc >= 2 && !clear && !fleetHexDecode(argv[1], key, sizeof(key))) {
+    Serial.println("Usage: fleetkey [<64 hex digits> | clear]");
+    return;
+  }
+  if (argc >= 2) {
+    prefs.begin(FLEET_KEY_NVS, false);
+    bool saved = clear ? prefs.remove("key") : prefs.putBytes("key", key, sizeof(key)) == sizeof(key);
+    prefs.end();
+    if (!saved) Serial.println("⚠️ Fleet key not saved");
+    loadFleetKey();
+  }
+  Serial.println(fleetKeySet ? "🔑 Fleet key set" : "🔑 No fleet key - config offers are refused");
+}
+
+void cmdUnknown(uint8_t argc, char* argv[], void* ctx) {
+  Serial.println("Unknown command. Try: fleetkey");
+}
+
+const ConsoleCommand serialCommands[] = {
+  { "fleetkey", cmdFleetKey },
+};
+
+void readConsole() {
+  int n = Serial.available();
+  while (n-- > 0) console.push((char)Serial.read());
+}
+
+void updateFleet() {
+  fleet_frame report;
+  while (xQueueReceive(fleetQueue, &report, 0) == pdTRUE) {
+    fleet.onMessage(report.data, report.len);
+  }
+  fleet.update(millis());
+}
+#endif
+
+void setup() {
+  Serial.begin(115200);
+  pinMode(LED_PIN, OUTPUT);
+
+  Serial.println("\n\n🌉 ESP Chas TV Gateway");
+  Serial.println("=====================================");
+
+  // AP for the web UI, STA for ESP-NOW. Fixtures must be on the AP channel.
+#if CHAOS_WITH_WEB
+  WiFi.mode(WIFI_AP_STA);
+  WiFi.softAP(ssid, password);
+  Serial.print("📡 AP: ");
+  Serial.print(ssid);
+  Serial.print(" @ ");
+  Serial.println(WiFi.softAPIP());
+#else
+  WiFi.mode(WIFI_STA);
+#endif
+  nodeId = (uint32_t)(ESP.getEfuseMac() >> 16);
+  executor.setNodeId(nodeId);
+
+  Serial.print("🆔 Node ID: ");
+  Serial.println(nodeId, HEX);
+  Serial.print("🧩 Board: ");
+  Serial.print(Board::name());
+  Serial.println(Board::dualCore ? " | bridging task" : " | cooperative");
+
+  bool logOk = logStore.begin(CMDLOG_PARTITION, CMDLOG_MAX_SECTORS);
+  recorder.begin(logOk ? &logStore : 0, micros());
+  Serial.print("📼 Command log: ");
+  Serial.print(recorder.stored());
+  Serial.println(logOk ? " records" : " (no cmdlog partition)");
+
+  rxQueue = xQueueCreateStatic(Board::rxQueueLen, sizeof(rx_frame), rxQueueStorage, &rxQueueBuffer);
+#if GATEWAY_FLEET
+  fleetQueue = xQueueCreateStatic(FLEET_QUEUE_LEN, sizeof(fleet_frame), fleetQueueStorage, &fleetQueueBuffer);
+  fleet.begin(nodeId, fleetSend);
+  loadFleetKey();
+  console.begin(serialCommands, sizeof(serialCommands) / sizeof(serialCommands[0]), 0, cmdUnknown);
+  Serial.println(fleetKeySet ? "🔑 Fleet key set" : "🔑 No fleet key - fleetkey <64 hex digits> to sign config");
+#endif
+#if CHAOS_WITH_ESPNOW
+
+  if (esp_now_init() == ESP_OK && espnow.begin()) {
+    esp_now_register_recv_cb(OnDataRecv);
+    hub.add(&espnow);
+    Serial.println("✅ ESP-NOW ready");
+  } else {
+    Serial.println("❌ ESP-NOW failed - continuing without it");
+  }
+#endif
+
+#if CHAOS_WITH_LORA
+  SPI.begin(LORA_SCK, LORA_MISO, LORA_MOSI, LORA_SS);
+  LoRa.setPins(LORA_SS, LORA_RST, LORA_DIO0);
+  if (LoRa.begin(LORA_FREQUENCY)) {
+    LoRa.setSpreadingFactor(12);
+    LoRa.setSignalBandwidth(125E3);
+    LoRa.setCodingRate4(8);
+    LoRa.setPreambleLength(8);
+    LoRa.setTxPower(20);
+    LoRa.enableCrc();
+    // Added after ESP-NOW, so every cue goes to ESP-NOW first
+    loraTxQueue = xQueueCreateStatic(Board::rxQueueLen, sizeof(rx_frame),
+                                     loraTxQueueStorage, &loraTxQueueBuffer);
+    hub.add(&loraOut);
+    if (Board::dualCore) {
+      xTaskCreateStaticPinnedToCore(loraTask, "lora", sizeof(loraTaskStack) / sizeof(loraTaskStack[0]),
+                                    0, LORA_TASK_PRIORITY, loraTaskStack, &loraTaskBuffer,
+                                    Board::radioCore);
+    }
+    Serial.println("✅ LoRa ready");
+  } else {
+    Serial.println("❌ LoRa failed - continuing without it");
+  }
+#endif
+
+  radio.begin(radioWork, 0);
+
+#if CHAOS_WITH_WEB
+  server.on("/", handleRoot);
+  server.on("/start", handleStart);
+  server.on("/stop", handleStop);
+  server.on("/scene1", handleScene1);
+  server.on("/scene2", handleScene2);
+  server.on("/scene3", handleScene3);
+  server.on("/cmd", handleCommand);
+#if GATEWAY_FLEET
+  server.on("/fleet", handleFleet);
+  server.on("/fleet/config", handleFleetConfig);
+  server.on("/fleet/firmware", HTTP_POST, handleFirmwareOffer, handleFirmwareUpload);
+#endif
+  server.onNotFound(handleNotFound);
+  server.begin();
+
+  Serial.println("🌐 Web server started!");
+#endif
+  Serial.println("=====================================\n");
+}
+
+void loop() {
+#if CHAOS_WITH_WEB
+  server.handleClient();
+#endif
+  radio.poll();   // Single core: bridging happens here
+#if CHAOS_WITH_LORA
+  // Single core: LoRa sends block loop() for their airtime
+  if (!Board::dualCore && loraTxQueue) serviceLoRa();
+#endif
+  recorder.flush();
+#if GATEWAY_FLEET
+  readConsole();
+  updateFleet();
+#endif
+
+  digitalWrite(LED_PIN, executor.ledLevel(millis()) ? HIGH : LOW);
+  delay(1);
+}
@@ -0,0 +1,128 @@
+/**
+ * ESP Chas TV - Compile-time board profiles
+ *
+ * One set of sketches, three very different chips:
+ * - ESP32 (esp32dev): dual-core Xtensa, 320 KB RAM
+ * - ESP32-S3: dual-core Xtensa, often with PSRAM
+ * - ESP32-C3: single-core RISC-V, 400 KB RAM shared with the radio
+ *
+ * `Board` is picked from the chip being built for and carries everything
+ * that differs between them as constants: scheduler model, queue and
+ * buffer sizes, whether big buffers go to PSRAM, and which transports are
+ * compiled in. Sketches size their static buffers from it, so nothing is
+ * decided (or allocated) at runtime.
+ *
+ * Transports are switched with build flags (see platformio.ini):
+ *   -DCHAOS_WITH_ESPNOW=0   -DCHAOS_WITH_LORA=0   -DCHAOS_WITH_WEB=0
+ * Code for a disabled transport isn't compiled at all - use the macros
+ * around includes and objects, and Board::hasLoRa etc. in plain code.
+ *
+ * Usage:
+ *   uint8_t rxQueueStorage[Board::rxQueueLen * sizeof(rx_frame)];
+ *   CHAOS_FRAME_BUFFER FixedString<CONTROL_PAGE_SIZE> page;   // PSRAM if any
+ */
+
+#ifndef CHAOS_BOARD_PROFILE_H
+#define CHAOS_BOARD_PROFILE_H
+
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM) || defined(ARDUINO_ARCH_ESP32)
+#define CHAOS_ON_ESP32 1
+#include <sdkconfig.h>
+#include <esp_attr.h>
+#endif
+
+#ifndef CHAOS_WITH_ESPNOW
+#define CHAOS_WITH_ESPNOW 1
+#endif
+#ifndef CHAOS_WITH_LORA
+#define CHAOS_WITH_LORA 1
+#endif
+#ifndef CHAOS_WITH_WEB
+#define CHAOS_WITH_WEB 1
+#endif
+
+// PSRAM only counts if the board has it and static buffers may live there
+#if defined(BOARD_HAS_PSRAM) && defined(CONFIG_SPIRAM_ALLOW_BSS_SEG_EXTERNAL_MEMORY)
+#define CHAOS_HAS_PSRAM 1
+#define CHAOS_FRAME_BUFFER EXT_RAM_ATTR
+#else
+#define CHAOS_HAS_PSRAM 0
+#define CHAOS_FRAME_BUFFER
+#endif
+
+enum BoardKind {
+  BOARD_ESP32,
+  BOARD_ESP32S3,
+  BOARD_ESP32C3,
+  BOARD_HOST          // Benchmarks and the native build
+};
+
+enum SchedulerKind {
+  SCHED_COOPERATIVE,  // Everything runs from loop()
+  SCHED_DUAL_CORE     // Radio work in its own task on the protocol core
+};
+
+template <BoardKind K> struct BoardTraits;
+
+template <> struct BoardTraits<BOARD_ESP32> {
+  static constexpr const char* name() { return "ESP32"; }
+  static constexpr SchedulerKind scheduler = SCHED_DUAL_CORE;
+  static constexpr uint8_t radioCore = 0;       // Same core as the WiFi stack
+  static constexpr uint16_t radioStack = 4096;  // Bytes
+  static constexpr uint8_t rxQueueLen = 16;
+};
+
+template <> struct BoardTraits<BOARD_ESP32S3> {
+  static constexpr const char* name() { return "ESP32-S3"; }
+  static constexpr SchedulerKind scheduler = SCHED_DUAL_CORE;
+  static constexpr uint8_t radioCore = 0;
+  static constexpr uint16_t radioStack = 4096;
+  // With PSRAM the page buffers move out of internal RAM, so the queue
+  // can afford to be deeper
+  static constexpr uint8_t rxQueueLen = CHAOS_HAS_PSRAM ? 32 : 16;
+};
+
+template <> struct BoardTraits<BOARD_ESP32C3> {
+  static constexpr const char* name() { return "ESP32-C3"; }
+  static constexpr SchedulerKind scheduler = SCHED_COOPERATIVE;
+  static constexpr uint8_t radioCore = 0;
+  static constexpr uint16_t radioStack = 0;     // No extra task, no extra stack
+  static constexpr uint8_t rxQueueLen = 8;
+};
+
+template <> struct BoardTraits<BOARD_HOST> {
+  static constexpr const char* name() { return "host"; }
+  static constexpr SchedulerKind scheduler = SCHED_COOPERATIVE;
+  static constexpr uint8_t radioCore = 0;
+  static constexpr uint16_t radioStack = 0;
+  static constexpr uint8_t rxQueueLen = 16;
+};
+
+// Everything a sketch needs to know about the chip it's built for
+template <BoardKind K> struct BoardProfile : BoardTraits<K> {
+  static constexpr BoardKind kind = K;
+  static constexpr bool dualCore = BoardTraits<K>::scheduler == SCHED_DUAL_CORE;
+  static constexpr bool psram = CHAOS_HAS_PSRAM;
+  static constexpr bool hasEspNow = CHAOS_WITH_ESPNOW;
+  static constexpr bool hasLoRa = CHAOS_WITH_LORA;
+  static constexpr bool hasWeb = CHAOS_WITH_WEB;
+
+  // Fixed RAM this profile adds: radio task stack + `rxFrame`-sized queue
+  static constexpr uint32_t staticRam(uint16_t rxFrame) {
+    return (uint32_t)BoardTraits<K>::radioStack + (uint32_t)BoardTraits<K>::rxQueueLen * rxFrame;
+  }
+};
+
+#if defined(CONFIG_IDF_TARGET_ESP32C3)
+typedef BoardProfile<BOARD_ESP32C3> Board;
+#elif defined(CONFIG_IDF_TARGET_ESP32S3)
+typedef BoardProfile<BOARD_ESP32S3> Board;
+#elif defined(CHAOS_ON_ESP32)
+typedef BoardProfile<BOARD_ESP32> Board;
+#else
+typedef BoardProfile<BOARD_HOST> Board;
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * ESP Chas TV - Boot phase timing
+ *
+ * Marks the end of each startup phase so the serial log shows where boot
+ * time goes:
+ *
+ *   bootTimer.mark("state", micros());
+ *   ...
+ *   FixedString<160> report;
+ *   bootTimer.format(report);   // "core 31.2 ms | state 0.4 ms | ..."
+ *
+ * Times are micros() since the app started; the ROM and second-stage
+ * bootloaders run before that and are not included.
+ */
+
+#ifndef CHAOS_BOOT_TIMER_H
+#define CHAOS_BOOT_TIMER_H
+
+#include <stdint.h>
+
+#include "FixedString.h"
+
+#define BOOT_TIMER_PHASES 10
+
+class BootTimer {
+public:
+  BootTimer() : _count(0) {}
+
+  // Phase `name` ended at `us`. The first mark covers everything before
+  // setup() (Arduino core init); `name` must be a string literal.
+  void mark(const char* name, uint32_t us) {
+    if (_count >= BOOT_TIMER_PHASES) return;
+    _names[_count] = name;
+    _ends[_count] = us;
+    _count++;
+  }
+
+  uint8_t count() const { return _count; }
+  const char* phase(uint8_t i) const { return _names[i]; }
+  uint32_t endUs(uint8_t i) const { return _ends[i]; }
+  uint32_t durationUs(uint8_t i) const { return i == 0 ? _ends[0] : _ends[i] - _ends[i - 1]; }
+  uint32_t totalUs() const { return _count ? _ends[_count - 1] : 0; }
+
+  // "name 12.3 ms | ... | total 45.6 ms"
+  void format(StrBuf& out) const {
+    out.clear();
+    for (uint8_t i = 0; i < _count; i++) {
+      out += _names[i];
+      out += " ";
+      appendMs(out, durationUs(i));
+      out += " | ";
+    }
+    out += "total ";
+    appendMs(out, totalUs());
+  }
+
+private:
+  static void appendMs(StrBuf& out, uint32_t us) {
+    out += (int32_t)(us / 1000);
+    out += ".";
+    out += (int32_t)(us / 100 % 10);
+    out += " ms";
+  }
+
+  const char* _names[BOOT_TIMER_PHASES];
+  uint32_t _ends[BOOT_TIMER_PHASES];
+  uint8_t _count;
+};
+
+#endif
@@ -0,0 +1,396 @@
+/**
+ * ESP Chas TV - Command recorder and replayer
+ */
+
+#include "CommandLog.h"
+
+#include <string.h>
+
+#define CMDLOG_SECTOR_SOURCE  0x7F         // Header slot, never a real source
+#define CMDLOG_SECTOR_MAGIC   0x314C4343   // "CCL1"
+
+static uint8_t recordCrc(const CommandRecord& rec) {
+  const uint8_t* p = (const uint8_t*)&rec + 1;
+  uint8_t crc = 0;
+  for (uint8_t n = 0; n < sizeof(rec) - 1; n++) {
+    crc ^= p[n];
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static bool isErased(const CommandRecord& rec) {
+  const uint8_t* p = (const uint8_t*)&rec;
+  for (uint8_t i = 0; i < sizeof(rec); i++) {
+    if (p[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+// Sector header: a record slot with a magic and the sector's sequence number
+static bool readSectorSeq(JournalStore* store, uint16_t sector, uint32_t* seq) {
+  CommandRecord h;
+  if (!store->read((uint32_t)sector * store->sectorSize(), &h, sizeof(h))) return false;
+  if (h.source != CMDLOG_SECTOR_SOURCE || h.dtUs != CMDLOG_SECTOR_MAGIC ||
+      (uint32_t)h.value2 != ~(uint32_t)h.value1 || h.check != recordCrc(h)) return false;
+  *seq = (uint32_t)h.value1;
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Recorder
+// ---------------------------------------------------------------------------
+
+CommandRecorder::CommandRecorder()
+  : _store(0), _slots(0), _active(-1), _seq(0), _next(0), _sectors(0),
+    _stream(0), _streamCtx(0), _lastUs(0), _head(0), _tail(0) {
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+bool CommandRecorder::begin(JournalStore* store, uint32_t nowUs) {
+  _store = 0;
+  _active = -1;
+  _seq = 0;
+  _sectors = 0;
+  _lastUs = nowUs;
+
+  bool ok = true;
+  if (store && store->sectorCount() >= 2) {
+    _store = store;
+    _slots = (uint16_t)(store->sectorSize() / CMDLOG_RECORD_SIZE);
+
+    // Append to the sector with the highest sequence number
+    for (uint16_t s = 0; s < store->sectorCount(); s++) {
+      uint32_t seq;
+      if (!readSectorSeq(store, s, &seq)) continue;
+      _sectors++;
+      if (_active < 0 || seq > _seq) {
+        _active = s;
+        _seq = seq;
+      }
+    }
+
+    if (_active >= 0) {
+      uint32_t base = (uint32_t)_active * store->sectorSize();
+      _next = _slots;
+      for (uint16_t slot = 1; slot < _slots; slot++) {
+        CommandRecord r;
+        if (!store->read(base + (uint32_t)slot * CMDLOG_RECORD_SIZE, &r, sizeof(r))) break;
+        if (isErased(r)) {
+          _next = slot;
+          break;
+        }
+      }
+    }
+  } else if (store) {
+    ok = false;
+  }
+
+  ShowCommand boot = { CMD_NONE, 0, 0 };
+  record(boot, SOURCE_BOOT, OUTCOME_EXECUTED, nowUs);
+  return ok;
+}
+
+void CommandRecorder::setStream(StreamFn fn, void* ctx) {
+  _stream = fn;
+  _streamCtx = ctx;
+}
+
+void CommandRecorder::record(const ShowCommand& cmd, uint8_t source, uint8_t outcome, uint32_t nowUs) {
+  uint8_t head = _head.load(std::memory_order_relaxed);
+  uint8_t next = (uint8_t)((head + 1) % CMDLOG_QUEUE);
+  if (next == _tail.load(std::memory_order_acquire)) {
+    // Leave _lastUs alone so the next record's dtUs still covers the gap
+    _stats.overflow++;
+    return;
+  }
+
+  CommandRecord& r = _queue[head];
+  r.check = 0;
+  r.id = cmd.id;
+  r.source = source;
+  r.outcome = outcome;
+  r.dtUs = nowUs - _lastUs;
+  r.value1 = cmd.value1;
+  r.value2 = cmd.value2;
+  _lastUs = nowUs;
+
+  _head.store(next, std::memory_order_release);
+  _stats.recorded++;
+}
+
+void CommandRecorder::flush() {
+  uint8_t tail = _tail.load(std::memory_order_relaxed);
+  while (tail != _head.load(std::memory_order_acquire)) {
+    CommandRecord rec = _queue[tail];
+    tail = (uint8_t)((tail + 1) % CMDLOG_QUEUE);
+    _tail.store(tail, std::memory_order_release);
+    emit(rec);
+  }
+}
+
+void CommandRecorder::emit(CommandRecord& rec) {
+  rec.check = recordCrc(rec);
+  if (_store) append(rec);
+  if (_stream) {
+    _stream(_streamCtx, rec);
+    _stats.streamed++;
+  }
+}
+
+bool CommandRecorder::startSector(uint16_t sector) {
+  uint32_t old;
+  bool reused = readSectorSeq(_store, sector, &old);
+
+  if (!_store->erase(sector)) return false;
+  _stats.erases++;
+  if (!reused) _sectors++;
+
+  CommandRecord h;
+  h.id = CMD_NONE;
+  h.source = CMDLOG_SECTOR_SOURCE;
+  h.outcome = 0;
+  h.dtUs = CMDLOG_SECTOR_MAGIC;
+  h.value1 = (int32_t)(_seq + 1);
+  h.value2 = (int32_t)~(_seq + 1);
+  h.check = recordCrc(h);
+  if (!_store->write((uint32_t)sector * _store->sectorSize(), &h, sizeof(h))) return false;
+
+  _active = sector;
+  _seq++;
+  _next = 1;
+  return true;
+}
+
+bool CommandRecorder::append(const CommandRecord& rec) {
+  if (!_store) return false;
+
+  if (_active < 0 || _next >= _slots) {
+    uint16_t sector = _active < 0 ? 0 : (uint16_t)((_active + 1) % _store->sectorCount());
+    if (!startSector(sector)) {
+      _stats.writeFailed++;
+      return false;
+    }
+  }
+
+  uint32_t addr = (uint32_t)_active * _store->sectorSize() + (uint32_t)_next * CMDLOG_RECORD_SIZE;
+  _next++;   // Even a failed write may have used the slot
+  if (!_store->write(addr, &rec, sizeof(rec))) {
+    _stats.writeFailed++;
+    return false;
+  }
+  _stats.written++;
+  return true;
+}
+
+bool CommandRecorder::clear() {
+  if (!_store) return false;
+  bool ok = true;
+  for (uint16_t s = 0; s < _store->sectorCount(); s++) {
+    uint32_t seq;
+    if (readSectorSeq(_store, s, &seq)) {
+      ok = _store->erase(s) && ok;
+      _stats.erases++;
+    }
+  }
+  _active = -1;
+  _seq = 0;
+  _sectors = 0;
+  return ok;
+}
+
+uint32_t CommandRecorder::stored() const {
+  if (!_store || _active < 0) return 0;
+  return (uint32_t)(_sectors - 1) * (_slots - 1) + (_next - 1);
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+// ---------------------------------------------------------------------------
+
+CommandLogReader::CommandLogReader()
+  : _store(0), _slots(0), _first(-1), _sector(-1), _seq(0), _slot(0), _visited(0), _torn(0) {}
+
+bool CommandLogReader::begin(JournalStore* store) {
+  _store = store;
+  _first = -1;
+  if (!store || store->sectorCount() < 2) {
+    _sector = -1;
+    return false;
+  }
+  _slots = (uint16_t)(store->sectorSize() / CMDLOG_RECORD_SIZE);
+
+  // Sectors are written round robin, so the oldest one starts the chain
+  uint32_t oldest = 0;
+  for (uint16_t s = 0; s < store->sectorCount(); s++) {
+    uint32_t seq;
+    if (readSectorSeq(store, s, &seq) && (_first < 0 || seq < oldest)) {
+      _first = s;
+      oldest = seq;
+    }
+  }
+
+  rewind();
+  return true;
+}
+
+void CommandLogReader::rewind() {
+  _sector = _first;
+  _slot = 1;
+  _visited = 1;
+  _torn = 0;
+  if (_sector >= 0) readSectorSeq(_store, (uint16_t)_sector, &_seq);
+}
+
+bool CommandLogReader::next(CommandRecord& rec) {
+  while (_sector >= 0) {
+    if (_slot >= _slots) {
+      // The chain continues only into the sector written right after
+      uint16_t next = (uint16_t)((_sector + 1) % _store->sectorCount());
+      uint32_t seq;
+      if (_visited >= _store->sectorCount() || !readSectorSeq(_store, next, &seq) || seq != _seq + 1) {
+        _sector = -1;
+        return false;
+      }
+      _sector = next;
+      _seq = seq;
+      _slot = 1;
+      _visited++;
+    }
+
+    uint32_t addr = (uint32_t)_sector * _store->sectorSize() + (uint32_t)_slot * CMDLOG_RECORD_SIZE;
+    _slot++;
+    if (!_store->read(addr, &rec, sizeof(rec))) {
+      _sector = -1;
+      return false;
+    }
+    if (isErased(rec)) {
+      _slot = _slots;   // Nothing after this in the sector
+      continue;
+    }
+    if (rec.check != recordCrc(rec)) {
+      _torn++;
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+// ---------------------------------------------------------------------------
+// Replayer
+// ---------------------------------------------------------------------------
+
+CommandReplayer::CommandReplayer()
+  : _reader(0), _fn(0), _ctx(0), _pace(REPLAY_FAST), _running(false), _pending(false),
+    _lastUs(0), _behindUs(0) {
+  memset(&_rec, 0, sizeof(_rec));
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void CommandReplayer::start(CommandLogReader* reader, ReplayFn fn, void* ctx, uint8_t pace, uint32_t nowUs) {
+  _reader = reader;
+  _fn = fn;
+  _ctx = ctx;
+  _pace = pace;
+  _running = reader && fn;
+  _pending = false;
+  _lastUs = nowUs;
+  _behindUs = 0;
+  memset(&_stats, 0, sizeof(_stats));
+  if (reader) reader->rewind();
+}
+
+bool CommandReplayer::update(uint32_t nowUs) {
+  if (!_running) return false;
+
+  if (_pace == REPLAY_REALTIME) _behindUs += nowUs - _lastUs;
+  _lastUs = nowUs;
+
+  for (uint8_t n = 0; n < REPLAY_BATCH; n++) {
+    if (!_pending) {
+      if (!_reader->next(_rec)) {
+        _running = false;
+        return false;
+      }
+      _pending = true;
+    }
+
+    if (_pace == REPLAY_REALTIME) {
+      if (_rec.dtUs > _behindUs) return true;
+      _behindUs -= _rec.dtUs;
+      if (_behindUs > _stats.maxLateUs) _stats.maxLateUs = _behindUs;
+    }
+    _pending = false;
+
+    if (_rec.id == CMD_NONE) {
+      if (_rec.source == SOURCE_BOOT) _stats.sessions++;
+      continue;
+    }
+
+    uint8_t outcome = _fn(_ctx, _rec);
+    _stats.replayed++;
+    if (outcome != _rec.outcome) _stats.mismatched++;
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+ShowCommand commandRecordCommand(const CommandRecord& rec) {
+  ShowCommand cmd = { rec.id, rec.value1, rec.value2 };
+  return cmd;
+}
+
+static const char hexDigits[] = "0123456789abcdef";
+
+void commandRecordToLine(const CommandRecord& rec, char* out) {
+  const uint8_t* p = (const uint8_t*)&rec;
+  memcpy(out, CMDLOG_LINE_PREFIX, sizeof(CMDLOG_LINE_PREFIX) - 1);
+  out += sizeof(CMDLOG_LINE_PREFIX) - 1;
+  for (uint8_t i = 0; i < sizeof(rec); i++) {
+    *out++ = hexDigits[p[i] >> 4];
+    *out++ = hexDigits[p[i] & 0x0F];
+  }
+  *out = '\0';
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool commandRecordFromLine(const char* line, CommandRecord& rec) {
+  const char* p = strstr(line, CMDLOG_LINE_PREFIX);
+  if (!p) return false;
+  p += sizeof(CMDLOG_LINE_PREFIX) - 1;
+
+  uint8_t* out = (uint8_t*)&rec;
+  for (uint8_t i = 0; i < sizeof(rec); i++) {
+    int hi = hexValue(p[2 * i]);
+    int lo = hi < 0 ? -1 : hexValue(p[2 * i + 1]);
+    if (lo < 0) return false;
+    out[i] = (uint8_t)((hi << 4) | lo);
+  }
+  return rec.check == recordCrc(rec);
+}
+
+const char* commandSourceName(uint8_t source) {
+  static const char* const names[SOURCE_COUNT] = {
+    "none", "serial", "web", "espnow", "lora", "mesh", "boot"
+  };
+  return source < SOURCE_COUNT ? names[source] : "?";
+}
+
+const char* commandOutcomeName(uint8_t outcome) {
+  static const char* const names[OUTCOME_COUNT] = {
+    "executed", "rejected", "sent", "send_failed", "forwarded"
+  };
+  return outcome < OUTCOME_COUNT ? names[outcome] : "?";
+}
@@ -0,0 +1,246 @@
+/**
+ * ESP Chas TV - Command recorder and replayer
+ *
+ * Every command a node takes in - typed on the console, clicked in the
+ * web UI, heard on ESP-NOW or LoRa - is recorded with a microsecond
+ * timestamp, where it came from and what happened to it (executed,
+ * rejected, sent, ...). When something goes wrong mid-show the log says
+ * exactly what arrived and when, and the same log can be replayed to
+ * rehearse the show or to load-test the executor with real traffic.
+ *
+ * Records are 16 bytes:
+ *
+ *   record:  crc8, id, source, outcome, dtUs, value1, value2
+ *
+ * dtUs is the time since the previous record, so a log can be replayed
+ * at the original pace without caring when it was recorded. A boot
+ * marker (CMD_NONE, SOURCE_BOOT) starts each power-on.
+ *
+ * Two sinks, either or both:
+ * - Flash: a ring of sectors on the "cmdlog" partition (see
+ *   partitions.csv). Each sector starts with a header holding a sequence
+ *   number; when the ring is full the oldest sector is erased. A torn
+ *   record fails its CRC and is skipped.
+ * - Stream: each record as an "@CL <32 hex digits>" line, printed
+ *   between the normal serial output. Capture the monitor to a file and
+ *   bench/replay_bench.cpp picks the lines out.
+ *
+ * record() only copies into a RAM queue, so it is cheap enough for a
+ * radio callback; flush() from loop() does the flash writes. record()
+ * must not run in two tasks at once (use the scheduler Guard); flush()
+ * may run on the other core at the same time without one.
+ *
+ * Not recorded: zone/range addressing of sent frames (replayed sends go
+ * to every node), and gaps between records longer than ~71 minutes, when
+ * micros() wraps.
+ *
+ * Usage:
+ *   logStore.begin(CMDLOG_PARTITION, CMDLOG_MAX_SECTORS);
+ *   recorder.begin(&logStore, micros());
+ *   recorder.record(cmd, SOURCE_ESPNOW, OUTCOME_EXECUTED, micros());
+ *   recorder.flush();                                  // in loop()
+ *
+ *   reader.begin(&logStore);
+ *   replayer.start(&reader, replayOne, 0, REPLAY_REALTIME, micros());
+ *   replayer.update(micros());                         // in loop()
+ */
+
+#ifndef CHAOS_COMMAND_LOG_H
+#define CHAOS_COMMAND_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#include "ShowCommand.h"
+#include "StateJournal.h"
+
+#define CMDLOG_PARTITION     "cmdlog"
+#define CMDLOG_MAX_SECTORS   128    // 512 KB, ~32,000 records
+#define CMDLOG_RECORD_SIZE   16
+#define CMDLOG_QUEUE         32     // Records waiting for flush()
+#define CMDLOG_LINE_PREFIX   "@CL "
+#define CMDLOG_LINE_SIZE     37     // Prefix + 32 hex digits + '\0'
+
+#define REPLAY_BATCH         64     // Most records one update() delivers
+
+enum CommandSource {
+  SOURCE_NONE,
+  SOURCE_SERIAL,    // Console on this node
+  SOURCE_WEB,       // Web UI / HTTP API
+  SOURCE_ESPNOW,
+  SOURCE_LORA,
+  SOURCE_MESH,
+  SOURCE_BOOT,      // Marker: the node powered up
+  SOURCE_COUNT
+};
+
+enum CommandOutcome {
+  OUTCOME_EXECUTED,     // Executor applied it
+  OUTCOME_REJECTED,     // Executor refused it (unknown id)
+  OUTCOME_SENT,         // Handed to the radio
+  OUTCOME_SEND_FAILED,  // Radio refused it
+  OUTCOME_FORWARDED,    // Bridged on, not addressed to this node
+  OUTCOME_COUNT
+};
+
+enum ReplayPace {
+  REPLAY_FAST,          // As fast as update() is called
+  REPLAY_REALTIME       // Original timing (1x)
+};
+
+// Wire and flash format - little-endian, no padding
+struct CommandRecord {
+  uint8_t check;      // CRC-8 over the other 15 bytes
+  uint8_t id;         // CommandId, CMD_NONE for markers
+  uint8_t source;     // CommandSource
+  uint8_t outcome;    // CommandOutcome
+  uint32_t dtUs;      // Microseconds since the previous record
+  int32_t value1;
+  int32_t value2;
+};
+
+static_assert(sizeof(CommandRecord) == CMDLOG_RECORD_SIZE, "CommandRecord must stay 16 bytes");
+
+struct CommandLogStats {
+  uint32_t recorded;     // record() calls queued
+  uint32_t overflow;     // Dropped: queue full, flush() not called often enough
+  uint32_t written;      // Records written to flash
+  uint32_t writeFailed;
+  uint32_t erases;       // Sectors erased; each drops a sector of the oldest records
+  uint32_t streamed;     // Records handed to the stream
+};
+
+class CommandRecorder {
+public:
+  typedef void (*StreamFn)(void* ctx, const CommandRecord& rec);
+
+  CommandRecorder();
+
+  // Continue the flash log on `store` (NULL = stream only) and mark the
+  // boot. Needs at least 2 sectors; returns false if the store can't
+  // be used.
+  bool begin(JournalStore* store, uint32_t nowUs);
+
+  // Also pass every record to `fn` from flush(); NULL turns it off
+  void setStream(StreamFn fn, void* ctx = 0);
+  bool streaming() const { return _stream != 0; }
+
+  // Queue one command. No flash access.
+  void record(const ShowCommand& cmd, uint8_t source, uint8_t outcome, uint32_t nowUs);
+
+  // Write queued records to flash and the stream. Call from loop().
+  void flush();
+
+  // Write a record as-is, keeping its dtUs (importing a capture)
+  bool append(const CommandRecord& rec);
+
+  // Erase the flash log and start a new one
+  bool clear();
+
+  // Records in flash, markers included
+  uint32_t stored() const;
+
+  bool hasStore() const { return _store != 0; }
+  const CommandLogStats& stats() const { return _stats; }
+
+private:
+  bool startSector(uint16_t sector);
+  void emit(CommandRecord& rec);
+
+  JournalStore* _store;
+  uint16_t _slots;          // Record slots per sector, header included
+  int32_t _active;          // Sector being appended to, -1 = none
+  uint32_t _seq;            // Sequence number of the active sector
+  uint16_t _next;           // Next free slot in the active sector
+  uint16_t _sectors;        // Sectors with a valid header
+
+  StreamFn _stream;
+  void* _streamCtx;
+
+  uint32_t _lastUs;
+  CommandRecord _queue[CMDLOG_QUEUE];
+  // One writer each. Release/acquire so flush() on the other core never
+  // sees a slot before record() has filled it, nor record() reuse a slot
+  // flush() is still copying.
+  std::atomic<uint8_t> _head;   // Written by record()
+  std::atomic<uint8_t> _tail;   // Written by flush()
+
+  CommandLogStats _stats;
+};
+
+// Walks a flash log from the oldest record to the newest
+class CommandLogReader {
+public:
+  CommandLogReader();
+
+  bool begin(JournalStore* store);
+  void rewind();
+
+  // Next valid record, markers included. False at the end of the log.
+  bool next(CommandRecord& rec);
+
+  uint32_t torn() const { return _torn; }
+
+private:
+  JournalStore* _store;
+  uint16_t _slots;
+  int32_t _first;           // Oldest sector, -1 = empty log
+  int32_t _sector;
+  uint32_t _seq;
+  uint16_t _slot;
+  uint16_t _visited;
+  uint32_t _torn;
+};
+
+struct ReplayStats {
+  uint32_t replayed;     // Commands delivered
+  uint32_t mismatched;   // Outcome differed from the recording
+  uint32_t sessions;     // Boot markers passed
+  uint32_t maxLateUs;    // REPLAY_REALTIME: worst delivery delay
+};
+
+class CommandReplayer {
+public:
+  // Re-run one recorded command; return the outcome it has now
+  typedef uint8_t (*ReplayFn)(void* ctx, const CommandRecord& rec);
+
+  CommandReplayer();
+
+  // Replay `reader` from its oldest record
+  void start(CommandLogReader* reader, ReplayFn fn, void* ctx, uint8_t pace, uint32_t nowUs);
+  void stop() { _running = false; }
+  bool running() const { return _running; }
+
+  // Deliver the records that are due. Returns false once the log is done.
+  bool update(uint32_t nowUs);
+
+  const ReplayStats& stats() const { return _stats; }
+
+private:
+  CommandLogReader* _reader;
+  ReplayFn _fn;
+  void* _ctx;
+  uint8_t _pace;
+  bool _running;
+  bool _pending;
+  CommandRecord _rec;
+  uint32_t _lastUs;
+  uint32_t _behindUs;    // Time passed that no record has used up yet
+  ReplayStats _stats;
+};
+
+// The command a record holds
+ShowCommand commandRecordCommand(const CommandRecord& rec);
+
+// "@CL 0a05..." for a serial capture. `out` needs CMDLOG_LINE_SIZE bytes.
+void commandRecordToLine(const CommandRecord& rec, char* out);
+
+// Parse a capture line (leading text before the prefix is ignored).
+// Returns false for other lines and for records failing their CRC.
+bool commandRecordFromLine(const char* line, CommandRecord& rec);
+
+const char* commandSourceName(uint8_t source);
+const char* commandOutcomeName(uint8_t outcome);
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * ESP Chas TV - Web control page
+ */
+
+#include "ControlPage.h"
+
+static const char pageHead[] =
+  "<!DOCTYPE html><html><head>"
+  "<title>ESP Chas TV Control</title>"
+  "<meta name='viewport' content='width=device-width, initial-scale=1'>"
+  "<style>"
+  "body { font-family: Arial, sans-serif; text-align: center; padding: 20px; background: linear-gradient(135deg, #667eea 0%, #764ba2 100%); color: white; }"
+  "h1 { font-size: 2.5em; margin-bottom: 10px; }"
+  ".card { background: rgba(255,255,255,0.1); backdrop-filter: blur(10px); padding: 20px; border-radius: 15px; margin: 20px auto; max-width: 500px; box-shadow: 0 8px 32px rgba(0,0,0,0.3); }"
+  ".status { font-size: 1.2em; margin: 15px 0; }"
+  ".button { background: #4CAF50; color: white; border: none; padding: 15px 32px; text-decoration: none; display: inline-block; font-size: 16px; margin: 10px 5px; cursor: pointer; border-radius: 8px; transition: all 0.3s; }"
+  ".button:hover { background: #45a049; transform: scale(1.05); }"
+  ".stop { background: #f44336; }"
+  ".stop:hover { background: #da190b; }"
+  ".info { background: #2196F3; }"
+  ".info:hover { background: #0b7dda; }"
+  "</style></head><body>"
+  "<h1>🎬 ESP Chas TV</h1>"
+  "<h3>Chaoslab TV Show Collaboration</h3>"
+  "<div class='card'>";
+
+static const char pageControls[] =
+  "</div>"
+  "<div class='card'>"
+  "<h2>Controls</h2>"
+  "<a href='/start'><button class='button'>▶️ Start Show</button></a>"
+  "<a href='/stop'><button class='button stop'>⏹️ Stop Show</button></a><br>"
+  "<a href='/scene1'><button class='button info'>Scene 1</button></a>"
+  "<a href='/scene2'><button class='button info'>Scene 2</button></a>"
+  "<a href='/scene3'><button class='button info'>Scene 3</button></a>"
+  "</div>"
+  "<div class='card'>"
+  "<p>🔌 Device: ESP32</p>";
+
+void renderControlPage(StrBuf& out, const ControlPageInfo& info) {
+  out.clear();
+  out += pageHead;
+
+  out += "<div class='status'>📺 Show Status: <strong>";
+  out += info.showRunning ? "LIVE" : "Off Air";
+  out += "</strong></div>";
+  out += "<div class='status'>👥 Viewers: <strong>";
+  out += info.viewers;
+  out += "</strong></div>";
+  out += "<div class='status'>🎭 Current Scene: <strong>";
+  out += info.scene;
+  out += "</strong></div>";
+
+  out += pageControls;
+
+  out += "<p>📡 IP: ";
+  out += info.ip;
+  out += "</p>";
+  out += "<p>🧠 Heap: ";
+  out += (int32_t)(info.freeHeap / 1024);
+  out += " KB free, largest block ";
+  out += (int32_t)(info.largestBlock / 1024);
+  out += " KB</p>";
+  out += "</div>";
+  out += "</body></html>";
+}
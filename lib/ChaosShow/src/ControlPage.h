@@ -0,0 +1,30 @@
+/**
+ * ESP Chas TV - Web control page
+ *
+ * Renders the page served by src/main.cpp into a caller-owned buffer, so
+ * every request reuses the same memory instead of growing a String a
+ * few dozen times. The fixed markup is stored once as string constants;
+ * only the status values are formatted per request.
+ */
+
+#ifndef CHAOS_CONTROL_PAGE_H
+#define CHAOS_CONTROL_PAGE_H
+
+#include "FixedString.h"
+
+// Enough for the page with room to spare - check truncated() if you
+// add markup
+#define CONTROL_PAGE_SIZE 2560
+
+struct ControlPageInfo {
+  bool showRunning;
+  int32_t viewers;
+  const char* scene;
+  const char* ip;
+  uint32_t freeHeap;       // ESP.getFreeHeap()
+  uint32_t largestBlock;   // ESP.getMaxAllocHeap()
+};
+
+void renderControlPage(StrBuf& out, const ControlPageInfo& info);
+
+#endif
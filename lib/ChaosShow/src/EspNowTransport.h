@@ -0,0 +1,53 @@
+/**
+ * ESP Chas TV - ESP-NOW broadcast transport
+ *
+ * Header-only so projects without ESP-NOW never compile it. The sketch
+ * still owns esp_now_init() and the receive callback.
+ */
+
+#ifndef CHAOS_ESPNOW_TRANSPORT_H
+#define CHAOS_ESPNOW_TRANSPORT_H
+
+#include <esp_now.h>
+#include <string.h>
+
+#include "ShowTransport.h"
+
+class EspNowTransport : public ShowTransport {
+public:
+  EspNowTransport() : _sent(0), _failed(0) {
+    memset(_dest, 0xFF, sizeof(_dest));
+  }
+
+  // Register the broadcast peer. Call after esp_now_init().
+  bool begin() {
+    if (esp_now_is_peer_exist(_dest)) return true;
+    esp_now_peer_info_t peerInfo;
+    memset(&peerInfo, 0, sizeof(peerInfo));
+    memcpy(peerInfo.peer_addr, _dest, 6);
+    peerInfo.channel = 0;
+    peerInfo.encrypt = false;
+    return esp_now_add_peer(&peerInfo) == ESP_OK;
+  }
+
+  const char* name() const { return "ESP-NOW"; }
+
+  bool send(const uint8_t* data, size_t len) {
+    if (esp_now_send(_dest, data, len) == ESP_OK) {
+      _sent++;
+      return true;
+    }
+    _failed++;
+    return false;
+  }
+
+  uint32_t sent() const { return _sent; }
+  uint32_t failed() const { return _failed; }
+
+private:
+  uint8_t _dest[6];
+  uint32_t _sent;
+  uint32_t _failed;
+};
+
+#endif
@@ -0,0 +1,266 @@
+/**
+ * ESP Chas TV - Forward Error Correction for one-to-many broadcasts
+ *
+ * See FecCodec.h for the packet layout.
+ */
+
+#include "FecCodec.h"
+
+#include <string.h>
+
+// GF(256) with the usual 0x11D polynomial
+static uint8_t gfExp[512];
+static uint8_t gfLog[256];
+static bool gfReady = false;
+
+static void gfInit() {
+  if (gfReady) return;
+  uint16_t x = 1;
+  for (int i = 0; i < 255; i++) {
+    gfExp[i] = (uint8_t)x;
+    gfLog[x] = (uint8_t)i;
+    x <<= 1;
+    if (x & 0x100) x ^= 0x11D;
+  }
+  for (int i = 255; i < 512; i++) {
+    gfExp[i] = gfExp[i - 255];
+  }
+  gfLog[0] = 0;
+  gfReady = true;
+}
+
+static inline uint8_t gfMul(uint8_t a, uint8_t b) {
+  if (a == 0 || b == 0) return 0;
+  return gfExp[gfLog[a] + gfLog[b]];
+}
+
+static inline uint8_t gfInv(uint8_t a) {
+  return gfExp[255 - gfLog[a]];
+}
+
+/**
+ * Cauchy coefficient for repair row j and data column i.
+ * Rows use 0x80..0x87 and columns 0x00..0x0F, so the two sets never
+ * overlap and every square sub-matrix is invertible.
+ */
+static inline uint8_t fecCoef(uint8_t j, uint8_t i) {
+  return gfInv((uint8_t)((0x80 | j) ^ i));
+}
+
+// dst ^= c * src
+static void gfAddMul(uint8_t* dst, const uint8_t* src, uint8_t c, uint8_t len) {
+  if (c == 0) return;
+  uint8_t logC = gfLog[c];
+  for (uint8_t n = 0; n < len; n++) {
+    if (src[n]) dst[n] ^= gfExp[gfLog[src[n]] + logC];
+  }
+}
+
+static uint8_t popCount(uint32_t v) {
+  uint8_t n = 0;
+  while (v) {
+    v &= v - 1;
+    n++;
+  }
+  return n;
+}
+
+// ---------------------------------------------------------------------------
+// Encoder
+// ---------------------------------------------------------------------------
+
+FecEncoder::FecEncoder()
+  : _k(4), _m(2), _payloadLen(0), _blockId(0), _count(0) {
+  gfInit();
+  memset(_repair, 0, sizeof(_repair));
+}
+
+bool FecEncoder::configure(uint8_t k, uint8_t m, uint8_t payloadLen) {
+  if (k == 0 || k > FEC_MAX_K || m > FEC_MAX_M) return false;
+  if (payloadLen == 0 || payloadLen > FEC_MAX_PAYLOAD) return false;
+
+  _k = k;
+  _m = m;
+  _payloadLen = payloadLen;
+  _count = 0;
+  memset(_repair, 0, sizeof(_repair));
+  return true;
+}
+
+size_t FecEncoder::addData(const uint8_t* payload, uint8_t* packet) {
+  if (_count >= _k) return 0;
+  uint8_t index = _count++;
+
+  packet[0] = FEC_MAGIC;
+  packet[1] = _blockId;
+  packet[2] = index;
+  packet[3] = 0;
+  packet[4] = _m;
+  memcpy(packet + FEC_HEADER_SIZE, payload, _payloadLen);
+
+  for (uint8_t j = 0; j < _m; j++) {
+    gfAddMul(_repair[j], payload, fecCoef(j, index), _payloadLen);
+  }
+
+  return FEC_HEADER_SIZE + _payloadLen;
+}
+
+size_t FecEncoder::makeRepair(uint8_t j, uint8_t* packet) const {
+  packet[0] = FEC_MAGIC;
+  packet[1] = _blockId;
+  packet[2] = _count + j;
+  packet[3] = _count;
+  packet[4] = _m;
+  memcpy(packet + FEC_HEADER_SIZE, _repair[j], _payloadLen);
+  return FEC_HEADER_SIZE + _payloadLen;
+}
+
+void FecEncoder::closeBlock() {
+  _blockId++;
+  _count = 0;
+  memset(_repair, 0, sizeof(_repair));
+}
+
+// ---------------------------------------------------------------------------
+// Decoder
+// ---------------------------------------------------------------------------
+
+FecDecoder::FecDecoder() : _deliver(0), _recovered(0), _lost(0) {
+  gfInit();
+  memset(_blocks, 0, sizeof(_blocks));
+}
+
+bool FecDecoder::receive(const uint8_t* packet, size_t len) {
+  if (len <= FEC_HEADER_SIZE || packet[0] != FEC_MAGIC) return false;
+
+  uint8_t id = packet[1];
+  uint8_t index = packet[2];
+  uint8_t k = packet[3];
+  uint8_t m = packet[4];
+  uint8_t payloadLen = (uint8_t)(len - FEC_HEADER_SIZE);
+  const uint8_t* payload = packet + FEC_HEADER_SIZE;
+
+  if (payloadLen > FEC_MAX_PAYLOAD || m > FEC_MAX_M || k > FEC_MAX_K) return false;
+
+  Block* b = slotFor(id, payloadLen);
+  b->m = m;
+
+  if (k == 0) {
+    // Data packet: deliver right away, keep a copy for decoding
+    if (index >= FEC_MAX_K) return false;
+    uint32_t bit = 1UL << index;
+    if (!(b->dataMask & bit)) {
+      memcpy(b->data[index], payload, payloadLen);
+      b->dataMask |= bit;
+    }
+    if (!(b->deliveredMask & bit)) {
+      b->deliveredMask |= bit;
+      if (_deliver) _deliver(payload, payloadLen, false);
+    }
+  } else {
+    // Repair packet: also tells us the real block size
+    if (index < k || index - k >= FEC_MAX_M) return false;
+    b->k = k;
+    uint8_t j = index - k;
+    memcpy(b->repair[j], payload, payloadLen);
+    b->repairMask |= 1UL << j;
+  }
+
+  if (b->k) tryRecover(*b);
+  return true;
+}
+
+FecDecoder::Block* FecDecoder::slotFor(uint8_t id, uint8_t payloadLen) {
+  Block& b = _blocks[id & 1];
+  if (b.active && b.id == id && b.payloadLen == payloadLen) return &b;
+
+  retire(b);
+  memset(&b, 0, sizeof(b));
+  b.active = true;
+  b.id = id;
+  b.payloadLen = payloadLen;
+  return &b;
+}
+
+void FecDecoder::retire(Block& b) {
+  if (!b.active || b.k == 0) return;
+  uint32_t want = (b.k >= 32) ? 0xFFFFFFFFUL : ((1UL << b.k) - 1);
+  _lost += popCount(want & ~b.deliveredMask);
+}
+
+void FecDecoder::tryRecover(Block& b) {
+  uint32_t want = (1UL << b.k) - 1;
+  uint32_t missing = want & ~b.dataMask;
+  if (!missing) return;
+
+  uint8_t e = popCount(missing);
+  if (popCount(b.repairMask) < e) return;
+
+  uint8_t missIdx[FEC_MAX_M];
+  uint8_t repIdx[FEC_MAX_M];
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < b.k; i++) {
+    if (missing & (1UL << i)) missIdx[n++] = i;
+  }
+  n = 0;
+  for (uint8_t j = 0; j < FEC_MAX_M && n < e; j++) {
+    if (b.repairMask & (1UL << j)) repIdx[n++] = j;
+  }
+
+  // Strip the known data out of each repair symbol, leaving an
+  // e x e Cauchy system in the missing packets only.
+  uint8_t mat[FEC_MAX_M][FEC_MAX_M];
+  uint8_t rhs[FEC_MAX_M][FEC_MAX_PAYLOAD];
+  for (uint8_t r = 0; r < e; r++) {
+    memcpy(rhs[r], b.repair[repIdx[r]], b.payloadLen);
+    for (uint8_t i = 0; i < b.k; i++) {
+      if (b.dataMask & (1UL << i)) {
+        gfAddMul(rhs[r], b.data[i], fecCoef(repIdx[r], i), b.payloadLen);
+      }
+    }
+    for (uint8_t c = 0; c < e; c++) {
+      mat[r][c] = fecCoef(repIdx[r], missIdx[c]);
+    }
+  }
+
+  // Gauss-Jordan elimination (Cauchy sub-matrices are never singular)
+  for (uint8_t col = 0; col < e; col++) {
+    uint8_t pivot = col;
+    while (pivot < e && mat[pivot][col] == 0) pivot++;
+    if (pivot == e) return;
+    if (pivot != col) {
+      uint8_t tmp[FEC_MAX_PAYLOAD];
+      for (uint8_t c = 0; c < e; c++) {
+        uint8_t t = mat[col][c];
+        mat[col][c] = mat[pivot][c];
+        mat[pivot][c] = t;
+      }
+      memcpy(tmp, rhs[col], b.payloadLen);
+      memcpy(rhs[col], rhs[pivot], b.payloadLen);
+      memcpy(rhs[pivot], tmp, b.payloadLen);
+    }
+
+    uint8_t inv = gfInv(mat[col][col]);
+    for (uint8_t c = 0; c < e; c++) mat[col][c] = gfMul(mat[col][c], inv);
+    for (uint8_t n2 = 0; n2 < b.payloadLen; n2++) rhs[col][n2] = gfMul(rhs[col][n2], inv);
+
+    for (uint8_t r = 0; r < e; r++) {
+      uint8_t f = mat[r][col];
+      if (r == col || f == 0) continue;
+      for (uint8_t c = 0; c < e; c++) mat[r][c] ^= gfMul(f, mat[col][c]);
+      gfAddMul(rhs[r], rhs[col], f, b.payloadLen);
+    }
+  }
+
+  for (uint8_t c = 0; c < e; c++) {
+    uint8_t i = missIdx[c];
+    uint32_t bit = 1UL << i;
+    memcpy(b.data[i], rhs[c], b.payloadLen);
+    b.dataMask |= bit;
+    if (!(b.deliveredMask & bit)) {
+      b.deliveredMask |= bit;
+      _recovered++;
+      if (_deliver) _deliver(b.data[i], b.payloadLen, true);
+    }
+  }
+}
@@ -0,0 +1,116 @@
+/**
+ * ESP Chas TV - Forward Error Correction for one-to-many broadcasts
+ *
+ * Systematic Reed-Solomon erasure code over GF(256) using a Cauchy
+ * generator matrix. A block of k cue packets is sent unchanged, followed
+ * by m repair packets. A receiver that gets ANY k of the n = k + m
+ * packets rebuilds the missing cues without asking for a retransmit.
+ *
+ * Data packets are delivered the moment they arrive, so FEC adds no
+ * latency to cues that make it through; only lost cues wait for the
+ * repair packets at the end of the block.
+ *
+ * Packet layout (FEC_HEADER_SIZE + payload length bytes):
+ *   [0] FEC_MAGIC
+ *   [1] block id    (wraps at 255)
+ *   [2] index       (0..k-1 = data, k.. = repair)
+ *   [3] k           (0 on data packets - block may be flushed early)
+ *   [4] m
+ *   [5..] payload
+ */
+
+#ifndef CHAOS_FEC_CODEC_H
+#define CHAOS_FEC_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FEC_MAGIC        0xFE
+#define FEC_HEADER_SIZE  5
+#define FEC_MAX_K        16   // Max data packets per block
+#define FEC_MAX_M        8    // Max repair packets per block
+#define FEC_MAX_PAYLOAD  32   // Max payload bytes per packet
+#define FEC_MAX_PACKET   (FEC_HEADER_SIZE + FEC_MAX_PAYLOAD)
+
+/**
+ * Transmit side. Repair symbols are accumulated as data is added,
+ * so the encoder never has to keep a copy of the block.
+ */
+class FecEncoder {
+public:
+  FecEncoder();
+
+  // Per-show tuning. Returns false if k/m/payload are out of range.
+  bool configure(uint8_t k, uint8_t m, uint8_t payloadLen);
+
+  uint8_t k() const { return _k; }
+  uint8_t m() const { return _m; }
+  uint8_t payloadLen() const { return _payloadLen; }
+  uint8_t pending() const { return _count; }
+
+  // Wraps payload into a data packet. Returns packet length, or 0 once
+  // the block is full - send its repairs and closeBlock() first.
+  size_t addData(const uint8_t* payload, uint8_t* packet);
+
+  // True once k data packets have been added.
+  bool blockFull() const { return _count >= _k; }
+
+  // Repair packets for the current (possibly partial) block.
+  uint8_t repairCount() const { return _count ? _m : 0; }
+  size_t makeRepair(uint8_t j, uint8_t* packet) const;
+
+  // Start the next block.
+  void closeBlock();
+
+private:
+  uint8_t _k, _m, _payloadLen;
+  uint8_t _blockId;
+  uint8_t _count;
+  uint8_t _repair[FEC_MAX_M][FEC_MAX_PAYLOAD];
+};
+
+/**
+ * Receive side. Keeps two blocks in flight so a late repair packet for
+ * the previous block is still useful after the next block has started.
+ */
+class FecDecoder {
+public:
+  // Called once per cue: straight away for received data packets, and
+  // again for every cue rebuilt from repair packets.
+  typedef void (*DeliverFn)(const uint8_t* payload, uint8_t len, bool recovered);
+
+  FecDecoder();
+
+  void onDeliver(DeliverFn fn) { _deliver = fn; }
+
+  // Feed a raw packet. Returns false if it is not a valid FEC packet.
+  bool receive(const uint8_t* packet, size_t len);
+
+  uint32_t recoveredCount() const { return _recovered; }
+  uint32_t lostCount() const { return _lost; }
+
+private:
+  struct Block {
+    bool active;
+    uint8_t id;
+    uint8_t k;            // 0 until a repair packet tells us
+    uint8_t m;
+    uint8_t payloadLen;
+    uint32_t dataMask;    // data packets held
+    uint32_t repairMask;  // repair packets held
+    uint32_t deliveredMask;
+    uint8_t data[FEC_MAX_K][FEC_MAX_PAYLOAD];
+    uint8_t repair[FEC_MAX_M][FEC_MAX_PAYLOAD];
+  };
+
+  Block* slotFor(uint8_t id, uint8_t payloadLen);
+  void retire(Block& b);
+  void tryRecover(Block& b);
+
+  Block _blocks[2];
+  DeliverFn _deliver;
+  uint32_t _recovered;
+  uint32_t _lost;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * ESP Chas TV - Fixed-capacity strings
+ *
+ * Drop-in for the `String` building the sketches do (`html += "..."`),
+ * backed by storage that never moves: a global FixedString lives in .bss,
+ * a local one on the stack. Nothing here touches the heap, so an
+ * 8-hour show can't fragment it.
+ *
+ * Appends past capacity are cut off and flagged with truncated(); the
+ * buffer is always NUL-terminated.
+ *
+ *   FixedString<32> scene;
+ *   scene = "Scene ";
+ *   scene += 2;              // "Scene 2"
+ *
+ * Functions that only write text take a StrBuf&, so they work with any
+ * capacity.
+ */
+
+#ifndef CHAOS_FIXED_STRING_H
+#define CHAOS_FIXED_STRING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class StrBuf {
+public:
+  const char* c_str() const { return _buf; }
+  size_t length() const { return _len; }
+  size_t capacity() const { return _cap; }
+  bool truncated() const { return _truncated; }
+
+  void clear() {
+    _len = 0;
+    _buf[0] = '\0';
+    _truncated = false;
+  }
+
+  StrBuf& append(const char* s, size_t n) {
+    if (n > _cap - _len) {
+      n = _cap - _len;
+      _truncated = true;
+    }
+    memcpy(_buf + _len, s, n);
+    _len += n;
+    _buf[_len] = '\0';
+    return *this;
+  }
+
+  StrBuf& append(const char* s) { return append(s, strlen(s)); }
+
+  StrBuf& append(int32_t v) {
+    char tmp[12];
+    char* p = tmp + sizeof(tmp);
+    uint32_t u = v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+    do {
+      *--p = (char)('0' + u % 10);
+      u /= 10;
+    } while (u);
+    if (v < 0) *--p = '-';
+    return append(p, tmp + sizeof(tmp) - p);
+  }
+
+  StrBuf& operator=(const char* s) {
+    clear();
+    return append(s);
+  }
+
+  StrBuf& operator+=(const char* s) { return append(s); }
+  StrBuf& operator+=(int32_t v) { return append(v); }
+
+  bool operator==(const char* s) const { return strcmp(_buf, s) == 0; }
+
+protected:
+  StrBuf(char* buf, size_t cap) : _buf(buf), _cap(cap), _len(0), _truncated(false) {
+    _buf[0] = '\0';
+  }
+
+private:
+  // Storage belongs to the derived FixedString - no copies through the base
+  StrBuf(const StrBuf&);
+  StrBuf& operator=(const StrBuf&);
+
+  char* _buf;
+  size_t _cap;
+  size_t _len;
+  bool _truncated;
+};
+
+template <size_t N>
+class FixedString : public StrBuf {
+public:
+  FixedString() : StrBuf(_storage, N) {}
+
+  FixedString(const char* s) : StrBuf(_storage, N) { append(s); }
+
+  FixedString(const FixedString& other) : StrBuf(_storage, N) { append(other.c_str()); }
+
+  FixedString& operator=(const FixedString& other) {
+    if (this != &other) {
+      clear();
+      append(other.c_str());
+    }
+    return *this;
+  }
+
+  FixedString& operator=(const char* s) {
+    StrBuf::operator=(s);
+    return *this;
+  }
+
+private:
+  char _storage[N + 1];
+};
+
+#endif
@@ -0,0 +1,608 @@
+/**
+ * ESP Chas TV - Fleet-wide config and firmware distribution
+ */
+
+#include "FleetUpdate.h"
+
+#include <string.h>
+
+static inline bool bitGet(const uint8_t* map, uint32_t i) { return map[i >> 3] & (1 << (i & 7)); }
+static inline void bitSet(uint8_t* map, uint32_t i) { map[i >> 3] |= (uint8_t)(1 << (i & 7)); }
+static inline void bitClear(uint8_t* map, uint32_t i) { map[i >> 3] &= (uint8_t)~(1 << (i & 7)); }
+
+static uint16_t chunksFor(uint32_t bytes) {
+  return (uint16_t)((bytes + FLEET_CHUNK_SIZE - 1) / FLEET_CHUNK_SIZE);
+}
+
+static uint16_t chunkLen(const FleetAnnounce& a, uint16_t index) {
+  uint32_t left = a.payloadSize - (uint32_t)index * FLEET_CHUNK_SIZE;
+  return (uint16_t)(left < FLEET_CHUNK_SIZE ? left : FLEET_CHUNK_SIZE);
+}
+
+// NACK bits actually carried by a frame of `len` bytes
+static uint16_t nackBits(const FleetNack& n, size_t len) {
+  uint32_t carried = (uint32_t)(len - offsetof(FleetNack, map)) * 8;
+  uint32_t bits = n.bits < FLEET_NACK_BITS ? n.bits : FLEET_NACK_BITS;
+  return (uint16_t)(bits < carried ? bits : carried);
+}
+
+uint32_t fleetCrc32(uint32_t crc, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (uint8_t b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0u - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+void fleetTagBegin(HmacSha256& mac, const uint8_t key[FLEET_KEY_SIZE], uint8_t kind, uint8_t board,
+                   uint32_t version, uint32_t imageSize) {
+  uint8_t head[14];
+  uint32_t magic = FLEET_TAG_MAGIC;
+  for (uint8_t i = 0; i < 4; i++) {
+    head[i] = (uint8_t)(magic >> (8 * i));
+    head[6 + i] = (uint8_t)(version >> (8 * i));
+    head[10 + i] = (uint8_t)(imageSize >> (8 * i));
+  }
+  head[4] = kind;
+  head[5] = board;
+  mac.begin(key, FLEET_KEY_SIZE);
+  mac.update(head, sizeof(head));
+}
+
+void fleetTag(const uint8_t key[FLEET_KEY_SIZE], uint8_t kind, uint8_t board, uint32_t version,
+              const uint8_t* image, uint32_t imageSize, uint8_t tag[FLEET_TAG_SIZE]) {
+  HmacSha256 mac;
+  fleetTagBegin(mac, key, kind, board, version, imageSize);
+  mac.update(image, imageSize);
+  mac.finish(tag);
+}
+
+bool fleetHexDecode(const char* hex, uint8_t* out, size_t len) {
+  if (!hex) return false;
+  for (size_t i = 0; i < 2 * len; i++) {
+    char c = hex[i];
+    uint8_t v;
+    if (c >= '0' && c <= '9') v = (uint8_t)(c - '0');
+    else if (c >= 'a' && c <= 'f') v = (uint8_t)(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F') v = (uint8_t)(c - 'A' + 10);
+    else return false;
+    if (i & 1) out[i / 2] |= v;
+    else out[i / 2] = (uint8_t)(v << 4);
+  }
+  return hex[2 * len] == '\0';
+}
+
+const char* fleetStatusName(uint8_t status) {
+  switch (status) {
+    case FLEET_OK:            return "ok";
+    case FLEET_BAD_PAYLOAD:   return "bad-payload";
+    case FLEET_BAD_DELTA:     return "bad-delta";
+    case FLEET_BAD_IMAGE:     return "bad-image";
+    case FLEET_WRITE_FAILED:  return "write-failed";
+    case FLEET_COMMIT_FAILED: return "commit-failed";
+    case FLEET_TIMEOUT:       return "timeout";
+    case FLEET_BAD_TAG:       return "bad-tag";
+    default:                  return "?";
+  }
+}
+
+// ---------------------------------------------------------------------------
+// FleetSender
+// ---------------------------------------------------------------------------
+
+FleetSender::FleetSender()
+  : _nodeId(0), _send(0), _ctx(0), _read(0), _readCtx(0), _sessions(0),
+    _state(IDLE), _cursor(0), _quiet(0), _nextChunk(0), _lastAnnounce(0), _windowEnd(0) {
+  memset(&_announce, 0, sizeof(_announce));
+  memset(_needed, 0, sizeof(_needed));
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void FleetSender::begin(uint32_t nodeId, FleetSendFn send, void* ctx) {
+  _nodeId = nodeId;
+  _send = send;
+  _ctx = ctx;
+}
+
+bool FleetSender::offer(const FleetOffer& offer, ReadFn read, void* readCtx, uint32_t now) {
+  uint32_t chunks = ((uint64_t)offer.payloadSize + FLEET_CHUNK_SIZE - 1) / FLEET_CHUNK_SIZE;
+  if (!_send || !read || chunks == 0 || chunks > FLEET_MAX_CHUNKS) return false;
+  if (offer.kind < FLEET_CONFIG || offer.kind >= FLEET_KIND_COUNT) return false;
+
+  memset(&_announce, 0, sizeof(_announce));
+  _announce.h.magic = FLEET_MAGIC;
+  _announce.h.type = FLEET_ANNOUNCE;
+  _announce.h.kind = offer.kind;
+  _announce.h.board = offer.board;
+  // Differs per sender, object and offer, so receivers never mix chunks
+  // of two objects - even across a sender reboot
+  _announce.h.session = _nodeId ^ (offer.payloadCrc * 2654435761u) ^ (offer.version << 16) ^ ++_sessions;
+  if (_announce.h.session == 0) _announce.h.session = 1;
+  _announce.version = offer.version;
+  _announce.baseVersion = offer.baseVersion;
+  _announce.payloadSize = offer.payloadSize;
+  _announce.payloadCrc = offer.payloadCrc;
+  _announce.imageSize = offer.imageSize;
+  _announce.imageCrc = offer.imageCrc;
+  memcpy(_announce.tag, offer.tag, sizeof(_announce.tag));
+  _announce.chunkCount = (uint16_t)chunks;
+  _announce.round = 1;
+
+  memset(_needed, 0, sizeof(_needed));
+  for (uint32_t i = 0; i < chunks; i++) bitSet(_needed, i);
+
+  _read = read;
+  _readCtx = readCtx;
+  _cursor = 0;
+  _quiet = 0;
+  _nextChunk = now;
+  memset(&_stats, 0, sizeof(_stats));
+  _stats.rounds = 1;
+  _state = SENDING;
+  sendAnnounce(false, now);
+  return true;
+}
+
+uint16_t FleetSender::pending() const {
+  uint16_t n = 0;
+  for (uint16_t i = 0; i < _announce.chunkCount; i++) {
+    if (bitGet(_needed, i)) n++;
+  }
+  return n;
+}
+
+void FleetSender::sendAnnounce(bool endOfRound, uint32_t now) {
+  _announce.endOfRound = endOfRound ? 1 : 0;
+  if (!_send(_ctx, (const uint8_t*)&_announce, sizeof(_announce))) _stats.sendFailed++;
+  _lastAnnounce = now;
+}
+
+bool FleetSender::sendChunk(uint16_t index) {
+  FleetChunk c;
+  c.h = _announce.h;
+  c.h.type = FLEET_CHUNK;
+  c.index = index;
+  c.len = chunkLen(_announce, index);
+  if (!_read(_readCtx, (uint32_t)index * FLEET_CHUNK_SIZE, c.data, c.len)) return false;
+  return _send(_ctx, (const uint8_t*)&c, offsetof(FleetChunk, data) + c.len);
+}
+
+bool FleetSender::onMessage(const uint8_t* data, size_t len) {
+  if (len < sizeof(FleetHeader) || data[0] != FLEET_MAGIC) return false;
+  FleetHeader h;
+  memcpy(&h, data, sizeof(h));
+  if (_announce.h.session == 0 || h.session != _announce.h.session) return true;
+
+  // DONE still counts after the last round - verifying a firmware image
+  // takes the boards longer than the sender waits
+  if (h.type == FLEET_NACK && _state != IDLE && len >= offsetof(FleetNack, map)) {
+    FleetNack n;
+    memset(&n, 0, sizeof(n));
+    memcpy(&n, data, len < sizeof(n) ? len : sizeof(n));
+    uint16_t bits = nackBits(n, len < sizeof(n) ? len : sizeof(n));
+    // Chunks behind the cursor go out next round, the rest still in this one
+    for (uint16_t i = 0; i < bits; i++) {
+      uint32_t index = (uint32_t)n.first + i;
+      if (index < _announce.chunkCount && bitGet(n.map, i)) bitSet(_needed, index);
+    }
+    _stats.nacks++;
+  } else if (h.type == FLEET_DONE && len >= sizeof(FleetDone)) {
+    FleetDone d;
+    memcpy(&d, data, sizeof(d));
+    if (d.status == FLEET_OK) _stats.done++;
+    else _stats.failed++;
+  }
+  return true;
+}
+
+void FleetSender::update(uint32_t now) {
+  if (_state == IDLE) return;
+
+  if (_state == SENDING) {
+    if (now - _lastAnnounce >= FLEET_ANNOUNCE_MS) sendAnnounce(false, now);
+
+    // A few chunks per call at most, so a slow loop() doesn't burst
+    for (uint8_t burst = 0; burst < 4 && (int32_t)(now - _nextChunk) >= 0; burst++) {
+      while (_cursor < _announce.chunkCount && !bitGet(_needed, _cursor)) _cursor++;
+      if (_cursor >= _announce.chunkCount) {
+        sendAnnounce(true, now);
+        _windowEnd = now + FLEET_NACK_WINDOW_MS;
+        _state = COLLECTING;
+        return;
+      }
+      // A failed send keeps its bit and goes again next round
+      if (sendChunk(_cursor)) {
+        bitClear(_needed, _cursor);
+        _stats.chunks++;
+        if (_announce.round > 1) _stats.repairs++;
+      } else {
+        _stats.sendFailed++;
+      }
+      _cursor++;
+      _nextChunk += FLEET_CHUNK_INTERVAL_MS;
+    }
+    if ((int32_t)(now - _nextChunk) > 4 * FLEET_CHUNK_INTERVAL_MS) _nextChunk = now;
+    return;
+  }
+
+  // COLLECTING: NACK window over
+  if ((int32_t)(now - _windowEnd) < 0) return;
+  bool repairs = pending() > 0;
+  if (repairs) _quiet = 0;
+  else if (++_quiet >= FLEET_QUIET_ROUNDS) {
+    _state = IDLE;
+    return;
+  }
+  if (_announce.round >= FLEET_MAX_ROUNDS) {
+    _state = IDLE;
+    return;
+  }
+
+  _announce.round++;
+  _stats.rounds++;
+  _cursor = 0;
+  if (repairs) {
+    _nextChunk = now;
+    _state = SENDING;
+  } else {
+    // Nothing asked for - end the round again for anyone who missed it
+    sendAnnounce(true, now);
+    _windowEnd = now + FLEET_NACK_WINDOW_MS;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// FleetReceiver
+// ---------------------------------------------------------------------------
+
+FleetReceiver::FleetReceiver()
+  : _nodeId(0), _board(FLEET_ANY_BOARD), _send(0), _ctx(0), _rng(1), _hasKey(false),
+    _receiving(false), _staging(0), _received(0), _lastHeard(0),
+    _nackDue(false), _nackAt(0), _rejected(0), _lastStatus(FLEET_OK) {
+  memset(_key, 0, sizeof(_key));
+  memset(_targets, 0, sizeof(_targets));
+  memset(&_announce, 0, sizeof(_announce));
+  memset(_have, 0, sizeof(_have));
+  memset(_erased, 0, sizeof(_erased));
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void FleetReceiver::begin(uint32_t nodeId, uint8_t board, FleetSendFn send, void* ctx) {
+  _nodeId = nodeId;
+  _board = board;
+  _send = send;
+  _ctx = ctx;
+  _rng = nodeId ? nodeId : 0x9E3779B9;
+}
+
+void FleetReceiver::setKey(const uint8_t* key) {
+  _hasKey = key != 0;
+  if (key) memcpy(_key, key, sizeof(_key));
+  else memset(_key, 0, sizeof(_key));
+}
+
+void FleetReceiver::accept(uint8_t kind, JournalStore* slot, JournalStore* base, uint32_t version,
+                           CommitFn commit, void* commitCtx) {
+  if (kind < FLEET_CONFIG || kind >= FLEET_KIND_COUNT) return;
+  Target& t = _targets[kind];
+  t.slot = slot;
+  t.base = base;
+  t.version = version;
+  t.commit = commit;
+  t.ctx = commitCtx;
+}
+
+uint32_t FleetReceiver::version(uint8_t kind) const {
+  return kind < FLEET_KIND_COUNT ? _targets[kind].version : 0;
+}
+
+uint32_t FleetReceiver::random() {
+  _rng ^= _rng << 13;
+  _rng ^= _rng >> 17;
+  _rng ^= _rng << 5;
+  return _rng;
+}
+
+bool FleetReceiver::wants(const FleetAnnounce& a) {
+  if (a.h.kind < FLEET_CONFIG || a.h.kind >= FLEET_KIND_COUNT) return false;
+  const Target& t = _targets[a.h.kind];
+  if (!_hasKey || !t.slot || a.h.session == _rejected) return false;
+  if (a.h.board != FLEET_ANY_BOARD && a.h.board != _board) return false;
+  if (a.version <= t.version) return false;
+  if (a.baseVersion != 0 && (a.baseVersion != t.version || !t.base)) return false;
+  if (a.baseVersion == 0 && a.payloadSize != a.imageSize) return false;
+  if (a.chunkCount == 0 || a.chunkCount > FLEET_MAX_CHUNKS || a.chunkCount != chunksFor(a.payloadSize)) {
+    return false;
+  }
+
+  uint32_t ss = t.slot->sectorSize();
+  uint16_t sectors = t.slot->sectorCount();
+  uint32_t bytes = ss * (sectors < FLEET_MAX_SECTORS ? sectors : FLEET_MAX_SECTORS);
+  if (a.payloadSize > bytes) return false;
+  if (a.baseVersion == 0) return true;
+  // Delta at the end of the slot, patched image from the start - they
+  // mustn't share a sector
+  uint32_t staging = (bytes - a.payloadSize) / ss * ss;
+  return (a.imageSize + ss - 1) / ss * ss <= staging;
+}
+
+void FleetReceiver::start(const FleetAnnounce& a, uint32_t now) {
+  _announce = a;
+  _receiving = true;
+  _staging = 0;
+  if (a.baseVersion != 0) {
+    JournalStore* slot = _targets[a.h.kind].slot;
+    uint32_t ss = slot->sectorSize();
+    uint16_t sectors = slot->sectorCount();
+    uint32_t bytes = ss * (sectors < FLEET_MAX_SECTORS ? sectors : FLEET_MAX_SECTORS);
+    _staging = (bytes - a.payloadSize) / ss * ss;
+  }
+  memset(_have, 0, sizeof(_have));
+  memset(_erased, 0, sizeof(_erased));
+  _received = 0;
+  _lastHeard = now;
+  _nackDue = false;
+}
+
+void FleetReceiver::finish(uint8_t status) {
+  _receiving = false;
+  _nackDue = false;
+  _lastStatus = status;
+  if (status == FLEET_OK) _targets[_announce.h.kind].version = _announce.version;
+  // A sender that went quiet may come back with the same object; a bad
+  // one stays bad
+  else if (status != FLEET_TIMEOUT) _rejected = _announce.h.session;
+  if (status == FLEET_TIMEOUT || !_send) return;
+
+  FleetDone d;
+  memset(&d, 0, sizeof(d));
+  d.h = _announce.h;
+  d.h.type = FLEET_DONE;
+  d.node = _nodeId;
+  d.version = _announce.version;
+  d.status = status;
+  _send(_ctx, (const uint8_t*)&d, sizeof(d));
+}
+
+bool FleetReceiver::missing(uint16_t index) const {
+  return !bitGet(_have, index);
+}
+
+bool FleetReceiver::coveredBy(const FleetNack& nack, uint16_t bits) const {
+  for (uint16_t i = 0; i < _announce.chunkCount; i++) {
+    if (!missing(i)) continue;
+    if (i < nack.first || i - nack.first >= bits || !bitGet(nack.map, i - nack.first)) return false;
+  }
+  return true;
+}
+
+bool FleetReceiver::onMessage(const uint8_t* data, size_t len, uint32_t now) {
+  if (len < sizeof(FleetHeader) || data[0] != FLEET_MAGIC) return false;
+  FleetHeader h;
+  memcpy(&h, data, sizeof(h));
+  bool current = _receiving && h.session == _announce.h.session;
+
+  switch (h.type) {
+    case FLEET_ANNOUNCE: {
+      if (len < sizeof(FleetAnnounce)) break;
+      FleetAnnounce a;
+      memcpy(&a, data, sizeof(a));
+      if (!current) {
+        // One object at a time; a sender that went quiet loses its claim
+        if (_receiving && (int32_t)(now - _lastHeard) < FLEET_RX_TIMEOUT_MS) break;
+        if (!wants(a)) {
+          _stats.ignored++;
+          break;
+        }
+        start(a, now);
+      }
+      _lastHeard = now;
+      _announce.round = a.round;
+      // Spread the answers over half the window so 60 boards don't all
+      // NACK in the same millisecond
+      if (a.endOfRound && _received < _announce.chunkCount && !_nackDue) {
+        _nackDue = true;
+        _nackAt = now + random() % (FLEET_NACK_WINDOW_MS / 2);
+      }
+      break;
+    }
+
+    case FLEET_CHUNK: {
+      if (!current || len < offsetof(FleetChunk, data)) break;
+      FleetChunk c;
+      memcpy(&c, data, offsetof(FleetChunk, data));
+      if (c.index >= _announce.chunkCount || c.len != chunkLen(_announce, c.index) ||
+          len < offsetof(FleetChunk, data) + c.len) {
+        break;
+      }
+      _lastHeard = now;
+      if (!missing(c.index)) {
+        _stats.duplicates++;
+        break;
+      }
+      if (!writeSlot(_targets[_announce.h.kind].slot, _staging + (uint32_t)c.index * FLEET_CHUNK_SIZE,
+                     data + offsetof(FleetChunk, data), c.len)) {
+        finish(FLEET_WRITE_FAILED);
+        break;
+      }
+      bitSet(_have, c.index);
+      _received++;
+      _stats.chunks++;
+      break;
+    }
+
+    case FLEET_NACK: {
+      // Someone else already asked for everything we miss - stay quiet
+      if (!current || !_nackDue || len < offsetof(FleetNack, map)) break;
+      FleetNack n;
+      memset(&n, 0, sizeof(n));
+      size_t nLen = len < sizeof(n) ? len : sizeof(n);
+      memcpy(&n, data, nLen);
+      if (n.node != _nodeId && coveredBy(n, nackBits(n, nLen))) {
+        _nackDue = false;
+        _stats.nacksSuppressed++;
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+  return true;
+}
+
+void FleetReceiver::sendNacks() {
+  if (!_send) return;
+  FleetNack n;
+  n.h = _announce.h;
+  n.h.type = FLEET_NACK;
+  n.node = _nodeId;
+
+  uint32_t i = 0;
+  for (uint8_t frames = 0; frames < FLEET_NACKS_PER_ROUND; frames++) {
+    while (i < _announce.chunkCount && !missing(i)) i++;
+    if (i >= _announce.chunkCount) return;
+
+    memset(n.map, 0, sizeof(n.map));
+    n.first = (uint16_t)i;
+    uint16_t bits = 0;
+    for (uint16_t j = 0; j < FLEET_NACK_BITS && i + j < _announce.chunkCount; j++) {
+      if (missing(i + j)) {
+        bitSet(n.map, j);
+        bits = j + 1;
+      }
+    }
+    n.bits = bits;
+    _send(_ctx, (const uint8_t*)&n, offsetof(FleetNack, map) + (bits + 7) / 8);
+    _stats.nacksSent++;
+    i += bits;
+  }
+}
+
+void FleetReceiver::update(uint32_t now) {
+  if (!_receiving) return;
+  if (_received == _announce.chunkCount) {
+    finish(verifyAndCommit());
+    return;
+  }
+  if ((int32_t)(now - _lastHeard) >= FLEET_RX_TIMEOUT_MS) {
+    finish(FLEET_TIMEOUT);
+    return;
+  }
+  if (_nackDue && (int32_t)(now - _nackAt) >= 0) {
+    _nackDue = false;
+    sendNacks();
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Slot access, verify, patch
+// ---------------------------------------------------------------------------
+
+// Sectors are erased the first time they're written, so an update only
+// erases what it uses
+bool FleetReceiver::writeSlot(JournalStore* slot, uint32_t addr, const uint8_t* data, size_t len) {
+  uint32_t ss = slot->sectorSize();
+  for (uint32_t s = addr / ss; s <= (addr + len - 1) / ss; s++) {
+    if (s >= FLEET_MAX_SECTORS || s >= slot->sectorCount()) return false;
+    if (!bitGet(_erased, s)) {
+      if (!slot->erase((uint16_t)s)) return false;
+      bitSet(_erased, s);
+    }
+  }
+  return slot->write(addr, data, len);
+}
+
+// `mac`, if given, is fed the same bytes - the image is read once for both
+uint32_t FleetReceiver::slotCrc(JournalStore* slot, uint32_t addr, uint32_t len, HmacSha256* mac) {
+  uint8_t buf[256];
+  uint32_t crc = 0;
+  while (len) {
+    uint32_t n = len < sizeof(buf) ? len : sizeof(buf);
+    if (!slot->read(addr, buf, n)) return ~crc;
+    crc = fleetCrc32(crc, buf, n);
+    if (mac) mac->update(buf, n);
+    addr += n;
+    len -= n;
+  }
+  return crc;
+}
+
+bool FleetReceiver::applyDelta(Target& t) {
+  uint32_t pos = _staging;
+  uint32_t end = _staging + _announce.payloadSize;
+  uint32_t out = 0;
+  uint32_t baseBytes = t.base->sectorSize() * t.base->sectorCount();
+  uint8_t buf[256];
+
+  uint32_t magic = 0;
+  if (end - pos < 4 || !t.slot->read(pos, &magic, 4) || magic != FLEET_DELTA_MAGIC) return false;
+  pos += 4;
+
+  while (pos < end) {
+    uint8_t op;
+    if (!t.slot->read(pos++, &op, 1)) return false;
+
+    JournalStore* from;
+    uint32_t src, n;
+    if (op == FLEET_OP_COPY) {
+      uint32_t args[2];
+      if (end - pos < sizeof(args) || !t.slot->read(pos, args, sizeof(args))) return false;
+      pos += sizeof(args);
+      from = t.base;
+      src = args[0];
+      n = args[1];
+      if (src > baseBytes || n > baseBytes - src) return false;
+    } else if (op == FLEET_OP_ADD) {
+      uint16_t len;
+      if (end - pos < sizeof(len) || !t.slot->read(pos, &len, sizeof(len))) return false;
+      pos += sizeof(len);
+      if (len > end - pos) return false;
+      from = t.slot;
+      src = pos;
+      n = len;
+      pos += len;
+    } else {
+      return false;
+    }
+
+    if (n > _announce.imageSize - out) return false;
+    while (n) {
+      uint32_t k = n < sizeof(buf) ? n : sizeof(buf);
+      if (!from->read(src, buf, k) || !writeSlot(t.slot, out, buf, k)) return false;
+      src += k;
+      out += k;
+      n -= k;
+    }
+  }
+  return out == _announce.imageSize;
+}
+
+uint8_t FleetReceiver::verifyAndCommit() {
+  Target& t = _targets[_announce.h.kind];
+  HmacSha256 mac;
+  fleetTagBegin(mac, _key, _announce.h.kind, _announce.h.board, _announce.version, _announce.imageSize);
+
+  // A full object is its own image: one pass checks the CRC and feeds the tag
+  bool full = _announce.baseVersion == 0;
+  if (slotCrc(t.slot, _staging, _announce.payloadSize, full ? &mac : 0) != _announce.payloadCrc) {
+    return FLEET_BAD_PAYLOAD;
+  }
+  if (!full) {
+    if (!applyDelta(t)) return FLEET_BAD_DELTA;
+    if (slotCrc(t.slot, 0, _announce.imageSize, &mac) != _announce.imageCrc) return FLEET_BAD_IMAGE;
+  } else if (_announce.payloadCrc != _announce.imageCrc) {
+    return FLEET_BAD_IMAGE;
+  }
+
+  uint8_t tag[FLEET_TAG_SIZE];
+  mac.finish(tag);
+  if (!sha256Equal(tag, _announce.tag)) return FLEET_BAD_TAG;
+
+  if (t.commit && !t.commit(t.ctx, _announce, t.slot)) return FLEET_COMMIT_FAILED;
+  return FLEET_OK;
+}
@@ -0,0 +1,381 @@
+/**
+ * ESP Chas TV - Fleet-wide config and firmware distribution
+ *
+ * Sends one object - a config blob (NodeConfig.h) or a firmware image -
+ * to every board at once over broadcast, so updating 60 fixtures takes
+ * about as long as updating one.
+ *
+ * The sender cuts the payload into FLEET_CHUNK_SIZE chunks and
+ * broadcasts each once, announcing the object every FLEET_ANNOUNCE_MS
+ * so boards that power up late can join. At the end of a pass it
+ * announces "end of round" and listens: each receiver answers with a
+ * NACK carrying a bitmap of the chunks it is missing (after a random
+ * delay, and not at all if another board already asked for the same
+ * chunks). The next round re-sends only the union of what was asked
+ * for. Two quiet rounds in a row and the sender is done.
+ *
+ *   ANNOUNCE  session, kind, board, version, base, payload/image size+crc, tag
+ *   CHUNK     session, index, data[200]
+ *   NACK      session, node, first, bitmap (up to FLEET_NACK_BITS chunks)
+ *   DONE      session, node, version, status
+ *
+ * Delta payloads: a firmware image can be sent as a patch against the
+ * version the boards are running (baseVersion), made on a computer with
+ * scripts/fleet_delta.py:
+ *
+ *   delta:  "FDL1", op, op, ...
+ *   op:     COPY  u32 offset, u32 len   - bytes from the running image
+ *           ADD   u16 len, bytes        - new bytes
+ *
+ * Receivers only take objects newer than what they run, for their chip
+ * (firmware), and whose base they have. The payload is staged in the
+ * target slot (the inactive OTA partition for firmware) - a delta at the
+ * end of it, the patched image written from the start - and nothing is
+ * switched over until both the payload CRC and the final image CRC
+ * check out. Then the commit callback swaps (sets the boot partition,
+ * or saves the config).
+ *
+ * Authentication: anyone in radio range can broadcast fleet frames, so
+ * CRCs only catch transmission errors. Every announce carries a tag,
+ * HMAC-SHA256 under a 32-byte fleet key of the kind, board, version,
+ * image size and the final image bytes (fleetTagBegin()). A receiver
+ * checks it after patching, before the commit callback runs, and
+ * without a key (setKey()) it takes no objects at all - fleet updates
+ * are off until a key is provisioned. The key is stored on each board
+ * (never in the firmware, which is broadcast) and by whoever signs:
+ * scripts/fleet_delta.py for firmware, the gateway for config blobs.
+ * Replaying an old signed object does nothing - only newer versions are
+ * taken. A forged offer still costs a transfer's worth of airtime and
+ * flash writes before it is refused.
+ *
+ * Transport-agnostic like MeshRouter: frames go out through a SendFn,
+ * times are millis() from the caller, no heap. Frames fit ESP-NOW's
+ * 250-byte limit.
+ */
+
+#ifndef CHAOS_FLEET_UPDATE_H
+#define CHAOS_FLEET_UPDATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "StateJournal.h"
+#include "Sha256.h"
+
+#ifndef CHAOS_FW_VERSION
+#define CHAOS_FW_VERSION 1   // Bump per release: -DCHAOS_FW_VERSION=n
+#endif
+
+#define FLEET_MAGIC             0xF1
+#define FLEET_MAX_FRAME         250     // ESP-NOW payload limit
+#define FLEET_CHUNK_SIZE        200
+#define FLEET_MAX_CHUNKS        8192    // 1.6 MB per object
+#define FLEET_MAX_SECTORS       512     // Slot sectors tracked for erasing
+#define FLEET_NACK_BITS         1600    // Chunks one NACK can ask for
+#define FLEET_NACKS_PER_ROUND   4       // NACK frames per receiver per round
+
+#define FLEET_CHUNK_INTERVAL_MS 5       // Sender pacing
+#define FLEET_ANNOUNCE_MS       1000
+#define FLEET_NACK_WINDOW_MS    400     // Listening for NACKs after a round
+#define FLEET_QUIET_ROUNDS      2       // Rounds without NACKs before done
+#define FLEET_MAX_ROUNDS        64
+#define FLEET_RX_TIMEOUT_MS     15000   // Receiver gives up on a silent sender
+
+#define FLEET_ANY_BOARD         0xFF    // FleetAnnounce.board for config blobs
+#define FLEET_KEY_SIZE          32
+#define FLEET_TAG_SIZE          SHA256_SIZE
+#define FLEET_TAG_MAGIC         0x31544C46   // "FLT1", first bytes under the tag
+#define FLEET_DELTA_MAGIC       0x314C4446   // "FDL1"
+#define FLEET_OP_COPY           0x01
+#define FLEET_OP_ADD            0x02
+
+enum FleetKind {
+  FLEET_CONFIG = 1,
+  FLEET_FIRMWARE = 2,
+  FLEET_KIND_COUNT
+};
+
+enum FleetType {
+  FLEET_ANNOUNCE = 1,
+  FLEET_CHUNK,
+  FLEET_NACK,
+  FLEET_DONE
+};
+
+enum FleetStatus {
+  FLEET_OK,
+  FLEET_BAD_PAYLOAD,    // Payload CRC mismatch
+  FLEET_BAD_DELTA,      // Patch doesn't fit the running image
+  FLEET_BAD_IMAGE,      // Image CRC mismatch after patching
+  FLEET_WRITE_FAILED,
+  FLEET_COMMIT_FAILED,  // Verified, but the swap was refused
+  FLEET_TIMEOUT,        // Sender went quiet
+  FLEET_BAD_TAG,        // Not signed with our fleet key
+  FLEET_STATUS_COUNT
+};
+
+// Wire format - little-endian, no padding
+struct FleetHeader {
+  uint8_t magic;
+  uint8_t type;         // FleetType
+  uint8_t kind;         // FleetKind
+  uint8_t board;        // BoardKind the object is for, FLEET_ANY_BOARD
+  uint32_t session;     // Picked by the sender per offer
+};
+
+struct FleetAnnounce {
+  FleetHeader h;
+  uint32_t version;     // Version this object brings
+  uint32_t baseVersion; // Delta against this running version, 0 = full
+  uint32_t payloadSize; // Bytes sent
+  uint32_t payloadCrc;
+  uint32_t imageSize;   // Bytes after patching (= payloadSize if full)
+  uint32_t imageCrc;
+  uint16_t chunkCount;
+  uint16_t round;
+  uint8_t endOfRound;   // 1 = round finished, NACK now
+  uint8_t reserved[3];
+  uint8_t tag[FLEET_TAG_SIZE];   // HMAC of the object, see fleetTagBegin()
+};
+
+struct FleetChunk {
+  FleetHeader h;
+  uint16_t index;
+  uint16_t len;
+  uint8_t data[FLEET_CHUNK_SIZE];
+};
+
+struct FleetNack {
+  FleetHeader h;
+  uint32_t node;
+  uint16_t first;       // Chunk index of bit 0
+  uint16_t bits;
+  uint8_t map[FLEET_NACK_BITS / 8];
+};
+
+struct FleetDone {
+  FleetHeader h;
+  uint32_t node;
+  uint32_t version;
+  uint8_t status;       // FleetStatus
+  uint8_t reserved[3];
+};
+
+static_assert(sizeof(FleetAnnounce) == 72, "FleetAnnounce must stay 72 bytes on the wire");
+static_assert(sizeof(FleetChunk) <= FLEET_MAX_FRAME, "FleetChunk must fit one ESP-NOW frame");
+static_assert(sizeof(FleetNack) <= FLEET_MAX_FRAME, "FleetNack must fit one ESP-NOW frame");
+
+// What the sender is distributing
+struct FleetOffer {
+  uint8_t kind;
+  uint8_t board;
+  uint32_t version;
+  uint32_t baseVersion;
+  uint32_t payloadSize;
+  uint32_t payloadCrc;
+  uint32_t imageSize;
+  uint32_t imageCrc;
+  uint8_t tag[FLEET_TAG_SIZE];
+};
+
+struct FleetSenderStats {
+  uint32_t chunks;       // Chunk frames sent, repairs included
+  uint32_t repairs;      // ...of them in rounds after the first
+  uint32_t rounds;
+  uint32_t nacks;        // NACK frames heard
+  uint32_t done;         // Boards that reported FLEET_OK
+  uint32_t failed;       // Boards that reported anything else
+  uint32_t sendFailed;
+};
+
+struct FleetReceiverStats {
+  uint32_t chunks;       // New chunks stored
+  uint32_t duplicates;
+  uint32_t nacksSent;
+  uint32_t nacksSuppressed;
+  uint32_t ignored;      // Announces for objects we don't want
+};
+
+// Slot in RAM for objects small enough to keep there (config blobs)
+template <uint32_t N>
+class FleetRamSlot : public JournalStore {
+public:
+  FleetRamSlot() { memset(_data, 0xFF, sizeof(_data)); }
+
+  uint32_t sectorSize() const { return N; }
+  uint16_t sectorCount() const { return 1; }
+
+  bool read(uint32_t addr, void* buf, size_t len) {
+    if (addr > N || len > N - addr) return false;
+    memcpy(buf, _data + addr, len);
+    return true;
+  }
+  bool write(uint32_t addr, const void* buf, size_t len) {
+    if (addr > N || len > N - addr) return false;
+    memcpy(_data + addr, buf, len);
+    return true;
+  }
+  bool erase(uint16_t sector) {
+    memset(_data, 0xFF, sizeof(_data));
+    return sector == 0;
+  }
+
+  const uint8_t* data() const { return _data; }
+
+private:
+  uint8_t _data[N];
+};
+
+typedef bool (*FleetSendFn)(void* ctx, const uint8_t* data, size_t len);
+
+class FleetSender {
+public:
+  // Payload bytes at `offset` (the delta or the object itself)
+  typedef bool (*ReadFn)(void* ctx, uint32_t offset, uint8_t* buf, size_t len);
+
+  FleetSender();
+
+  void begin(uint32_t nodeId, FleetSendFn send, void* ctx = 0);
+
+  // Start distributing. Replaces anything still in progress.
+  bool offer(const FleetOffer& offer, ReadFn read, void* readCtx, uint32_t now);
+  void cancel() { _state = IDLE; }
+  bool active() const { return _state != IDLE; }
+
+  // Feed received bytes. Returns false if they aren't a fleet frame.
+  bool onMessage(const uint8_t* data, size_t len);
+
+  // Send what's due. Call from loop().
+  void update(uint32_t now);
+
+  uint32_t session() const { return _announce.h.session; }
+  uint16_t round() const { return _announce.round; }
+  uint16_t chunkCount() const { return _announce.chunkCount; }
+  uint16_t pending() const;   // Chunks waiting to be (re)sent
+  const FleetSenderStats& stats() const { return _stats; }
+
+private:
+  enum State { IDLE, SENDING, COLLECTING };
+
+  void sendAnnounce(bool endOfRound, uint32_t now);
+  bool sendChunk(uint16_t index);
+
+  uint32_t _nodeId;
+  FleetSendFn _send;
+  void* _ctx;
+  ReadFn _read;
+  void* _readCtx;
+  uint32_t _sessions;
+
+  State _state;
+  FleetAnnounce _announce;
+  uint8_t _needed[FLEET_MAX_CHUNKS / 8];
+  uint16_t _cursor;
+  uint8_t _quiet;
+  uint32_t _nextChunk;
+  uint32_t _lastAnnounce;
+  uint32_t _windowEnd;
+
+  FleetSenderStats _stats;
+};
+
+class FleetReceiver {
+public:
+  // Swap to the verified object in `slot` (set the boot partition, save
+  // the config, ...). Return false to refuse it.
+  typedef bool (*CommitFn)(void* ctx, const FleetAnnounce& object, JournalStore* slot);
+
+  FleetReceiver();
+
+  void begin(uint32_t nodeId, uint8_t board, FleetSendFn send, void* ctx = 0);
+
+  // The fleet key (FLEET_KEY_SIZE bytes). NULL or never set: nothing is
+  // taken.
+  void setKey(const uint8_t* key);
+  bool hasKey() const { return _hasKey; }
+
+  // Take objects of `kind` newer than `version` into `slot`. `base` holds
+  // the running version for deltas (NULL = full objects only).
+  void accept(uint8_t kind, JournalStore* slot, JournalStore* base, uint32_t version,
+              CommitFn commit, void* commitCtx = 0);
+
+  // Feed received bytes. Returns false if they aren't a fleet frame.
+  bool onMessage(const uint8_t* data, size_t len, uint32_t now);
+
+  // Send NACKs when due, and verify + commit a complete object. The
+  // verify step reads the whole object back (a few seconds for firmware).
+  void update(uint32_t now);
+
+  bool receiving() const { return _receiving; }
+  uint8_t kind() const { return _announce.h.kind; }
+  uint16_t received() const { return _received; }
+  uint16_t chunkCount() const { return _announce.chunkCount; }
+  uint32_t version(uint8_t kind) const;
+  uint8_t lastStatus() const { return _lastStatus; }
+  const FleetReceiverStats& stats() const { return _stats; }
+
+private:
+  struct Target {
+    JournalStore* slot;
+    JournalStore* base;
+    uint32_t version;
+    CommitFn commit;
+    void* ctx;
+  };
+
+  bool wants(const FleetAnnounce& a);
+  void start(const FleetAnnounce& a, uint32_t now);
+  void finish(uint8_t status);
+  uint8_t verifyAndCommit();
+  bool applyDelta(Target& t);
+  bool writeSlot(JournalStore* slot, uint32_t addr, const uint8_t* data, size_t len);
+  uint32_t slotCrc(JournalStore* slot, uint32_t addr, uint32_t len, HmacSha256* mac = 0);
+  bool missing(uint16_t index) const;
+  bool coveredBy(const FleetNack& nack, uint16_t bits) const;
+  void sendNacks();
+  uint32_t random();
+
+  uint32_t _nodeId;
+  uint8_t _board;
+  FleetSendFn _send;
+  void* _ctx;
+  uint32_t _rng;
+  uint8_t _key[FLEET_KEY_SIZE];
+  bool _hasKey;
+  Target _targets[FLEET_KIND_COUNT];
+
+  bool _receiving;
+  FleetAnnounce _announce;
+  uint32_t _staging;        // Slot offset of the payload
+  uint8_t _have[FLEET_MAX_CHUNKS / 8];
+  uint8_t _erased[FLEET_MAX_SECTORS / 8];
+  uint16_t _received;
+  uint32_t _lastHeard;
+  bool _nackDue;
+  uint32_t _nackAt;
+  uint32_t _rejected;       // Session that failed - not retried
+  uint8_t _lastStatus;
+
+  FleetReceiverStats _stats;
+};
+
+// CRC-32 (same as zlib.crc32): start with 0, feed blocks in order
+uint32_t fleetCrc32(uint32_t crc, const void* data, size_t len);
+
+// Start the tag of an object: HMAC-SHA256 keyed with the fleet key over
+// FLEET_TAG_MAGIC, kind, board, version, imageSize (little-endian u32s
+// and bytes as listed), then the image bytes fed with mac.update().
+void fleetTagBegin(HmacSha256& mac, const uint8_t key[FLEET_KEY_SIZE], uint8_t kind, uint8_t board,
+                   uint32_t version, uint32_t imageSize);
+
+// The whole tag of an object held in memory (config blobs)
+void fleetTag(const uint8_t key[FLEET_KEY_SIZE], uint8_t kind, uint8_t board, uint32_t version,
+              const uint8_t* image, uint32_t imageSize, uint8_t tag[FLEET_TAG_SIZE]);
+
+// Exactly 2 * len hex digits (keys, tags) -> bytes
+bool fleetHexDecode(const char* hex, uint8_t* out, size_t len);
+
+const char* fleetStatusName(uint8_t status);
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * ESP Chas TV - LoRa broadcast transport
+ *
+ * Header-only so projects without a LoRa radio never compile it. The
+ * sketch still owns LoRa.begin() and the radio settings, and passes them
+ * to loraAirtimeMs() when it needs to plan around the time on air.
+ */
+
+#ifndef CHAOS_LORA_TRANSPORT_H
+#define CHAOS_LORA_TRANSPORT_H
+
+#include <LoRa.h>
+
+#include "ShowTransport.h"
+
+class LoRaTransport : public ShowTransport {
+public:
+  LoRaTransport() : _sent(0), _failed(0) {}
+
+  const char* name() const { return "LoRa"; }
+
+  bool send(const uint8_t* data, size_t len) {
+    if (!LoRa.beginPacket()) {
+      _failed++;
+      return false;
+    }
+    LoRa.write(data, len);
+    LoRa.endPacket();
+    _sent++;
+    return true;
+  }
+
+  uint32_t sent() const { return _sent; }
+  uint32_t failed() const { return _failed; }
+
+private:
+  uint32_t _sent;
+  uint32_t _failed;
+};
+
+// Time on air of one explicit-header packet with CRC (Semtech SX1276
+// datasheet, 4.1.1.7). Low data rate optimisation is assumed on whenever
+// a symbol takes longer than 16 ms, as the LoRa library sets it.
+// SF12 / 125 kHz / 4/8: a 32-byte ShowFrame takes ~2.5 s.
+inline uint32_t loraAirtimeMs(size_t len, uint8_t sf, uint32_t bandwidthHz,
+                              uint8_t codingRateDenom, uint16_t preamble) {
+  uint32_t symbolUs = (uint32_t)(((uint64_t)1000000 << sf) / bandwidthHz);
+  int32_t de = symbolUs > 16000 ? 1 : 0;
+  int32_t bits = 8 * (int32_t)len - 4 * sf + 28 + 16;
+  int32_t perBlock = 4 * (sf - 2 * de);
+  int32_t blocks = bits > 0 ? (bits + perBlock - 1) / perBlock : 0;
+  // In quarter symbols: preamble + 4.25 sync, 8 header, payload
+  uint32_t quarters = 4 * preamble + 17 + 4 * (8 + blocks * codingRateDenom);
+  return (uint32_t)(((uint64_t)quarters * symbolUs / 4 + 999) / 1000);
+}
+
+#endif
@@ -0,0 +1,231 @@
+/**
+ * ESP Chas TV - ESP-NOW mesh routing
+ */
+
+#include "MeshRouter.h"
+#include "BoardProfile.h"
+
+#include <string.h>
+
+#ifdef CHAOS_ON_ESP32
+#include <esp_random.h>
+#endif
+
+MeshRouter::MeshRouter()
+  : _nodeId(0), _send(0), _deliver(0), _ctx(0),
+    _ttl(MESH_DEFAULT_TTL), _jitterMs(MESH_JITTER_MS),
+    _suppressCount(MESH_SUPPRESS_COUNT), _seq(0), _rng(1), _seenHead(0), _pendingCount(0) {
+  memset(_seen, 0, sizeof(_seen));
+  memset(_routes, 0, sizeof(_routes));
+  memset(_pending, 0, sizeof(_pending));
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void MeshRouter::begin(uint32_t nodeId, SendFn send, DeliverFn deliver, void* ctx) {
+  _nodeId = nodeId;
+  _send = send;
+  _deliver = deliver;
+  _ctx = ctx;
+  _rng = nodeId ? nodeId : 1;
+#ifdef CHAOS_ON_ESP32
+  // After a reboot our neighbours still remember (origin, seq) pairs we
+  // sent; counting from 1 again would get up to MESH_SEEN_SIZE new cues
+  // dropped as duplicates. Start somewhere else instead.
+  _seq = (uint16_t)esp_random();
+#endif
+}
+
+bool MeshRouter::send(uint32_t dest, const uint8_t* payload, uint8_t len, uint32_t now) {
+  if (len > MESH_MAX_PAYLOAD) return false;
+
+  uint8_t frame[MESH_MAX_FRAME];
+  MeshHeader hdr;
+  hdr.origin = _nodeId;
+  hdr.dest = dest;
+  hdr.seq = ++_seq;
+  hdr.magic = MESH_MAGIC;
+  hdr.ttl = _ttl;
+  hdr.hops = 0;
+  hdr.flags = (dest == MESH_BROADCAST) ? 0 : MESH_FLAG_UNICAST;
+  hdr.len = len;
+  hdr.reserved = 0;
+  memcpy(frame, &hdr, sizeof(hdr));
+  memcpy(frame + sizeof(hdr), payload, len);
+
+  // Our own frame will echo back from neighbours - drop it then
+  remember(seenKey(_nodeId, hdr.seq));
+  _stats.originated++;
+
+  const uint8_t* nextHop = (dest == MESH_BROADCAST) ? 0 : routeTo(dest, now);
+  if (nextHop) {
+    _stats.routedUnicast++;
+    if (_send) _send(_ctx, nextHop, frame, sizeof(hdr) + len);
+  } else {
+    transmit(frame, sizeof(hdr) + len);
+  }
+  return true;
+}
+
+void MeshRouter::onFrame(const uint8_t* fromMac, const uint8_t* frame, size_t len, uint32_t now) {
+  if (len < sizeof(MeshHeader)) return;
+
+  MeshHeader hdr;
+  memcpy(&hdr, frame, sizeof(hdr));
+  if (hdr.magic != MESH_MAGIC || sizeof(hdr) + hdr.len > len) return;
+  if (hdr.origin == _nodeId) return;
+
+  learnRoute(hdr.origin, fromMac, hdr.hops + 1, now);
+
+  uint32_t key = seenKey(hdr.origin, hdr.seq);
+  if (seen(key)) {
+    _stats.duplicates++;
+    for (uint8_t i = 0; i < MESH_QUEUE_SIZE; i++) {
+      Pending& p = _pending[i];
+      if (p.used && p.key == key && ++p.heard >= _suppressCount && _suppressCount > 0) {
+        p.used = false;
+        _pendingCount--;
+        _stats.suppressed++;
+      }
+    }
+    return;
+  }
+  remember(key);
+
+  bool forMe = (hdr.dest == MESH_BROADCAST) || (hdr.dest == _nodeId);
+  if (forMe) {
+    _stats.delivered++;
+    if (_deliver) _deliver(_ctx, hdr, frame + sizeof(hdr));
+    if (hdr.dest == _nodeId) return;
+  }
+
+  if (hdr.ttl <= 1) {
+    _stats.expired++;
+    return;
+  }
+
+  uint8_t out[MESH_MAX_FRAME];
+  size_t outLen = sizeof(hdr) + hdr.len;
+  hdr.ttl--;
+  hdr.hops++;
+  memcpy(out, &hdr, sizeof(hdr));
+  memcpy(out + sizeof(hdr), frame + sizeof(hdr), hdr.len);
+
+  // Unicast along a known route goes straight out, no flooding
+  if (hdr.flags & MESH_FLAG_UNICAST) {
+    const uint8_t* nextHop = routeTo(hdr.dest, now);
+    if (nextHop) {
+      _stats.forwarded++;
+      _stats.routedUnicast++;
+      if (_send) _send(_ctx, nextHop, out, outLen);
+      return;
+    }
+  }
+
+  forward(out, outLen, key, now);
+}
+
+void MeshRouter::update(uint32_t now) {
+  if (_pendingCount == 0) return;
+
+  for (uint8_t i = 0; i < MESH_QUEUE_SIZE; i++) {
+    Pending& p = _pending[i];
+    if (p.used && (int32_t)(now - p.due) >= 0) {
+      p.used = false;
+      _pendingCount--;
+      _stats.forwarded++;
+      transmit(p.frame, p.len);
+    }
+  }
+}
+
+const uint8_t* MeshRouter::routeTo(uint32_t dest, uint32_t now) const {
+  for (uint8_t i = 0; i < MESH_ROUTE_SIZE; i++) {
+    const Route& r = _routes[i];
+    if (r.hops && r.dest == dest && now - r.updated < MESH_ROUTE_TIMEOUT_MS) {
+      return r.nextHop;
+    }
+  }
+  return 0;
+}
+
+uint8_t MeshRouter::routeHops(uint32_t dest) const {
+  for (uint8_t i = 0; i < MESH_ROUTE_SIZE; i++) {
+    if (_routes[i].hops && _routes[i].dest == dest) return _routes[i].hops;
+  }
+  return 0;
+}
+
+uint32_t MeshRouter::seenKey(uint32_t origin, uint16_t seq) {
+  uint32_t key = (origin * 0x9E3779B1UL) ^ seq;
+  return key ? key : 1;
+}
+
+bool MeshRouter::seen(uint32_t key) const {
+  for (uint8_t i = 0; i < MESH_SEEN_SIZE; i++) {
+    if (_seen[i] == key) return true;
+  }
+  return false;
+}
+
+void MeshRouter::remember(uint32_t key) {
+  _seen[_seenHead] = key;
+  _seenHead = (_seenHead + 1) % MESH_SEEN_SIZE;
+}
+
+void MeshRouter::learnRoute(uint32_t origin, const uint8_t* fromMac, uint8_t hops, uint32_t now) {
+  Route* slot = 0;
+  for (uint8_t i = 0; i < MESH_ROUTE_SIZE; i++) {
+    Route& r = _routes[i];
+    if (r.hops && r.dest == origin) {
+      bool stale = now - r.updated >= MESH_ROUTE_TIMEOUT_MS;
+      bool sameHop = memcmp(r.nextHop, fromMac, 6) == 0;
+      if (hops < r.hops || sameHop || stale) {
+        memcpy(r.nextHop, fromMac, 6);
+        r.hops = hops;
+        r.updated = now;
+      }
+      return;
+    }
+    if (!r.hops) {
+      if (!slot || slot->hops) slot = &r;
+    } else if (!slot || (slot->hops && (int32_t)(r.updated - slot->updated) < 0)) {
+      slot = &r;
+    }
+  }
+
+  slot->dest = origin;
+  memcpy(slot->nextHop, fromMac, 6);
+  slot->hops = hops;
+  slot->updated = now;
+}
+
+void MeshRouter::forward(uint8_t* frame, size_t len, uint32_t key, uint32_t now) {
+  for (uint8_t i = 0; i < MESH_QUEUE_SIZE; i++) {
+    Pending& p = _pending[i];
+    if (!p.used) {
+      p.used = true;
+      p.due = now + random32() % (_jitterMs + 1u);
+      p.heard = 0;
+      p.key = key;
+      p.len = (uint8_t)len;
+      memcpy(p.frame, frame, len);
+      _pendingCount++;
+      return;
+    }
+  }
+
+  // Queue full: better late jitter than a dropped cue
+  _stats.forwarded++;
+  transmit(frame, len);
+}
+
+void MeshRouter::transmit(const uint8_t* frame, size_t len) {
+  if (_send) _send(_ctx, 0, frame, len);
+}
+
+uint32_t MeshRouter::random32() {
+  _rng ^= _rng << 13;
+  _rng ^= _rng >> 17;
+  _rng ^= _rng << 5;
+  return _rng;
+}
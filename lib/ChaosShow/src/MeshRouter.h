@@ -0,0 +1,137 @@
+/**
+ * ESP Chas TV - ESP-NOW mesh routing
+ *
+ * Controlled flooding with:
+ * - TTL, so a frame dies after MESH_DEFAULT_TTL hops
+ * - Duplicate suppression through a rolling seen-set of (origin, seq)
+ * - Jittered rebroadcast (0..MESH_JITTER_MS) so neighbours that heard
+ *   the same frame don't all transmit at once, plus counter-based
+ *   suppression: if MESH_SUPPRESS_COUNT copies are overheard while
+ *   waiting, our rebroadcast adds nothing and is cancelled
+ * - Reverse-path route learning: every frame teaches us which neighbour
+ *   leads back to its origin. Unicast frames follow learned routes and
+ *   fall back to flooding when no route is known
+ *
+ * The router is transport-agnostic: it hands frames to a SendFn with a
+ * 6-byte link address (MAC), or NULL for broadcast. No heap is used.
+ */
+
+#ifndef CHAOS_MESH_ROUTER_H
+#define CHAOS_MESH_ROUTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MESH_MAGIC            0xC5
+#define MESH_BROADCAST        0xFFFFFFFFUL
+#define MESH_MAX_FRAME        250   // ESP-NOW payload limit
+#define MESH_DEFAULT_TTL      8
+#define MESH_SEEN_SIZE        64    // (origin, seq) pairs remembered
+#define MESH_ROUTE_SIZE       32
+#define MESH_ROUTE_TIMEOUT_MS 60000
+#define MESH_QUEUE_SIZE       8     // Frames waiting for rebroadcast
+#define MESH_JITTER_MS        20
+#define MESH_SUPPRESS_COUNT   3
+
+#define MESH_FLAG_UNICAST     0x01
+
+struct MeshHeader {
+  uint32_t origin;
+  uint32_t dest;      // MESH_BROADCAST for floods
+  uint16_t seq;
+  uint8_t magic;
+  uint8_t ttl;
+  uint8_t hops;
+  uint8_t flags;
+  uint8_t len;        // Payload bytes after the header
+  uint8_t reserved;
+};
+
+#define MESH_MAX_PAYLOAD (MESH_MAX_FRAME - sizeof(MeshHeader))
+
+struct MeshStats {
+  uint32_t originated;
+  uint32_t delivered;
+  uint32_t forwarded;     // Frames we re-transmitted
+  uint32_t duplicates;    // Dropped by the seen-set
+  uint32_t suppressed;    // Rebroadcasts cancelled by overhearing
+  uint32_t expired;       // Dropped because TTL ran out
+  uint32_t routedUnicast; // Unicasts sent along a learned route
+};
+
+class MeshRouter {
+public:
+  // mac = NULL means link-layer broadcast
+  typedef void (*SendFn)(void* ctx, const uint8_t* mac, const uint8_t* frame, size_t len);
+  typedef void (*DeliverFn)(void* ctx, const MeshHeader& hdr, const uint8_t* payload);
+
+  MeshRouter();
+
+  void begin(uint32_t nodeId, SendFn send, DeliverFn deliver, void* ctx = 0);
+  void setTtl(uint8_t ttl) { _ttl = ttl; }
+  void setJitter(uint8_t ms) { _jitterMs = ms; }
+  void setSuppressCount(uint8_t n) { _suppressCount = n; }  // 0 = never suppress
+
+  // Originate a frame. dest = MESH_BROADCAST floods the whole mesh.
+  bool send(uint32_t dest, const uint8_t* payload, uint8_t len, uint32_t now);
+
+  // Feed a frame heard from neighbour `fromMac`.
+  void onFrame(const uint8_t* fromMac, const uint8_t* frame, size_t len, uint32_t now);
+
+  // Transmit rebroadcasts whose jitter has elapsed. Call from loop().
+  void update(uint32_t now);
+  bool hasPending() const { return _pendingCount > 0; }
+
+  // Next hop towards `dest`, or NULL if no fresh route is known.
+  const uint8_t* routeTo(uint32_t dest, uint32_t now) const;
+  uint8_t routeHops(uint32_t dest) const;
+
+  uint32_t nodeId() const { return _nodeId; }
+  const MeshStats& stats() const { return _stats; }
+
+private:
+  struct Route {
+    uint32_t dest;
+    uint8_t nextHop[6];
+    uint8_t hops;
+    uint32_t updated;
+  };
+
+  struct Pending {
+    bool used;
+    uint32_t due;
+    uint8_t heard;        // Copies overheard while waiting
+    uint32_t key;
+    uint8_t len;
+    uint8_t frame[MESH_MAX_FRAME];
+  };
+
+  static uint32_t seenKey(uint32_t origin, uint16_t seq);
+  bool seen(uint32_t key) const;
+  void remember(uint32_t key);
+  void learnRoute(uint32_t origin, const uint8_t* fromMac, uint8_t hops, uint32_t now);
+  void forward(uint8_t* frame, size_t len, uint32_t key, uint32_t now);
+  void transmit(const uint8_t* frame, size_t len);
+  uint32_t random32();
+
+  uint32_t _nodeId;
+  SendFn _send;
+  DeliverFn _deliver;
+  void* _ctx;
+  uint8_t _ttl;
+  uint8_t _jitterMs;
+  uint8_t _suppressCount;
+  uint16_t _seq;
+  uint32_t _rng;
+
+  uint32_t _seen[MESH_SEEN_SIZE];
+  uint8_t _seenHead;
+
+  Route _routes[MESH_ROUTE_SIZE];
+  Pending _pending[MESH_QUEUE_SIZE];
+  uint8_t _pendingCount;
+
+  MeshStats _stats;
+};
+
+#endif
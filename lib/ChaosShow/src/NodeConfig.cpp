@@ -0,0 +1,100 @@
+/**
+ * ESP Chas TV - Runtime node role and configuration
+ */
+
+#include "NodeConfig.h"
+
+#include <string.h>
+#include <strings.h>
+
+// ---------------------------------------------------------------------------
+// NodeConfigStore
+// ---------------------------------------------------------------------------
+
+NodeConfigStore::NodeConfigStore() : _journalOk(false), _loaded(false) {
+  memset(&_config, 0, sizeof(_config));
+  _config.format = NODE_CONFIG_FORMAT;
+}
+
+bool NodeConfigStore::begin(JournalStore* store, uint8_t defaultRole) {
+  memset(&_config, 0, sizeof(_config));
+  _config.format = NODE_CONFIG_FORMAT;
+  _config.role = defaultRole;
+
+  _journalOk = store && _journal.mount(store);
+  if (!_journalOk) return false;
+
+  NodeConfig saved;
+  _loaded = _journal.load(&saved, sizeof(saved)) &&
+            saved.format == NODE_CONFIG_FORMAT && saved.role < ROLE_COUNT;
+  if (_loaded) _config = saved;
+  return true;
+}
+
+bool NodeConfigStore::save() {
+  return _journalOk && _journal.save(&_config, sizeof(_config));
+}
+
+bool NodeConfigStore::setRole(uint8_t role) {
+  if (role >= ROLE_COUNT) return false;
+  _config.role = role;
+  _config.configVersion = 0;
+  return save();
+}
+
+bool NodeConfigStore::apply(const FleetConfigEntry& entry, uint32_t configVersion) {
+  if (entry.role >= ROLE_COUNT) return false;
+  _config.role = entry.role;
+  _config.configVersion = configVersion;
+  return save();
+}
+
+// ---------------------------------------------------------------------------
+// Fleet config blobs
+// ---------------------------------------------------------------------------
+
+bool fleetConfigFind(const uint8_t* blob, size_t len, uint32_t node, FleetConfigEntry& entry) {
+  FleetConfigHeader h;
+  if (len < sizeof(h)) return false;
+  memcpy(&h, blob, sizeof(h));
+  if (h.magic != FLEET_CONFIG_MAGIC || len < sizeof(h) + (size_t)h.count * sizeof(entry)) return false;
+
+  bool found = false;
+  for (uint8_t i = 0; i < h.count; i++) {
+    FleetConfigEntry e;
+    memcpy(&e, blob + sizeof(h) + (size_t)i * sizeof(e), sizeof(e));
+    if (e.node == node) {
+      entry = e;
+      return true;
+    }
+    if (e.node == 0) {
+      entry = e;
+      found = true;
+    }
+  }
+  return found;
+}
+
+size_t fleetConfigBuild(const FleetConfigEntry* entries, uint8_t count, uint8_t* blob, size_t size) {
+  FleetConfigHeader h = { FLEET_CONFIG_MAGIC, count, 0 };
+  size_t len = sizeof(h) + (size_t)count * sizeof(FleetConfigEntry);
+  if (len > size) return 0;
+  memcpy(blob, &h, sizeof(h));
+  memcpy(blob + sizeof(h), entries, (size_t)count * sizeof(FleetConfigEntry));
+  return len;
+}
+
+const char* nodeRoleName(uint8_t role) {
+  switch (role) {
+    case ROLE_RECEIVER: return "receiver";
+    case ROLE_MASTER:   return "master";
+    default:            return "?";
+  }
+}
+
+uint8_t nodeRoleFromName(const char* name) {
+  if (!name) return ROLE_COUNT;
+  if (strcasecmp(name, "master") == 0 || strcasecmp(name, "transmitter") == 0) return ROLE_MASTER;
+  if (strcasecmp(name, "receiver") == 0 || strcasecmp(name, "slave") == 0) return ROLE_RECEIVER;
+  return ROLE_COUNT;
+}
@@ -0,0 +1,106 @@
+/**
+ * ESP Chas TV - Runtime node role and configuration
+ *
+ * One firmware image for every board: whether a board is the master
+ * (transmitter) or a receiver is a setting saved in flash, not a
+ * compile-time define. It is changed from the serial console, or for
+ * the whole fleet at once with a config blob sent over the air (see
+ * FleetUpdate.h).
+ *
+ * A fleet config blob is a small table:
+ *
+ *   blob:   magic, count, reserved[2], entry[count]
+ *   entry:  node, role, reserved, device, groups       (12 bytes)
+ *
+ * A board uses the entry with its node ID, or the node 0 entry if it has
+ * none. groups / device of 0 leave the board's addressing as it is.
+ *
+ * The saved config lives in a StateJournal on the "nodecfg" partition,
+ * so it survives power-off and every change is one appended record.
+ */
+
+#ifndef CHAOS_NODE_CONFIG_H
+#define CHAOS_NODE_CONFIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "StateJournal.h"
+
+#define NODE_CONFIG_PARTITION   "nodecfg"
+#define NODE_CONFIG_FORMAT      1
+#define FLEET_CONFIG_MAGIC      0xC7
+#define FLEET_CONFIG_MAX        1024   // Largest blob, bytes (84 entries)
+
+enum NodeRole {
+  ROLE_RECEIVER,   // Executes cues (ESP-NOW slave, LoRa receiver)
+  ROLE_MASTER,     // Sends cues (ESP-NOW master, LoRa transmitter)
+  ROLE_COUNT
+};
+
+struct NodeConfig {
+  uint8_t format;          // NODE_CONFIG_FORMAT
+  uint8_t role;            // NodeRole
+  uint16_t reserved;
+  uint32_t configVersion;  // Fleet config it came from, 0 = set locally
+};
+
+// Wire format - little-endian, no padding
+struct FleetConfigEntry {
+  uint32_t node;           // 0 = every board without its own entry
+  uint8_t role;
+  uint8_t reserved;
+  uint16_t device;         // 0 = keep
+  uint32_t groups;         // 0 = keep
+};
+
+struct FleetConfigHeader {
+  uint8_t magic;           // FLEET_CONFIG_MAGIC
+  uint8_t count;
+  uint16_t reserved;
+};
+
+static_assert(sizeof(FleetConfigEntry) == 12, "FleetConfigEntry must stay 12 bytes on the wire");
+static_assert(sizeof(NodeConfig) <= JOURNAL_MAX_DATA, "config must fit one journal record");
+
+class NodeConfigStore {
+public:
+  NodeConfigStore();
+
+  // Mount `store` (the "nodecfg" partition) and load the saved config.
+  // Without it the defaults are used and nothing is saved.
+  bool begin(JournalStore* store, uint8_t defaultRole = ROLE_RECEIVER);
+
+  const NodeConfig& config() const { return _config; }
+  uint8_t role() const { return _config.role; }
+  bool isMaster() const { return _config.role == ROLE_MASTER; }
+
+  // Change and save. Returns false if it couldn't be saved (the new
+  // value is still used until the next reboot).
+  bool setRole(uint8_t role);
+  bool apply(const FleetConfigEntry& entry, uint32_t configVersion);
+
+  bool loaded() const { return _loaded; }
+
+private:
+  bool save();
+
+  StateJournal _journal;
+  bool _journalOk;
+  bool _loaded;
+  NodeConfig _config;
+};
+
+// Find the entry for `node` in a fleet config blob (its own, else node 0).
+// Returns false if the blob is malformed or has neither.
+bool fleetConfigFind(const uint8_t* blob, size_t len, uint32_t node, FleetConfigEntry& entry);
+
+// Build a blob from `entries`. Returns its length, 0 if it doesn't fit.
+size_t fleetConfigBuild(const FleetConfigEntry* entries, uint8_t count, uint8_t* blob, size_t size);
+
+// "master" / "receiver" (also "transmitter", "slave") <-> NodeRole.
+// Unknown names give ROLE_COUNT.
+const char* nodeRoleName(uint8_t role);
+uint8_t nodeRoleFromName(const char* name);
+
+#endif
@@ -0,0 +1,36 @@
+/**
+ * ESP Chas TV - Flash partition as a JournalStore
+ */
+
+#include "PartitionStore.h"
+
+bool PartitionStore::begin(const char* label, uint16_t maxSectors) {
+  _part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  _maxSectors = maxSectors;
+  return _part != 0;
+}
+
+bool PartitionStore::begin(const esp_partition_t* part, uint16_t maxSectors) {
+  _part = part;
+  _maxSectors = maxSectors;
+  return _part != 0;
+}
+
+uint16_t PartitionStore::sectorCount() const {
+  if (!_part) return 0;
+  uint32_t n = _part->size / FLASH_SECTOR_SIZE;
+  return (uint16_t)(n > _maxSectors ? _maxSectors : n);
+}
+
+bool PartitionStore::read(uint32_t addr, void* buf, size_t len) {
+  return esp_partition_read(_part, addr, buf, len) == ESP_OK;
+}
+
+bool PartitionStore::write(uint32_t addr, const void* buf, size_t len) {
+  return esp_partition_write(_part, addr, buf, len) == ESP_OK;
+}
+
+bool PartitionStore::erase(uint16_t sector) {
+  return esp_partition_erase_range(_part, (uint32_t)sector * FLASH_SECTOR_SIZE,
+                                   FLASH_SECTOR_SIZE) == ESP_OK;
+}
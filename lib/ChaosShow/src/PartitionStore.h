@@ -0,0 +1,41 @@
+/**
+ * ESP Chas TV - Flash partition as a JournalStore
+ *
+ * Gives the flash logs (StateJournal, CommandLog) and fleet updates a
+ * partition from partitions.csv to work on. ESP32 only; the host
+ * benchmarks use RAM models of the same interface.
+ */
+
+#ifndef CHAOS_PARTITION_STORE_H
+#define CHAOS_PARTITION_STORE_H
+
+#include <esp_partition.h>
+
+#include "StateJournal.h"
+
+#define FLASH_SECTOR_SIZE 4096   // Erase unit on every ESP32 variant
+
+class PartitionStore : public JournalStore {
+public:
+  PartitionStore() : _part(0), _maxSectors(0) {}
+
+  // Find data partition `label`. Only the first `maxSectors` sectors are
+  // offered to the log on top.
+  bool begin(const char* label, uint16_t maxSectors = JOURNAL_MAX_SECTORS);
+
+  // Any partition, e.g. an OTA app slot from esp_ota_get_next_update_partition()
+  bool begin(const esp_partition_t* part, uint16_t maxSectors = JOURNAL_MAX_SECTORS);
+
+  uint32_t sectorSize() const { return FLASH_SECTOR_SIZE; }
+  uint16_t sectorCount() const;
+
+  bool read(uint32_t addr, void* buf, size_t len);
+  bool write(uint32_t addr, const void* buf, size_t len);
+  bool erase(uint16_t sector);
+
+private:
+  const esp_partition_t* _part;
+  uint16_t _maxSectors;
+};
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * ESP Chas TV - Per-peer link quality table and RTT probing
+ */
+
+#include "PeerTable.h"
+
+#include <string.h>
+
+// value += (sample - value) / 8
+static inline void ewma(int32_t& value, int32_t sampleFx) {
+  value += (sampleFx - value) / 8;
+}
+
+// ---------------------------------------------------------------------------
+// PeerTable
+// ---------------------------------------------------------------------------
+
+PeerTable::PeerTable() : _joins(0), _count(0) {
+  memset(_peers, 0, sizeof(_peers));
+  memset(_joinedAt, 0, sizeof(_joinedAt));
+}
+
+PeerStats* PeerTable::find(uint32_t id) {
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_peers[i].id == id) return &_peers[i];
+  }
+  return 0;
+}
+
+PeerStats* PeerTable::touch(uint32_t id, uint32_t now) {
+  PeerStats* p = find(id);
+  if (!p) {
+    if (_count < PEER_TABLE_SIZE) {
+      p = &_peers[_count++];
+    } else {
+      p = &_peers[0];
+      for (uint8_t i = 1; i < _count; i++) {
+        if ((int32_t)(_peers[i].lastSeen - p->lastSeen) < 0) p = &_peers[i];
+      }
+    }
+    memset(p, 0, sizeof(*p));
+    p->id = id;
+    _joinedAt[p - _peers] = ++_joins;
+  }
+  p->lastSeen = now;
+  return p;
+}
+
+void PeerTable::onPacket(uint32_t id, int rssi, float snr, uint32_t now) {
+  PeerStats* p = touch(id, now);
+  int32_t rssiFx = (int32_t)rssi << PEER_FIXED_SHIFT;
+  int32_t snrFx = (int32_t)(snr * (1 << PEER_FIXED_SHIFT));
+
+  if (p->packets == 0) {
+    p->rssiFx = rssiFx;
+    p->snrFx = snrFx;
+  } else {
+    ewma(p->rssiFx, rssiFx);
+    ewma(p->snrFx, snrFx);
+  }
+  if (p->packets < 0xFFFF) p->packets++;
+}
+
+void PeerTable::onRtt(uint32_t id, uint32_t rttMs) {
+  PeerStats* p = find(id);
+  if (!p) return;
+
+  int32_t rttFx = (int32_t)rttMs << PEER_FIXED_SHIFT;
+  if (p->rttFx == 0) {
+    p->rttFx = rttFx;
+  } else {
+    ewma(p->rttFx, rttFx);
+  }
+}
+
+void PeerTable::onProbeResult(PeerStats& peer, bool answered) {
+  int32_t sampleFx = answered ? 0 : (100 << PEER_FIXED_SHIFT);
+  ewma(peer.lossFx, sampleFx);
+  if (answered) {
+    if (peer.probesAnswered < 0xFFFF) peer.probesAnswered++;
+  } else {
+    if (peer.probesMissed < 0xFFFF) peer.probesMissed++;
+  }
+}
+
+int PeerTable::indexOf(const PeerStats* peer) const {
+  if (peer < _peers || peer >= _peers + _count) return -1;
+  return (int)(peer - _peers);
+}
+
+// ---------------------------------------------------------------------------
+// LinkProbe
+// ---------------------------------------------------------------------------
+
+LinkProbe::LinkProbe(PeerTable& table)
+    : _table(table), _joinsSeen(0), _nextSeq(1), _timeoutMs(PROBE_TIMEOUT_MS) {
+  memset(_probes, 0, sizeof(_probes));
+}
+
+uint16_t LinkProbe::startProbe(uint32_t now) {
+  syncSlots();
+
+  Probe* slot = 0;
+  for (uint8_t i = 0; i < PROBE_SLOTS; i++) {
+    if (!_probes[i].active) {
+      slot = &_probes[i];
+      break;
+    }
+    if (!slot || (int32_t)(_probes[i].sentAt - slot->sentAt) < 0) slot = &_probes[i];
+  }
+  if (slot->active) finish(*slot);
+
+  slot->active = true;
+  slot->seq = _nextSeq++;
+  if (_nextSeq == 0) _nextSeq = 1;
+  slot->sentAt = now;
+  slot->answered = 0;
+  slot->expected = 0;
+  for (uint8_t i = 0; i < _table.size(); i++) slot->expected |= 1UL << i;
+  return slot->seq;
+}
+
+int32_t LinkProbe::onReply(uint32_t peerId, uint16_t seq, uint32_t holdMs, uint32_t now) {
+  for (uint8_t i = 0; i < PROBE_SLOTS; i++) {
+    Probe& p = _probes[i];
+    if (!p.active || p.seq != seq) continue;
+
+    PeerStats* peer = _table.find(peerId);
+    if (!peer) peer = _table.touch(peerId, now);
+    syncSlots();
+    uint32_t bit = 1UL << _table.indexOf(peer);
+    if (p.answered & bit) return -1;  // duplicate reply
+    p.answered |= bit;
+
+    uint32_t elapsed = now - p.sentAt;
+    uint32_t rtt = elapsed > holdMs ? elapsed - holdMs : 0;
+    _table.onRtt(peerId, rtt);
+    _table.onProbeResult(*peer, true);
+    return (int32_t)rtt;
+  }
+  return -1;
+}
+
+void LinkProbe::update(uint32_t now) {
+  syncSlots();
+  for (uint8_t i = 0; i < PROBE_SLOTS; i++) {
+    if (_probes[i].active && now - _probes[i].sentAt > _timeoutMs) {
+      finish(_probes[i]);
+    }
+  }
+}
+
+uint16_t LinkProbe::outstanding() const {
+  uint16_t n = 0;
+  for (uint8_t i = 0; i < PROBE_SLOTS; i++) {
+    if (_probes[i].active) n++;
+  }
+  return n;
+}
+
+void LinkProbe::finish(Probe& p) {
+  uint32_t missed = p.expected & ~p.answered;
+  for (uint8_t i = 0; i < _table.size(); i++) {
+    if (missed & (1UL << i)) {
+      _table.onProbeResult(_table.at(i), false);
+    }
+  }
+  p.active = false;
+}
+
+// A slot handed to a new peer since the last call loses the old peer's
+// bits in every outstanding probe - the newcomer wasn't asked to answer
+// them, and its own reply mustn't look like a duplicate
+void LinkProbe::syncSlots() {
+  if (_table.joins() == _joinsSeen) return;
+
+  uint32_t reused = 0;
+  for (uint8_t i = 0; i < _table.size(); i++) {
+    if ((int32_t)(_table.joinedAt(i) - _joinsSeen) > 0) reused |= 1UL << i;
+  }
+  for (uint8_t i = 0; i < PROBE_SLOTS; i++) {
+    _probes[i].expected &= ~reused;
+    _probes[i].answered &= ~reused;
+  }
+  _joinsSeen = _table.joins();
+}
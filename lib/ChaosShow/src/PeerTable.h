@@ -0,0 +1,122 @@
+/**
+ * ESP Chas TV - Per-peer link quality table and RTT probing
+ *
+ * PeerTable keeps a fixed number of peers (no heap) with exponentially
+ * weighted moving averages (EWMA, alpha = 1/8) of RSSI, SNR, round-trip
+ * time and loss. When the table is full the peer heard from least
+ * recently is replaced.
+ *
+ * LinkProbe runs non-blocking round-trip probes on top of it: call
+ * startProbe() to get a sequence number to put on air, onReply() when a
+ * peer echoes it, and update() from loop() to time out unanswered probes.
+ *
+ * All times are milliseconds supplied by the caller (millis()), so the
+ * code runs the same on the host.
+ */
+
+#ifndef CHAOS_PEER_TABLE_H
+#define CHAOS_PEER_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PEER_TABLE_SIZE    16
+#define PROBE_SLOTS        8
+#define PROBE_TIMEOUT_MS   10000   // Default; slow links set their own
+
+// Fixed-point scale for EWMA values (1/16 units)
+#define PEER_FIXED_SHIFT   4
+
+struct PeerStats {
+  uint32_t id;
+  uint32_t lastSeen;     // millis() of last packet
+  int32_t rssiFx;        // dBm << PEER_FIXED_SHIFT
+  int32_t snrFx;         // dB << PEER_FIXED_SHIFT
+  int32_t rttFx;         // ms << PEER_FIXED_SHIFT, 0 = never measured
+  int32_t lossFx;        // percent << PEER_FIXED_SHIFT
+  uint16_t packets;
+  uint16_t probesAnswered;
+  uint16_t probesMissed;
+
+  int rssi() const { return rssiFx >> PEER_FIXED_SHIFT; }
+  float snr() const { return snrFx / (float)(1 << PEER_FIXED_SHIFT); }
+  uint32_t rttMs() const { return rttFx >> PEER_FIXED_SHIFT; }
+  uint8_t lossPercent() const { return (uint8_t)(lossFx >> PEER_FIXED_SHIFT); }
+};
+
+class PeerTable {
+public:
+  PeerTable();
+
+  // Find a peer, or NULL if unknown
+  PeerStats* find(uint32_t id);
+
+  // Find or add a peer (evicts the stalest entry when full)
+  PeerStats* touch(uint32_t id, uint32_t now);
+
+  // Record signal quality of a packet heard from `id`
+  void onPacket(uint32_t id, int rssi, float snr, uint32_t now);
+
+  void onRtt(uint32_t id, uint32_t rttMs);
+  void onProbeResult(PeerStats& peer, bool answered);
+
+  uint8_t size() const { return _count; }
+  const PeerStats& at(uint8_t i) const { return _peers[i]; }
+  PeerStats& at(uint8_t i) { return _peers[i]; }
+  int indexOf(const PeerStats* peer) const;
+
+  // Peers added so far; joinedAt(i) is the count when slot i got its
+  // current peer, so a reused slot can be told from the old peer
+  uint32_t joins() const { return _joins; }
+  uint32_t joinedAt(uint8_t i) const { return _joinedAt[i]; }
+
+private:
+  PeerStats _peers[PEER_TABLE_SIZE];
+  uint32_t _joinedAt[PEER_TABLE_SIZE];
+  uint32_t _joins;
+  uint8_t _count;
+};
+
+class LinkProbe {
+public:
+  explicit LinkProbe(PeerTable& table);
+
+  // Reserve a probe slot. Returns the sequence number to send.
+  uint16_t startProbe(uint32_t now);
+
+  // A peer echoed `seq`. holdMs is how long the peer waited before
+  // replying (reply jitter), which is taken out of the RTT.
+  // Returns the measured RTT, or -1 if the probe is unknown/expired.
+  int32_t onReply(uint32_t peerId, uint16_t seq, uint32_t holdMs, uint32_t now);
+
+  // How long to wait for replies. Must cover the probe's own airtime and
+  // every reply slot, or the last slots count as loss.
+  void setTimeout(uint32_t ms) { _timeoutMs = ms; }
+  uint32_t timeout() const { return _timeoutMs; }
+
+  // Expire probes older than the timeout and charge loss to every peer
+  // that was expected to answer but didn't.
+  void update(uint32_t now);
+
+  uint16_t outstanding() const;
+
+private:
+  struct Probe {
+    bool active;
+    uint16_t seq;
+    uint32_t sentAt;
+    uint32_t expected;   // bit per table index
+    uint32_t answered;
+  };
+
+  void finish(Probe& p);
+  void syncSlots();
+
+  PeerTable& _table;
+  Probe _probes[PROBE_SLOTS];
+  uint32_t _joinsSeen;   // _table.joins() at the last syncSlots()
+  uint16_t _nextSeq;
+  uint32_t _timeoutMs;
+};
+
+#endif
@@ -0,0 +1,142 @@
+/**
+ * ESP Chas TV - Non-blocking serial command console
+ */
+
+#include "SerialConsole.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static char lower(char c) {
+  return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+static bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// "-12", "7" - an argument glued to a command name
+static bool isNumber(const char* s) {
+  if (*s == '-') s++;
+  if (!isDigit(*s)) return false;
+  while (isDigit(*s)) s++;
+  return *s == '\0';
+}
+
+SerialConsole::SerialConsole()
+  : _table(0), _count(0), _ctx(0), _unknown(0), _len(0), _overflow(false) {
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void SerialConsole::begin(const ConsoleCommand* table, uint8_t count, void* ctx,
+                          ConsoleHandler unknown) {
+  _table = table;
+  _count = count;
+  _ctx = ctx;
+  _unknown = unknown;
+}
+
+void SerialConsole::push(char c) {
+  if (c == '\n' || c == '\r') {
+    endLine();
+  } else if (_len < CONSOLE_LINE_MAX) {
+    _line[_len++] = c;
+  } else {
+    _overflow = true;
+  }
+}
+
+void SerialConsole::push(const char* data, size_t len) {
+  for (size_t i = 0; i < len; i++) push(data[i]);
+}
+
+// ---------------------------------------------------------------------------
+// Line handling
+// ---------------------------------------------------------------------------
+
+void SerialConsole::endLine() {
+  uint8_t len = _len;
+  bool overflow = _overflow;
+  _len = 0;
+  _overflow = false;
+
+  if (overflow) {
+    _stats.overflows++;
+    return;
+  }
+
+  // Tokenize in place: separators become terminators
+  _line[len] = '\0';
+  char* argv[CONSOLE_MAX_ARGS + 1] = { 0 };
+  uint8_t argc = 0;
+  char* p = _line;
+
+  while (*p && argc < CONSOLE_MAX_ARGS) {
+    while (*p == ' ' || *p == '\t') p++;
+    if (!*p) break;
+    argv[argc++] = p;
+    while (*p && *p != ' ' && *p != '\t') p++;
+    if (*p) *p++ = '\0';
+  }
+
+  if (argc == 0) return;   // Blank line (or the '\n' of a "\r\n")
+  dispatch(argc, argv);
+}
+
+const ConsoleCommand* SerialConsole::match(const char* token, const char** suffix) const {
+  *suffix = 0;
+
+  // Exact name first, so "on" never matches as a prefix of something else
+  for (uint8_t i = 0; i < _count; i++) {
+    const char* n = _table[i].name;
+    const char* t = token;
+    while (*n && lower(*t) == *n) { n++; t++; }
+    if (*n == '\0' && *t == '\0') return &_table[i];
+  }
+
+  // Then "scene2" style: name followed directly by a number
+  for (uint8_t i = 0; i < _count; i++) {
+    const char* n = _table[i].name;
+    const char* t = token;
+    while (*n && lower(*t) == *n) { n++; t++; }
+    if (*n == '\0' && isNumber(t)) {
+      *suffix = t;
+      return &_table[i];
+    }
+  }
+
+  return 0;
+}
+
+bool SerialConsole::dispatch(uint8_t argc, char* argv[]) {
+  if (argc == 0) return false;
+
+  const char* suffix;
+  const ConsoleCommand* cmd = match(argv[0], &suffix);
+
+  if (!cmd) {
+    _stats.unknown++;
+    if (_unknown) _unknown(argc, argv, _ctx);
+    return false;
+  }
+
+  _stats.lines++;
+
+  // Copy into a NULL-padded vector. A number glued to the name becomes
+  // its own argument; argv[0] keeps the token as typed ("scene2").
+  char* args[CONSOLE_MAX_ARGS + 1] = { 0 };
+  uint8_t n = 0;
+  args[n++] = argv[0];
+  if (suffix) args[n++] = (char*)suffix;
+  for (uint8_t i = 1; i < argc && n < CONSOLE_MAX_ARGS; i++) args[n++] = argv[i];
+
+  cmd->handler(n, args, _ctx);
+  return true;
+}
+
+int32_t consoleInt(const char* arg, int32_t fallback) {
+  if (!arg || !*arg) return fallback;
+  char* end;
+  long v = strtol(arg, &end, 10);
+  return *end == '\0' ? (int32_t)v : fallback;
+}
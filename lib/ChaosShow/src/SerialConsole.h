@@ -0,0 +1,84 @@
+/**
+ * ESP Chas TV - Non-blocking serial command console
+ *
+ * Feed it whatever bytes Serial has buffered; it never waits for the rest
+ * of a line and never allocates. Completed lines are split into tokens
+ * in place (the separators become '\0') and dispatched through a table
+ * of { name, handler } entries:
+ *
+ *   "scene 2"  -> scene handler, argv = { "scene", "2" }
+ *   "scene2"   -> scene handler, argv = { "scene2", "2" } (a number glued
+ *                 to a command name is split off as argv[1])
+ *   "fec 4 2"  -> fec handler,   argv = { "fec", "4", "2" }
+ *
+ * Names match case-insensitively (write them lower case in the table);
+ * arguments are passed through as typed.
+ * Lines longer than CONSOLE_LINE_MAX are dropped whole, never truncated
+ * into a different command.
+ */
+
+#ifndef CHAOS_SERIAL_CONSOLE_H
+#define CHAOS_SERIAL_CONSOLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CONSOLE_LINE_MAX  96   // Longest accepted line, without newline
+#define CONSOLE_MAX_ARGS  8    // Tokens per line, command name included
+
+// Like main(), but every slot from argv[argc] up to argv[CONSOLE_MAX_ARGS]
+// is NULL, so optional arguments can be read as consoleInt(argv[2], fallback)
+// without checking argc first
+typedef void (*ConsoleHandler)(uint8_t argc, char* argv[], void* ctx);
+
+struct ConsoleCommand {
+  const char* name;
+  ConsoleHandler handler;
+};
+
+struct ConsoleStats {
+  uint32_t lines;      // Lines dispatched to a handler
+  uint32_t unknown;    // Lines with no matching command
+  uint32_t overflows;  // Lines dropped for being too long
+};
+
+class SerialConsole {
+public:
+  SerialConsole();
+
+  // `table` must outlive the console (normally a static const array).
+  // `unknown` gets the tokenized line when no entry matches.
+  void begin(const ConsoleCommand* table, uint8_t count, void* ctx = 0,
+             ConsoleHandler unknown = 0);
+
+  // Consume one byte; a '\n' or '\r' completes the line and dispatches it
+  void push(char c);
+
+  // Consume a block of bytes
+  void push(const char* data, size_t len);
+
+  // Dispatch already tokenized arguments - lets a handler run the rest
+  // of its line as another command (e.g. "to <node> scene 2")
+  bool dispatch(uint8_t argc, char* argv[]);
+
+  const ConsoleStats& stats() const { return _stats; }
+
+private:
+  void endLine();
+  const ConsoleCommand* match(const char* token, const char** suffix) const;
+
+  const ConsoleCommand* _table;
+  uint8_t _count;
+  void* _ctx;
+  ConsoleHandler _unknown;
+
+  char _line[CONSOLE_LINE_MAX + 1];
+  uint8_t _len;
+  bool _overflow;
+  ConsoleStats _stats;
+};
+
+// Parse a decimal argument; `fallback` if missing or not a number
+int32_t consoleInt(const char* arg, int32_t fallback = 0);
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * ESP Chas TV - SHA-256 and HMAC-SHA256
+ *
+ * Plain C++ so the same code runs on every chip and in the host
+ * benchmarks. Used to authenticate fleet updates (FleetUpdate.h): a
+ * board only boots an image whose HMAC under the provisioned fleet key
+ * checks out. Streaming - feed the data in any number of pieces.
+ *
+ * Usage:
+ *   HmacSha256 mac;
+ *   mac.begin(key, FLEET_KEY_SIZE);
+ *   mac.update(buf, len);   // ...as often as needed
+ *   uint8_t tag[SHA256_SIZE];
+ *   mac.finish(tag);
+ */
+
+#ifndef CHAOS_SHA256_H
+#define CHAOS_SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA256_SIZE        32
+#define SHA256_BLOCK_SIZE  64
+
+class Sha256 {
+public:
+  Sha256() { begin(); }
+
+  void begin();
+  void update(const void* data, size_t len);
+  void finish(uint8_t digest[SHA256_SIZE]);
+
+private:
+  void block(const uint8_t* p);
+
+  uint32_t _h[8];
+  uint8_t _buf[SHA256_BLOCK_SIZE];
+  uint64_t _bytes;
+};
+
+class HmacSha256 {
+public:
+  // Keys longer than a block are hashed first, as RFC 2104 says
+  void begin(const uint8_t* key, size_t len);
+  void update(const void* data, size_t len) { _inner.update(data, len); }
+  void finish(uint8_t tag[SHA256_SIZE]);
+
+private:
+  Sha256 _inner;
+  uint8_t _outerPad[SHA256_BLOCK_SIZE];
+};
+
+// Compare two tags without leaking where they differ
+bool sha256Equal(const uint8_t a[SHA256_SIZE], const uint8_t b[SHA256_SIZE]);
+
+#endif
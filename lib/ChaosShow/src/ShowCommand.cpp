@@ -0,0 +1,95 @@
+/**
+ * ESP Chas TV - Shared show command model
+ */
+
+#include "ShowCommand.h"
+
+#include <string.h>
+
+static const char* const commandNames[CMD_COUNT] = {
+  "NONE",
+  "LED_ON",
+  "LED_OFF",
+  "LED_TOGGLE",
+  "PATTERN",
+  "SHOW_START",
+  "SHOW_STOP",
+  "SCENE",
+  "PING",
+  "PONG",
+  "SET_GROUPS",
+  "SET_DEVICE",
+  "POLL_OPEN",
+  "VOTE"
+};
+
+const char* showCommandName(uint8_t id) {
+  return id < CMD_COUNT ? commandNames[id] : "NONE";
+}
+
+uint8_t showCommandFromName(const char* name) {
+  for (uint8_t id = 1; id < CMD_COUNT; id++) {
+    if (strcmp(name, commandNames[id]) == 0) return id;
+  }
+  return CMD_NONE;
+}
+
+void showFrameEncode(ShowFrame& frame, const ShowCommand& cmd,
+                     uint32_t sender, uint32_t seq, uint32_t timestamp) {
+  frame.magic = SHOW_FRAME_MAGIC;
+  frame.version = SHOW_FRAME_VERSION;
+  frame.command = cmd.id;
+  frame.flags = 0;
+  frame.groups = 0;
+  frame.rangeLo = 0;
+  frame.rangeHi = 0;
+  frame.seq = seq;
+  frame.value1 = cmd.value1;
+  frame.value2 = cmd.value2;
+  frame.sender = sender;
+  frame.timestamp = timestamp;
+}
+
+void showFrameSetGroups(ShowFrame& frame, uint32_t mask) {
+  frame.flags |= FRAME_FLAG_GROUPS;
+  frame.groups = mask;
+}
+
+void showFrameSetRange(ShowFrame& frame, uint16_t lo, uint16_t hi) {
+  frame.flags |= FRAME_FLAG_RANGE;
+  frame.rangeLo = lo;
+  frame.rangeHi = hi;
+}
+
+uint32_t showGroupMask(const char* list) {
+  uint32_t mask = 0;
+  const char* p = list;
+  if (!p) return 0;
+
+  while (*p) {
+    if (*p < '0' || *p > '9') return 0;
+    unsigned n = 0;
+    while (*p >= '0' && *p <= '9') n = n * 10 + (unsigned)(*p++ - '0');
+    if (n >= SHOW_GROUP_COUNT) return 0;
+    mask |= 1UL << n;
+    if (*p == ',') p++;
+    else if (*p) return 0;
+  }
+  return mask;
+}
+
+bool showFrameDecode(const uint8_t* data, size_t len, ShowFrame& frame) {
+  if (len < sizeof(ShowFrame)) return false;
+  if (data[0] != SHOW_FRAME_MAGIC || data[1] != SHOW_FRAME_VERSION) return false;
+
+  memcpy(&frame, data, sizeof(frame));
+  return frame.command > CMD_NONE && frame.command < CMD_COUNT;
+}
+
+ShowCommand showFrameCommand(const ShowFrame& frame) {
+  ShowCommand cmd;
+  cmd.id = frame.command;
+  cmd.value1 = frame.value1;
+  cmd.value2 = frame.value2;
+  return cmd;
+}
@@ -0,0 +1,122 @@
+/**
+ * ESP Chas TV - Shared show command model
+ *
+ * One vocabulary (SHOW_START, SCENE, LED_ON, ...) and one wire frame for
+ * every transport. The web UI, ESP-NOW, the mesh and LoRa all carry the
+ * same 32-byte ShowFrame, so a gateway can pass the bytes it received on
+ * one radio straight to another without decoding or re-encoding them.
+ *
+ * Addressing: a frame can be limited to a set of groups (zones, bit n =
+ * group n) and/or a range of device numbers. Both live in the first 12
+ * bytes so receivers can drop frames that aren't theirs with
+ * showFrameForMe() before copying or decoding anything.
+ */
+
+#ifndef CHAOS_SHOW_COMMAND_H
+#define CHAOS_SHOW_COMMAND_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHOW_FRAME_MAGIC    0xCE
+#define SHOW_FRAME_VERSION  2
+
+// ShowFrame.flags
+#define FRAME_FLAG_GROUPS   0x01   // Only nodes in one of `groups`
+#define FRAME_FLAG_RANGE    0x02   // Only devices rangeLo..rangeHi
+
+#define SHOW_GROUP_COUNT    32
+
+enum CommandId {
+  CMD_NONE = 0,
+  CMD_LED_ON,
+  CMD_LED_OFF,
+  CMD_LED_TOGGLE,
+  CMD_PATTERN,
+  CMD_SHOW_START,
+  CMD_SHOW_STOP,
+  CMD_SCENE,
+  CMD_PING,
+  CMD_PONG,
+  CMD_SET_GROUPS,     // value1 = target node ID (0 = every addressed node), value2 = group mask
+  CMD_SET_DEVICE,     // value1 = target node ID (0 = every addressed node), value2 = device number
+  CMD_POLL_OPEN,      // value1 = poll number, value2 = number of options (see VoteTally.h)
+  CMD_VOTE,           // value1 = poll number, value2 = option from 0. Never sent - votes
+                      // travel as tally summaries; recorded so a replay casts them again
+  CMD_COUNT
+};
+
+struct ShowCommand {
+  uint8_t id;         // CommandId
+  int32_t value1;
+  int32_t value2;
+};
+
+// Wire format - little-endian, no padding
+struct ShowFrame {
+  uint8_t magic;
+  uint8_t version;
+  uint8_t command;    // CommandId
+  uint8_t flags;      // FRAME_FLAG_*
+  uint32_t groups;    // Group mask, if FRAME_FLAG_GROUPS
+  uint16_t rangeLo;   // Device range, if FRAME_FLAG_RANGE
+  uint16_t rangeHi;
+  uint32_t seq;       // Per-sender message counter
+  int32_t value1;
+  int32_t value2;
+  uint32_t sender;    // Node ID of the originator
+  uint32_t timestamp; // Sender millis() when the cue was issued
+};
+
+static_assert(sizeof(ShowFrame) == 32, "ShowFrame must stay 32 bytes on the wire");
+
+// A node's own address: group membership and device number (0 = none).
+// Frames without addressing flags reach every node.
+struct ShowAddress {
+  uint32_t groups;
+  uint16_t device;
+};
+
+// "SHOW_START" <-> CMD_SHOW_START. Unknown names map to CMD_NONE.
+const char* showCommandName(uint8_t id);
+uint8_t showCommandFromName(const char* name);
+
+// Fill a frame for `cmd`, addressed to every node
+void showFrameEncode(ShowFrame& frame, const ShowCommand& cmd,
+                     uint32_t sender, uint32_t seq, uint32_t timestamp);
+
+// Limit an encoded frame to groups in `mask` / devices lo..hi
+void showFrameSetGroups(ShowFrame& frame, uint32_t mask);
+void showFrameSetRange(ShowFrame& frame, uint16_t lo, uint16_t hi);
+
+// Receive-side filter for raw radio bytes: reads only the header, no
+// copy. Returns false for frames that aren't for `me` (and for anything
+// that isn't a ShowFrame at all).
+inline bool showFrameForMe(const uint8_t* data, size_t len, const ShowAddress& me) {
+  if (len < 12 || data[0] != SHOW_FRAME_MAGIC) return false;
+  uint8_t flags = data[3];
+  if (flags & FRAME_FLAG_GROUPS) {
+    uint32_t groups = (uint32_t)data[4] | ((uint32_t)data[5] << 8) |
+                      ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 24);
+    if (!(groups & me.groups)) return false;
+  }
+  if (flags & FRAME_FLAG_RANGE) {
+    uint16_t lo = (uint16_t)(data[8] | (data[9] << 8));
+    uint16_t hi = (uint16_t)(data[10] | (data[11] << 8));
+    if (me.device < lo || me.device > hi) return false;
+  }
+  return true;
+}
+
+// "1,3,7" -> bits 1, 3 and 7. Returns 0 for a NULL, empty or invalid list.
+uint32_t showGroupMask(const char* list);
+
+// Validate raw bytes and copy them into `frame`. Radio buffers may be
+// unaligned, so frames are always copied out before their fields are
+// read. Forwarding doesn't need this - pass the raw bytes on as-is.
+bool showFrameDecode(const uint8_t* data, size_t len, ShowFrame& frame);
+
+// Extract the command from a validated frame
+ShowCommand showFrameCommand(const ShowFrame& frame);
+
+#endif
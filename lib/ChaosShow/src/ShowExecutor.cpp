@@ -0,0 +1,103 @@
+/**
+ * ESP Chas TV - Shared command executor
+ */
+
+#include "ShowExecutor.h"
+
+#include <string.h>
+
+ShowExecutor::ShowExecutor() : _nodeId(0) {
+  memset(&_state, 0, sizeof(_state));
+  memset(_hooks, 0, sizeof(_hooks));
+  memset(_hookCtx, 0, sizeof(_hookCtx));
+}
+
+void ShowExecutor::on(uint8_t id, Hook hook, void* ctx) {
+  if (id >= CMD_COUNT) return;
+  _hooks[id] = hook;
+  _hookCtx[id] = ctx;
+}
+
+bool ShowExecutor::execute(const ShowCommand& cmd, uint32_t now) {
+  if (cmd.id == CMD_NONE || cmd.id >= CMD_COUNT) return false;
+
+  switch (cmd.id) {
+    case CMD_LED_ON:
+      setPattern(PATTERN_STEADY, now);
+      break;
+
+    case CMD_LED_OFF:
+      setPattern(PATTERN_OFF, now);
+      break;
+
+    case CMD_LED_TOGGLE:
+      setPattern(ledLevel(now) ? PATTERN_OFF : PATTERN_STEADY, now);
+      break;
+
+    case CMD_PATTERN:
+      setPattern(cmd.value1, now);
+      break;
+
+    case CMD_SHOW_START:
+      _state.showRunning = true;
+      setPattern(PATTERN_SLOW, now);
+      break;
+
+    case CMD_SHOW_STOP:
+      _state.showRunning = false;
+      setPattern(PATTERN_OFF, now);
+      break;
+
+    case CMD_SCENE:
+      _state.scene = cmd.value1;
+      if (cmd.value1 > 0) setPattern(PATTERN_SCENE + cmd.value1, now);
+      break;
+
+    case CMD_SET_GROUPS:
+      if (cmd.value1 == 0 || (uint32_t)cmd.value1 == _nodeId) {
+        _state.address.groups = (uint32_t)cmd.value2;
+      }
+      break;
+
+    case CMD_SET_DEVICE:
+      if (cmd.value1 == 0 || (uint32_t)cmd.value1 == _nodeId) {
+        _state.address.device = (uint16_t)cmd.value2;
+      }
+      break;
+
+    default:
+      // PING/PONG etc. have no built-in state - hooks only
+      break;
+  }
+
+  _state.commandCount++;
+  if (_hooks[cmd.id]) _hooks[cmd.id](cmd, _hookCtx[cmd.id]);
+  return true;
+}
+
+bool ShowExecutor::executeFrame(const uint8_t* data, size_t len, uint32_t now) {
+  ShowFrame frame;
+  if (!showFrameDecode(data, len, frame)) return false;
+  return execute(showFrameCommand(frame), now);
+}
+
+bool ShowExecutor::ledLevel(uint32_t now) const {
+  uint32_t interval;
+  int32_t p = _state.ledPattern;
+
+  if (p == PATTERN_STEADY) return true;
+  if (p == PATTERN_SLOW) interval = 1000;
+  else if (p == PATTERN_FAST) interval = 200;
+  else if (p == PATTERN_STROBE) interval = 50;
+  else if (p > PATTERN_SCENE) interval = 1000 / (uint32_t)(p - PATTERN_SCENE);
+  else return false;
+
+  if (interval < 50) interval = 50;
+  // Starts ON, then toggles every interval
+  return (((now - _state.patternStart) / interval) & 1) == 0;
+}
+
+void ShowExecutor::setPattern(int32_t pattern, uint32_t now) {
+  _state.ledPattern = pattern;
+  _state.patternStart = now;
+}
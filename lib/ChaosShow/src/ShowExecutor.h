@@ -0,0 +1,68 @@
+/**
+ * ESP Chas TV - Shared command executor
+ *
+ * Applies show commands to a ShowState the same way on every device and
+ * evaluates the LED effect for that state. Sketches add behaviour with
+ * per-command hooks, which run after the built-in state change; dispatch
+ * is a table lookup by CommandId, not a chain of strcmp() calls.
+ *
+ * Pure C++ with no Arduino calls: the sketch passes in millis() and
+ * drives the pin from ledLevel().
+ */
+
+#ifndef CHAOS_SHOW_EXECUTOR_H
+#define CHAOS_SHOW_EXECUTOR_H
+
+#include "ShowCommand.h"
+
+// LED patterns
+#define PATTERN_STEADY   -1   // LED_ON
+#define PATTERN_OFF       0
+#define PATTERN_SLOW      1   // 1000 ms blink (show running)
+#define PATTERN_FAST      2   // 200 ms blink
+#define PATTERN_STROBE    3   // 50 ms blink
+#define PATTERN_SCENE    10   // 10 + n: scene n pulses at 1000/n ms
+
+struct ShowState {
+  bool showRunning;
+  int32_t scene;
+  int32_t ledPattern;
+  uint32_t patternStart;   // millis() when the pattern was set
+  uint32_t commandCount;
+  ShowAddress address;     // Groups and device number, set by SET_GROUPS/SET_DEVICE
+};
+
+class ShowExecutor {
+public:
+  typedef void (*Hook)(const ShowCommand& cmd, void* ctx);
+
+  ShowExecutor();
+
+  // Node ID that SET_GROUPS/SET_DEVICE commands are matched against
+  void setNodeId(uint32_t nodeId) { _nodeId = nodeId; }
+
+  // Run `hook` after the built-in handling of `id`
+  void on(uint8_t id, Hook hook, void* ctx = 0);
+
+  // Apply a command. Returns false for unknown ids.
+  bool execute(const ShowCommand& cmd, uint32_t now);
+
+  // Decode raw frame bytes and execute them
+  bool executeFrame(const uint8_t* data, size_t len, uint32_t now);
+
+  // LED level for the current pattern at time `now`
+  bool ledLevel(uint32_t now) const;
+
+  const ShowState& state() const { return _state; }
+  void restore(const ShowState& state) { _state = state; }
+
+private:
+  void setPattern(int32_t pattern, uint32_t now);
+
+  ShowState _state;
+  uint32_t _nodeId;
+  Hook _hooks[CMD_COUNT];
+  void* _hookCtx[CMD_COUNT];
+};
+
+#endif
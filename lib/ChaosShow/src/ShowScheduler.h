@@ -0,0 +1,119 @@
+/**
+ * ESP Chas TV - Radio scheduler, specialised per board
+ *
+ * The radio side of a sketch (draining the receive queue, mesh
+ * rebroadcasts, vote summaries) is one function. Where it runs depends on
+ * the chip, picked at compile time from Board::scheduler:
+ *
+ * - Dual core (ESP32, S3): a task pinned to the protocol core, next to
+ *   the WiFi stack, so a slow web request or serial print on the app core
+ *   never delays a rebroadcast. Stack and task control block are static.
+ * - Cooperative (C3): poll() runs it from loop(). No task, no stack, no
+ *   locking - the lock calls compile to nothing.
+ *
+ * Usage:
+ *   ShowScheduler radio;
+ *   radio.begin(radioWork, 0);      // setup()
+ *   radio.poll();                   // loop() - no-op on dual core
+ *
+ *   { ShowScheduler::Guard g(radio); mesh.send(...); }   // from loop()
+ *
+ * radioWork() runs with the lock held; anything loop() shares with it
+ * must be touched under a Guard.
+ */
+
+#ifndef CHAOS_SHOW_SCHEDULER_H
+#define CHAOS_SHOW_SCHEDULER_H
+
+#include "BoardProfile.h"
+
+#ifdef CHAOS_ON_ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#endif
+
+#define SCHEDULER_RADIO_PRIORITY 2   // Above loop() (1), below WiFi
+
+typedef void (*RadioWork)(void* ctx);
+
+template <SchedulerKind S> class RadioScheduler;
+
+template <> class RadioScheduler<SCHED_COOPERATIVE> {
+public:
+  RadioScheduler() : _work(0), _ctx(0) {}
+
+  bool begin(RadioWork work, void* ctx) {
+    _work = work;
+    _ctx = ctx;
+    return true;
+  }
+
+  void poll() {
+    if (_work) _work(_ctx);
+  }
+
+  void lock() {}
+  void unlock() {}
+
+  class Guard {
+  public:
+    explicit Guard(RadioScheduler&) {}
+  };
+
+private:
+  RadioWork _work;
+  void* _ctx;
+};
+
+#ifdef CHAOS_ON_ESP32
+template <> class RadioScheduler<SCHED_DUAL_CORE> {
+public:
+  RadioScheduler() : _work(0), _ctx(0), _mutex(0) {}
+
+  bool begin(RadioWork work, void* ctx) {
+    _work = work;
+    _ctx = ctx;
+    _mutex = xSemaphoreCreateMutexStatic(&_mutexBuffer);
+    return xTaskCreateStaticPinnedToCore(run, "radio", sizeof(_stack) / sizeof(_stack[0]), this,
+                                         SCHEDULER_RADIO_PRIORITY, _stack, &_task,
+                                         Board::radioCore) != 0;
+  }
+
+  void poll() {}
+
+  // No-ops until begin(), so a sketch that bailed out early still runs
+  void lock() { if (_mutex) xSemaphoreTake(_mutex, portMAX_DELAY); }
+  void unlock() { if (_mutex) xSemaphoreGive(_mutex); }
+
+  class Guard {
+  public:
+    explicit Guard(RadioScheduler& s) : _s(s) { _s.lock(); }
+    ~Guard() { _s.unlock(); }
+  private:
+    RadioScheduler& _s;
+  };
+
+private:
+  static void run(void* arg) {
+    RadioScheduler* self = (RadioScheduler*)arg;
+    for (;;) {
+      self->lock();
+      self->_work(self->_ctx);
+      self->unlock();
+      vTaskDelay(1);
+    }
+  }
+
+  RadioWork _work;
+  void* _ctx;
+  SemaphoreHandle_t _mutex;
+  StaticSemaphore_t _mutexBuffer;
+  StaticTask_t _task;
+  StackType_t _stack[Board::radioStack / sizeof(StackType_t)];
+};
+#endif
+
+typedef RadioScheduler<Board::scheduler> ShowScheduler;
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * ESP Chas TV - Show state that survives resets
+ */
+
+#include "ShowStateStore.h"
+
+#include <esp_attr.h>
+#include <string.h>
+
+#include "PartitionStore.h"
+
+#define RTC_STATE_MAGIC 0x53544154   // "STAT"
+
+// Not cleared by the startup code, so it still holds the last state
+// after any reset that kept the chip powered
+struct RtcState {
+  uint32_t magic;
+  ShowSnapshot snapshot;
+  uint32_t crc;
+};
+RTC_NOINIT_ATTR static RtcState rtcState;
+
+static PartitionStore partitionStore;
+
+// ---------------------------------------------------------------------------
+// ShowStateStore
+// ---------------------------------------------------------------------------
+
+static void takeSnapshot(const ShowExecutor& executor, ShowSnapshot& snap) {
+  const ShowState& s = executor.state();
+  memset(&snap, 0, sizeof(snap));
+  snap.showRunning = s.showRunning ? 1 : 0;
+  snap.scene = s.scene;
+  snap.ledPattern = s.ledPattern;
+  snap.groups = s.address.groups;
+  snap.device = s.address.device;
+}
+
+static bool rtcValid() {
+  return rtcState.magic == RTC_STATE_MAGIC &&
+         rtcState.crc == journalCrc32(&rtcState.snapshot, sizeof(rtcState.snapshot));
+}
+
+ShowStateStore::ShowStateStore() : _journalOk(false) {
+  memset(&_last, 0, sizeof(_last));
+}
+
+bool ShowStateStore::begin(const char* partition) {
+  _journalOk = partitionStore.begin(partition) && _journal.mount(&partitionStore);
+  return _journalOk;
+}
+
+StateSource ShowStateStore::restore(ShowExecutor& executor, uint32_t now) {
+  StateSource source = STATE_NONE;
+  ShowSnapshot snap;
+
+  if (rtcValid()) {
+    snap = rtcState.snapshot;
+    source = STATE_RTC;
+  } else if (_journalOk && _journal.load(&snap, sizeof(snap))) {
+    source = STATE_FLASH;
+  }
+
+  if (source != STATE_NONE) {
+    ShowState state = executor.state();
+    state.showRunning = snap.showRunning != 0;
+    state.scene = snap.scene;
+    state.ledPattern = snap.ledPattern;
+    state.patternStart = now;
+    state.address.groups = snap.groups;
+    state.address.device = snap.device;
+    executor.restore(state);
+  }
+
+  // Whatever we run with now is the baseline for update()
+  takeSnapshot(executor, _last);
+  return source;
+}
+
+void ShowStateStore::update(const ShowExecutor& executor) {
+  ShowSnapshot snap;
+  takeSnapshot(executor, snap);
+  if (memcmp(&snap, &_last, sizeof(snap)) == 0) return;
+  _last = snap;
+
+  rtcState.snapshot = snap;
+  rtcState.crc = journalCrc32(&snap, sizeof(snap));
+  rtcState.magic = RTC_STATE_MAGIC;
+
+  if (_journalOk) _journal.save(&snap, sizeof(snap));
+}
+
+const char* stateSourceName(StateSource source) {
+  switch (source) {
+    case STATE_RTC:   return "RTC memory";
+    case STATE_FLASH: return "flash journal";
+    default:          return "defaults";
+  }
+}
@@ -0,0 +1,72 @@
+/**
+ * ESP Chas TV - Show state that survives resets
+ *
+ * A fixture that reboots mid-show (brownout, watchdog, someone bumps the
+ * power lead) should come back in the scene it left, not "Welcome" - and
+ * in the groups it was assigned to.
+ *
+ * Two layers, fastest first:
+ * - RTC memory: survives software, watchdog and brownout resets. Read in
+ *   microseconds, no flash access.
+ * - StateJournal on the "showstate" flash partition (see partitions.csv):
+ *   survives power-off. Written only when the state actually changes.
+ *
+ * Usage:
+ *   stateStore.begin();
+ *   stateStore.restore(executor, millis());   // early in setup()
+ *   ...
+ *   stateStore.update(executor);              // in loop()
+ */
+
+#ifndef CHAOS_SHOW_STATE_STORE_H
+#define CHAOS_SHOW_STATE_STORE_H
+
+#include "ShowExecutor.h"
+#include "StateJournal.h"
+
+#define SHOW_STATE_PARTITION "showstate"
+
+// The part of ShowState worth keeping across a reset
+struct ShowSnapshot {
+  uint8_t showRunning;
+  uint8_t reserved;
+  uint16_t device;
+  int32_t scene;
+  int32_t ledPattern;
+  uint32_t groups;
+};
+
+enum StateSource {
+  STATE_NONE,     // Nothing saved - defaults
+  STATE_RTC,      // Restored from RTC memory
+  STATE_FLASH     // Restored from the flash journal
+};
+
+class ShowStateStore {
+public:
+  ShowStateStore();
+
+  // Mount the journal partition. Without it only RTC memory is used.
+  bool begin(const char* partition = SHOW_STATE_PARTITION);
+
+  // Apply the saved state to `executor`. The LED pattern restarts at
+  // `now`. Returns where the state came from.
+  StateSource restore(ShowExecutor& executor, uint32_t now);
+
+  // Save the executor's state if it changed since the last call
+  void update(const ShowExecutor& executor);
+
+  bool hasJournal() const { return _journalOk; }
+  const StateJournal& journal() const { return _journal; }
+
+private:
+  StateJournal _journal;
+  bool _journalOk;
+  ShowSnapshot _last;
+};
+
+static_assert(sizeof(ShowSnapshot) <= JOURNAL_MAX_DATA, "snapshot must fit one journal record");
+
+const char* stateSourceName(StateSource source);
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * ESP Chas TV - Pluggable transports
+ *
+ * A transport only moves bytes: it never looks inside a ShowFrame. The
+ * hub fans one buffer out to every registered transport, so a cue is
+ * encoded once and the same bytes go to ESP-NOW, LoRa, ...
+ *
+ * Concrete transports: EspNowTransport.h, LoRaTransport.h.
+ */
+
+#ifndef CHAOS_SHOW_TRANSPORT_H
+#define CHAOS_SHOW_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TRANSPORT_HUB_SIZE 4
+
+class ShowTransport {
+public:
+  virtual ~ShowTransport() {}
+  virtual const char* name() const = 0;
+  virtual bool send(const uint8_t* data, size_t len) = 0;
+};
+
+class TransportHub {
+public:
+  TransportHub() : _count(0) {}
+
+  bool add(ShowTransport* t) {
+    if (_count >= TRANSPORT_HUB_SIZE) return false;
+    _transports[_count++] = t;
+    return true;
+  }
+
+  // Send to every transport except `skip` (the one it came in on).
+  // Returns how many transports accepted the frame.
+  uint8_t send(const uint8_t* data, size_t len, const ShowTransport* skip = 0) {
+    uint8_t ok = 0;
+    for (uint8_t i = 0; i < _count; i++) {
+      if (_transports[i] != skip && _transports[i]->send(data, len)) ok++;
+    }
+    return ok;
+  }
+
+  uint8_t size() const { return _count; }
+  ShowTransport* at(uint8_t i) const { return _transports[i]; }
+
+private:
+  ShowTransport* _transports[TRANSPORT_HUB_SIZE];
+  uint8_t _count;
+};
+
+#endif
@@ -0,0 +1,199 @@
+/**
+ * ESP Chas TV - Append-only state journal
+ */
+
+#include "StateJournal.h"
+
+#include <string.h>
+
+struct SectorHeader {
+  uint32_t magic;
+  uint32_t epoch;
+  uint32_t check;         // ~epoch
+  uint8_t reserved[JOURNAL_RECORD_SIZE - 12];
+};
+
+struct JournalRecord {
+  uint8_t magic;
+  uint8_t len;
+  uint16_t reserved;
+  uint32_t seq;
+  uint8_t data[JOURNAL_MAX_DATA];
+  uint32_t crc;           // Over everything above
+};
+
+static_assert(sizeof(SectorHeader) == JOURNAL_RECORD_SIZE, "header must fill one slot");
+static_assert(sizeof(JournalRecord) == JOURNAL_RECORD_SIZE, "record must fill one slot");
+
+uint32_t journalCrc32(const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  uint32_t crc = 0xFFFFFFFF;
+  while (len--) {
+    crc ^= *p++;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0u - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static bool isErased(const uint8_t* p, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (p[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+StateJournal::StateJournal()
+  : _store(0), _slots(0), _active(-1), _epoch(0), _next(0),
+    _have(false), _seq(0), _len(0) {
+  memset(_data, 0, sizeof(_data));
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+// ---------------------------------------------------------------------------
+// Mount
+// ---------------------------------------------------------------------------
+
+bool StateJournal::readHeader(uint16_t sector, uint32_t* epoch) {
+  SectorHeader h;
+  if (!_store->read((uint32_t)sector * _store->sectorSize(), &h, sizeof(h))) return false;
+  if (h.magic != JOURNAL_SECTOR_MAGIC || h.check != ~h.epoch) return false;
+  *epoch = h.epoch;
+  return true;
+}
+
+// Find the newest valid record in `sector`. With findFree, also set
+// _next to the first erased slot so appends can continue there.
+bool StateJournal::scanSector(uint16_t sector, bool findFree) {
+  uint32_t base = (uint32_t)sector * _store->sectorSize();
+  bool found = false;
+  if (findFree) _next = _slots;
+
+  for (uint16_t slot = 1; slot < _slots; slot++) {
+    JournalRecord r;
+    if (!_store->read(base + (uint32_t)slot * JOURNAL_RECORD_SIZE, &r, sizeof(r))) return found;
+    _stats.scanned++;
+
+    if (isErased((const uint8_t*)&r, sizeof(r))) {
+      if (findFree) _next = slot;
+      break;   // Records are appended in order - nothing after this
+    }
+
+    if (r.magic != JOURNAL_RECORD_MAGIC || r.len > JOURNAL_MAX_DATA ||
+        r.crc != journalCrc32(&r, sizeof(r) - sizeof(r.crc))) {
+      _stats.torn++;
+      continue;
+    }
+
+    if (!_have || r.seq > _seq) {
+      _have = true;
+      _seq = r.seq;
+      _len = r.len;
+      memcpy(_data, r.data, r.len);
+    }
+    found = true;
+  }
+  return found;
+}
+
+bool StateJournal::mount(JournalStore* store) {
+  _store = store;
+  _active = -1;
+  _have = false;
+  _seq = 0;
+  _stats.scanned = 0;
+  _stats.torn = 0;
+
+  uint16_t count = store->sectorCount();
+  if (count < 2 || count > JOURNAL_MAX_SECTORS) return false;
+  _slots = (uint16_t)(store->sectorSize() / JOURNAL_RECORD_SIZE);
+
+  // Sector epochs; 0 = no valid header
+  uint32_t epochs[JOURNAL_MAX_SECTORS];
+  for (uint16_t s = 0; s < count; s++) {
+    if (!readHeader(s, &epochs[s])) epochs[s] = 0;
+  }
+
+  // Newest sector is the one to append to. If power was lost right after
+  // it was started it holds no records yet; fall back to older sectors
+  // for the data itself.
+  uint32_t below = 0xFFFFFFFF;
+  for (uint8_t tries = 0; tries < count; tries++) {
+    int32_t best = -1;
+    for (uint16_t s = 0; s < count; s++) {
+      if (epochs[s] && epochs[s] < below && (best < 0 || epochs[s] > epochs[best])) best = s;
+    }
+    if (best < 0) break;
+
+    bool first = (_active < 0);
+    if (first) {
+      _active = best;
+      _epoch = epochs[best];
+    }
+    if (scanSector((uint16_t)best, first)) break;
+    below = epochs[best];
+  }
+
+  return true;
+}
+
+bool StateJournal::load(void* data, uint8_t len) const {
+  if (!_have || len != _len) return false;
+  memcpy(data, _data, len);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Append
+// ---------------------------------------------------------------------------
+
+bool StateJournal::startSector(uint16_t sector) {
+  if (!_store->erase(sector)) return false;
+  _stats.erases++;
+
+  SectorHeader h;
+  memset(&h, 0xFF, sizeof(h));
+  h.magic = JOURNAL_SECTOR_MAGIC;
+  h.epoch = _epoch + 1;
+  h.check = ~h.epoch;
+  if (!_store->write((uint32_t)sector * _store->sectorSize(), &h, sizeof(h))) return false;
+
+  _active = sector;
+  _epoch = h.epoch;
+  _next = 1;
+  return true;
+}
+
+bool StateJournal::save(const void* data, uint8_t len) {
+  if (!_store || len > JOURNAL_MAX_DATA) return false;
+
+  if (_have && len == _len && memcmp(data, _data, len) == 0) {
+    _stats.skipped++;
+    return true;
+  }
+
+  if (_active < 0 || _next >= _slots) {
+    uint16_t sector = _active < 0 ? 0 : (uint16_t)((_active + 1) % _store->sectorCount());
+    if (!startSector(sector)) return false;
+  }
+
+  JournalRecord r;
+  memset(&r, 0xFF, sizeof(r));
+  r.magic = JOURNAL_RECORD_MAGIC;
+  r.len = len;
+  r.seq = _seq + 1;
+  memcpy(r.data, data, len);
+  r.crc = journalCrc32(&r, sizeof(r) - sizeof(r.crc));
+
+  uint32_t addr = (uint32_t)_active * _store->sectorSize() + (uint32_t)_next * JOURNAL_RECORD_SIZE;
+  _next++;   // Even a failed write may have used the slot
+  if (!_store->write(addr, &r, sizeof(r))) return false;
+
+  _have = true;
+  _seq = r.seq;
+  _len = len;
+  memcpy(_data, data, len);
+  _stats.saves++;
+  return true;
+}
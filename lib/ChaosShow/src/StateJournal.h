@@ -0,0 +1,92 @@
+/**
+ * ESP Chas TV - Append-only state journal
+ *
+ * Keeps the latest copy of a small state blob in flash without rewriting
+ * one spot over and over. Each save appends a 32-byte record with a
+ * sequence number and CRC to the active sector; when a sector fills, the
+ * next one (round robin) is erased and takes over, so erases are spread
+ * evenly over the whole region.
+ *
+ *   sector:  [header: magic, epoch, ~epoch][record][record]...[0xFF...]
+ *   record:  magic, len, seq, data[20], crc32
+ *
+ * A power cut can only tear the record or header being written. Torn
+ * records fail their CRC and are skipped; the newest complete record
+ * wins. The sector holding the newest record is never the one erased.
+ *
+ * save() writes nothing if the data is unchanged. Storage is behind
+ * JournalStore so the same code runs on a flash partition on the ESP32
+ * and on a RAM model in bench/journal_bench.cpp.
+ */
+
+#ifndef CHAOS_STATE_JOURNAL_H
+#define CHAOS_STATE_JOURNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define JOURNAL_RECORD_SIZE   32
+#define JOURNAL_MAX_DATA      20
+#define JOURNAL_MAX_SECTORS   64
+#define JOURNAL_SECTOR_MAGIC  0x314A5343   // "CSJ1"
+#define JOURNAL_RECORD_MAGIC  0xA5
+
+// Flash-like storage: erased bytes read 0xFF, writes only clear bits
+class JournalStore {
+public:
+  virtual ~JournalStore() {}
+  virtual uint32_t sectorSize() const = 0;
+  virtual uint16_t sectorCount() const = 0;
+  virtual bool read(uint32_t addr, void* buf, size_t len) = 0;
+  virtual bool write(uint32_t addr, const void* buf, size_t len) = 0;
+  virtual bool erase(uint16_t sector) = 0;
+};
+
+struct JournalStats {
+  uint32_t saves;      // Records written
+  uint32_t skipped;    // save() calls with unchanged data
+  uint32_t erases;     // Sectors erased
+  uint16_t scanned;    // Record slots read by the last mount()
+  uint16_t torn;       // Damaged records found by the last mount()
+};
+
+class StateJournal {
+public:
+  StateJournal();
+
+  // Scan the store for the newest record. Needs at least 2 sectors.
+  // Returns false only if the store can't be used.
+  bool mount(JournalStore* store);
+
+  // Copy the newest record into `data`. Returns false if there is none
+  // or its length differs from `len`.
+  bool load(void* data, uint8_t len) const;
+
+  // Append `data` if it differs from the newest record
+  bool save(const void* data, uint8_t len);
+
+  uint32_t seq() const { return _seq; }
+  const JournalStats& stats() const { return _stats; }
+
+private:
+  bool readHeader(uint16_t sector, uint32_t* epoch);
+  bool scanSector(uint16_t sector, bool findFree);
+  bool startSector(uint16_t sector);
+
+  JournalStore* _store;
+  uint16_t _slots;        // Record slots per sector, header included
+  int32_t _active;        // Sector being appended to, -1 = none yet
+  uint32_t _epoch;        // Epoch of the active sector
+  uint16_t _next;         // Next free slot in the active sector
+
+  bool _have;
+  uint32_t _seq;
+  uint8_t _len;
+  uint8_t _data[JOURNAL_MAX_DATA];
+
+  JournalStats _stats;
+};
+
+uint32_t journalCrc32(const void* data, size_t len);
+
+#endif
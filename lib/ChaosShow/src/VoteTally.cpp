@@ -0,0 +1,246 @@
+/**
+ * ESP Chas TV - In-network vote aggregation
+ */
+
+#include "VoteTally.h"
+
+#include <string.h>
+
+VoteTally::VoteTally()
+  : _nodeId(0), _send(0), _ctx(0), _poll(0), _options(0), _ownVote(VOTE_NONE),
+    _childCount(0), _parent(0), _leaving(0), _leftAt(0), _version(0), _dirty(false), _shrunk(false),
+    _everSent(false), _nextSend(0), _lastSent(0) {
+  memset(_children, 0, sizeof(_children));
+  memset(_total, 0, sizeof(_total));
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void VoteTally::begin(uint32_t nodeId, SendFn send, void* ctx) {
+  _nodeId = nodeId;
+  _send = send;
+  _ctx = ctx;
+}
+
+void VoteTally::open(uint8_t poll, uint8_t options, uint32_t now) {
+  _poll = poll;
+  _options = options > VOTE_MAX_OPTIONS ? VOTE_MAX_OPTIONS : options;
+  _ownVote = VOTE_NONE;
+  _childCount = 0;
+  memset(_children, 0, sizeof(_children));
+  memset(_total, 0, sizeof(_total));
+  _parent = 0;
+  _leaving = 0;
+  _version = 0;
+  _dirty = false;
+  _shrunk = false;
+  _everSent = false;
+
+  // Spread the first summaries so siblings don't all send at once
+  _nextSend = now + _nodeId % VOTE_INTERVAL_MS;
+}
+
+bool VoteTally::vote(uint8_t option) {
+  if (!isOpen() || (option >= _options && option != VOTE_NONE)) return false;
+  _ownVote = option;
+  recount();
+  return true;
+}
+
+void VoteTally::setParent(uint32_t parent) {
+  if (parent == _parent) return;
+  if (parent == _leaving) {
+    _leaving = 0;                 // Back before it was told: it still has us
+  } else if (!_leaving && _parent && _everSent) {
+    // Only an old parent that has our counts needs to be told. While a
+    // withdrawal is pending, the parent in between has heard nothing.
+    _leaving = _parent;
+    _leftAt = _lastSent;
+  }
+  _parent = parent;
+  if (_everSent) _dirty = true;   // The new parent gets everything, now
+}
+
+uint32_t VoteTally::voters() const {
+  uint32_t n = 0;
+  for (uint8_t i = 0; i < _options; i++) n += _total[i];
+  return n;
+}
+
+// ---------------------------------------------------------------------------
+// Merge
+// ---------------------------------------------------------------------------
+
+bool VoteTally::onSummary(const uint8_t* data, size_t len, uint32_t now) {
+  if (len != sizeof(VoteSummary) || data[0] != VOTE_MAGIC) return false;
+
+  VoteSummary s;
+  memcpy(&s, data, sizeof(s));
+  if (!isOpen() || s.poll != _poll) {
+    _stats.otherPoll++;
+    return true;
+  }
+  if (s.origin == _nodeId || s.origin == 0) return true;
+  _stats.received++;
+
+  Child* child = 0;
+  Child* slot = 0;
+  for (uint8_t i = 0; i < VOTE_MAX_CHILDREN; i++) {
+    Child& c = _children[i];
+    if (c.origin == s.origin) {
+      child = &c;
+      break;
+    }
+    if (!c.origin && !slot) slot = &c;
+  }
+
+  // Meant for another parent: the child moved (or this is its
+  // withdrawal). Drop what it gave us, unless this is an old summary.
+  if (s.parent && s.parent != _nodeId) {
+    if (child && (int32_t)(s.version - child->version) > 0) {
+      dropChild(*child);
+      _stats.moved++;
+      recount();
+    }
+    return true;
+  }
+
+  if (child) {
+    // Last writer wins: an older or equal version adds nothing, but an
+    // equal one proves the child is still there
+    if ((int32_t)(s.version - child->version) <= 0) {
+      if (s.version == child->version) child->heard = now;
+      _stats.duplicates++;
+      return true;
+    }
+  } else {
+    if (!slot) {
+      _stats.overflow++;
+      return true;
+    }
+    child = slot;
+    child->origin = s.origin;
+    _childCount++;
+  }
+
+  child->version = s.version;
+  child->heard = now;
+  for (uint8_t i = 0; i < VOTE_MAX_OPTIONS; i++) {
+    child->counts[i] = i < _options && i < s.options ? s.counts[i] : 0;
+  }
+  _stats.merged++;
+  recount();
+  return true;
+}
+
+void VoteTally::dropChild(Child& c) {
+  c.origin = 0;
+  _childCount--;
+}
+
+void VoteTally::recount() {
+  uint32_t total[VOTE_MAX_OPTIONS];
+  memset(total, 0, sizeof(total));
+  if (_ownVote < _options) total[_ownVote]++;
+
+  for (uint8_t i = 0; i < VOTE_MAX_CHILDREN; i++) {
+    const Child& c = _children[i];
+    if (!c.origin) continue;
+    for (uint8_t o = 0; o < _options; o++) total[o] += c.counts[o];
+  }
+
+  if (memcmp(total, _total, sizeof(total)) != 0) {
+    for (uint8_t o = 0; o < _options; o++) {
+      if (total[o] < _total[o]) _shrunk = true;
+    }
+    memcpy(_total, total, sizeof(total));
+    _dirty = true;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Upstream
+// ---------------------------------------------------------------------------
+
+void VoteTally::update(uint32_t now) {
+  if (!isOpen()) return;
+
+  bool expired = false;
+  for (uint8_t i = 0; i < VOTE_MAX_CHILDREN; i++) {
+    Child& c = _children[i];
+    if (c.origin && now - c.heard >= VOTE_CHILD_TIMEOUT_MS) {
+      dropChild(c);
+      _stats.expired++;
+      expired = true;
+    }
+  }
+  if (expired) recount();
+
+  if (!_send) return;
+
+  // The old parent forgets us by itself once we're silent for longer
+  // than VOTE_CHILD_TIMEOUT_MS, so stop trying after that
+  if (_leaving && now - _leftAt >= VOTE_CHILD_TIMEOUT_MS) _leaving = 0;
+  if (_leaving) {
+    // Withdraw at once, and nothing to the new parent until a full
+    // interval after the old one has let go: better a moment without our
+    // subtree than a moment with it counted twice
+    sendWithdrawal();
+    _nextSend = now + VOTE_INTERVAL_MS;
+    return;
+  }
+
+  // Shrinking totals skip the interval, so a withdrawal travels up the
+  // old path faster than the moved counts travel up the new one
+  if (!_shrunk && (int32_t)(now - _nextSend) < 0) return;
+  _nextSend = now + VOTE_INTERVAL_MS;
+
+  // Nothing to report yet - a silent subtree costs no airtime
+  if (!_everSent && voters() == 0) return;
+  if (_dirty || now - _lastSent >= VOTE_REFRESH_MS) sendSummary(now);
+}
+
+void VoteTally::sendSummary(uint32_t now) {
+  if (_dirty) _version++;
+
+  VoteSummary s;
+  memset(&s, 0, sizeof(s));
+  s.magic = VOTE_MAGIC;
+  s.poll = _poll;
+  s.options = _options;
+  s.origin = _nodeId;
+  s.version = _version;
+  s.parent = _parent;
+  for (uint8_t i = 0; i < _options; i++) {
+    s.counts[i] = (uint16_t)(_total[i] > 0xFFFF ? 0xFFFF : _total[i]);
+  }
+
+  if (!_send(_ctx, _parent, (const uint8_t*)&s, sizeof(s))) {
+    _stats.sendFailed++;
+    return;
+  }
+  _stats.sent++;
+  _dirty = false;
+  _shrunk = false;
+  _everSent = true;
+  _lastSent = now;
+}
+
+// To the parent we just left: no counts, a newer version than anything
+// it has from us, and the new parent's ID so it drops our entry
+void VoteTally::sendWithdrawal() {
+  VoteSummary s;
+  memset(&s, 0, sizeof(s));
+  s.magic = VOTE_MAGIC;
+  s.poll = _poll;
+  s.options = _options;
+  s.origin = _nodeId;
+  s.version = ++_version;
+  s.parent = _parent;
+
+  if (!_send(_ctx, _leaving, (const uint8_t*)&s, sizeof(s))) {
+    _stats.sendFailed++;
+    return;
+  }
+  _stats.sent++;
+  _leaving = 0;
+}
@@ -0,0 +1,156 @@
+/**
+ * ESP Chas TV - In-network vote aggregation
+ *
+ * Audience voting without every vote travelling to the master. Nodes
+ * form a tree towards the master (each sends to its next hop, e.g. the
+ * mesh route back to whoever opened the poll) and every node forwards
+ * one summary - its own vote plus everything below it - at most once per
+ * VOTE_INTERVAL_MS. The master hears from its direct children only, so
+ * its inbound traffic grows with fan-in, not with the audience.
+ *
+ * The tally is a state-based CRDT: a table of last-writer-wins entries,
+ * one per child origin, each holding that child's cumulative counts and
+ * a version. Merging keeps the higher version, so duplicated, re-ordered
+ * or re-sent summaries never count twice. A node's total is its own
+ * vote plus the sum of its children's entries. Unchanged summaries are
+ * re-sent every VOTE_REFRESH_MS to heal losses, and children that stop
+ * refreshing (left the venue) expire.
+ *
+ * Every summary names the parent it is for. When a node's parent changes
+ * (setParent()), it first sends its old parent a withdrawal - zero
+ * counts, newer version, addressed to the new parent - and the old
+ * parent drops that child's entry at once instead of holding the moved
+ * subtree's votes until it times out. A summary heard by a node that
+ * isn't its parent does the same. Totals that go down are sent upstream
+ * without waiting for the interval, and the new parent hears nothing
+ * until one interval after the withdrawal, so the withdrawal wins the
+ * race up the tree and a moved subtree is counted once - briefly not at
+ * all - instead of twice until the old entry times out.
+ *
+ * Transport-agnostic like MeshRouter: summaries go out through a SendFn,
+ * all times are millis() supplied by the caller, and no heap is used.
+ */
+
+#ifndef CHAOS_VOTE_TALLY_H
+#define CHAOS_VOTE_TALLY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define VOTE_MAGIC             0xB7
+#define VOTE_MAX_OPTIONS       8
+#define VOTE_MAX_CHILDREN      32    // Direct children per node
+#define VOTE_INTERVAL_MS       250   // At most one summary upstream per interval
+#define VOTE_REFRESH_MS        2000  // Re-send an unchanged summary
+#define VOTE_CHILD_TIMEOUT_MS  7000  // Forget children that stop refreshing
+
+#define VOTE_NONE              0xFF  // vote(): withdraw our own vote
+
+// Wire format - little-endian, no padding
+struct VoteSummary {
+  uint8_t magic;
+  uint8_t poll;       // Poll number; summaries for other polls are ignored
+  uint8_t options;    // Used entries in counts
+  uint8_t reserved;
+  uint32_t origin;    // Node that sent this summary
+  uint32_t version;   // Bumped whenever origin's total changes
+  uint32_t parent;    // Node this summary is for; 0 = whoever receives it
+  uint16_t counts[VOTE_MAX_OPTIONS];
+};
+
+static_assert(sizeof(VoteSummary) == 32, "VoteSummary must stay 32 bytes on the wire");
+
+struct VoteStats {
+  uint32_t received;    // Summaries heard for the current poll
+  uint32_t merged;      // ...that changed a child entry
+  uint32_t duplicates;  // Same or older version - nothing new
+  uint32_t otherPoll;   // Summaries for a poll we don't have open
+  uint32_t overflow;    // New child, but the table was full
+  uint32_t expired;     // Children dropped after VOTE_CHILD_TIMEOUT_MS
+  uint32_t moved;       // Children dropped because they report to another parent
+  uint32_t sent;        // Summaries handed to SendFn
+  uint32_t sendFailed;  // SendFn refused (no route yet) - retried next interval
+};
+
+class VoteTally {
+public:
+  // Send a summary to node `parent` (the current parent, or the one we
+  // just left; 0 = our parent, whoever it is). Return false if it can't
+  // be reached (yet) - the summary stays due and is retried.
+  typedef bool (*SendFn)(void* ctx, uint32_t parent, const uint8_t* data, size_t len);
+
+  VoteTally();
+
+  // send = NULL on the master: it is the root and only collects
+  void begin(uint32_t nodeId, SendFn send, void* ctx = 0);
+
+  // Start poll `poll` with `options` choices. Clears every tally.
+  void open(uint8_t poll, uint8_t options, uint32_t now);
+  bool isOpen() const { return _options > 0; }
+  uint8_t poll() const { return _poll; }
+  uint8_t options() const { return _options; }
+
+  // Our own vote (0..options-1), or VOTE_NONE. Voting again replaces it.
+  bool vote(uint8_t option);
+
+  // Node ID of our next hop towards the root, 0 = unknown. Call it
+  // whenever the route may have changed; a change withdraws our subtree
+  // from the old parent. Without it summaries go to parent 0 and moves
+  // are only noticed when the old parent times us out.
+  void setParent(uint32_t parent);
+  uint32_t parent() const { return _parent; }
+
+  // Feed bytes heard from a child. Returns false if they aren't a
+  // VoteSummary at all, so the caller can hand them to something else.
+  bool onSummary(const uint8_t* data, size_t len, uint32_t now);
+
+  // Expire children and send our summary when due. Call from loop().
+  void update(uint32_t now);
+
+  // Totals for this node's subtree (the whole audience on the master)
+  uint32_t count(uint8_t option) const { return option < VOTE_MAX_OPTIONS ? _total[option] : 0; }
+  uint32_t voters() const;
+  uint8_t children() const { return _childCount; }
+
+  uint32_t nodeId() const { return _nodeId; }
+  const VoteStats& stats() const { return _stats; }
+
+private:
+  struct Child {
+    uint32_t origin;    // 0 = free slot
+    uint32_t version;
+    uint32_t heard;
+    uint16_t counts[VOTE_MAX_OPTIONS];
+  };
+
+  void recount();
+  void dropChild(Child& c);
+  void sendSummary(uint32_t now);
+  void sendWithdrawal();
+
+  uint32_t _nodeId;
+  SendFn _send;
+  void* _ctx;
+
+  uint8_t _poll;
+  uint8_t _options;
+  uint8_t _ownVote;
+  uint8_t _childCount;
+  Child _children[VOTE_MAX_CHILDREN];
+  uint32_t _total[VOTE_MAX_OPTIONS];
+
+  uint32_t _parent;
+  uint32_t _leaving;    // Old parent still to be sent a withdrawal, 0 = none
+  uint32_t _leftAt;
+
+  uint32_t _version;    // Of our own summary
+  bool _dirty;          // Total changed since the last summary
+  bool _shrunk;         // ...and went down: send without waiting
+  bool _everSent;
+  uint32_t _nextSend;
+  uint32_t _lastSent;
+
+  VoteStats _stats;
+};
+
+#endif
@@ -0,0 +1,134 @@
+"""
+ESP Chas TV - fleet firmware payload
+
+Makes the payload the gateway broadcasts to the fixtures
+(lib/ChaosShow/src/FleetUpdate.h): either the new image as it is, or a
+delta against the image the fixtures are running now, which is usually
+a small fraction of the size.
+
+    python scripts/fleet_delta.py new.bin --version 8 --board esp32 \\
+        --key fleet.key -o payload.bin
+    python scripts/fleet_delta.py new.bin --version 8 --board esp32 \\
+        --key fleet.key --base old.bin --base-version 7 -o payload.bin
+
+The images are the firmware.bin files PlatformIO leaves in
+.pio/build/<env>/ - keep the one you flashed. Prints the sizes, CRCs and
+the curl line that uploads the payload to the gateway.
+
+fleet.key holds the fleet key as 64 hex digits - the same key every
+fixture was given with "fleetkey" on its serial console. Make one with
+    python -c "import secrets; print(secrets.token_hex(32))" > fleet.key
+and keep it off the gateway: the tag printed here is an HMAC-SHA256 over
+the kind, board, version and size of the new image and the image
+itself, and fixtures boot nothing whose tag doesn't check out.
+
+Delta format: "FDL1", then ops - COPY (0x01, u32 offset, u32 length)
+takes bytes from the running image, ADD (0x02, u16 length, bytes) brings
+new ones. Matches are found on 32-byte blocks of the old image and grown
+in both directions, the same scheme bench/fleet_sim_bench.cpp uses.
+"""
+
+import argparse
+import hashlib
+import hmac
+import struct
+import sys
+import zlib
+
+DELTA_MAGIC = 0x314C4446  # "FDL1"
+TAG_MAGIC = 0x31544C46  # "FLT1"
+KIND_FIRMWARE = 2
+OP_COPY = 0x01
+OP_ADD = 0x02
+BLOCK = 32
+BOARDS = ("esp32", "esp32s3", "esp32c3")
+
+
+def add_ops(out, data):
+    for i in range(0, len(data), 0xFFFF):
+        part = data[i:i + 0xFFFF]
+        out += struct.pack("<BH", OP_ADD, len(part)) + part
+
+
+def make_delta(old, new):
+    blocks = {}
+    for o in range(0, len(old) - BLOCK + 1, BLOCK):
+        blocks.setdefault(old[o:o + BLOCK], o)
+
+    out = bytearray(struct.pack("<I", DELTA_MAGIC))
+    pos = lit = 0
+    while pos + BLOCK <= len(new):
+        src = blocks.get(new[pos:pos + BLOCK])
+        if src is None:
+            pos += 1
+            continue
+        at = pos
+        while at > lit and src > 0 and old[src - 1] == new[at - 1]:
+            src -= 1
+            at -= 1
+        end = pos + BLOCK
+        src_end = src + (end - at)
+        while end < len(new) and src_end < len(old) and old[src_end] == new[end]:
+            end += 1
+            src_end += 1
+        add_ops(out, new[lit:at])
+        out += struct.pack("<BII", OP_COPY, src, end - at)
+        pos = lit = end
+    add_ops(out, new[lit:])
+    return bytes(out)
+
+
+def read_key(path):
+    try:
+        key = bytes.fromhex(open(path).read().strip())
+    except ValueError:
+        key = b""
+    if len(key) != 32:
+        sys.exit("%s must hold the fleet key as 64 hex digits" % path)
+    return key
+
+
+def fleet_tag(key, board, version, image):
+    head = struct.pack("<IBBII", TAG_MAGIC, KIND_FIRMWARE, board, version, len(image))
+    return hmac.new(key, head + image, hashlib.sha256).hexdigest()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Make a fleet firmware payload")
+    parser.add_argument("image", help="new firmware.bin")
+    parser.add_argument("--version", type=int, required=True, help="CHAOS_FW_VERSION of the new image")
+    parser.add_argument("--base", help="firmware.bin the fixtures run now (makes a delta)")
+    parser.add_argument("--base-version", type=int, default=0, help="CHAOS_FW_VERSION of --base")
+    parser.add_argument("--board", choices=BOARDS, required=True, help="chip of the fixtures")
+    parser.add_argument("--key", required=True, help="file with the fleet key (64 hex digits)")
+    parser.add_argument("--gateway", default="192.168.4.1")
+    parser.add_argument("-o", "--output", required=True, help="payload file to upload")
+    args = parser.parse_args()
+
+    key = read_key(args.key)
+    new = open(args.image, "rb").read()
+    if args.base:
+        if args.base_version <= 0 or args.base_version >= args.version:
+            sys.exit("--base-version must be set and older than --version")
+        payload = make_delta(open(args.base, "rb").read(), new)
+        base = args.base_version
+    else:
+        payload = new
+        base = 0
+
+    with open(args.output, "wb") as f:
+        f.write(payload)
+
+    image_crc = zlib.crc32(new) & 0xFFFFFFFF
+    print("image   %8d bytes  crc 0x%08X" % (len(new), image_crc))
+    print("payload %8d bytes  crc 0x%08X  (%.1f%% of the image)"
+          % (len(payload), zlib.crc32(payload) & 0xFFFFFFFF, 100.0 * len(payload) / len(new)))
+
+    query = "version=%d&base=%d&size=%d&crc=0x%08X&board=%s&tag=%s" % (
+        args.version, base, len(new), image_crc, args.board,
+        fleet_tag(key, BOARDS.index(args.board), args.version, new))
+    print('curl -F image=@%s "http://%s/fleet/firmware?%s"' % (args.output, args.gateway, query))
+
+
+if __name__ == "__main__":
+    main()
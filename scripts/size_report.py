@@ -0,0 +1,94 @@
+"""
+ESP Chas TV - per-env size and RAM report
+
+PlatformIO post-build step (see extra_scripts in platformio.ini). After
+each firmware link it splits the ELF into flash, IRAM, static DRAM, PSRAM
+and RTC usage, prints one line for the env and keeps a table of every env
+built so far in .pio/build/size_report.csv:
+
+    pio run                       # all envs, then
+    cat .pio/build/size_report.csv
+
+Comparing rows shows what each board profile (BoardProfile.h) and
+transport switch (CHAOS_WITH_*) costs. The `program` column says what was
+built: src/main.cpp, or the example sketch a gateway-* / espnow-sync-*
+env picks with build_src_filter - only those carry the radios.
+"""
+
+import csv
+import os
+import re
+import subprocess
+
+Import("env")  # noqa: F821 - provided by PlatformIO
+
+COLUMNS = ["env", "mcu", "program", "transports", "flash", "iram", "dram_data", "dram_bss", "psram_bss", "rtc"]
+
+
+def classify(name):
+    if name.startswith(".iram0"):
+        return "iram"
+    if name == ".dram0.data":
+        return "dram_data"
+    if name in (".dram0.bss", ".noinit"):
+        return "dram_bss"
+    if name.startswith(".ext_ram"):
+        return "psram_bss"
+    if name.startswith(".rtc"):
+        return "rtc"
+    if name.startswith(".flash"):
+        return "flash"
+    return None
+
+
+def transports(env):
+    enabled = {"ESPNOW": True, "LORA": True, "WEB": True}
+    for define in env.get("CPPDEFINES", []):
+        if isinstance(define, (list, tuple)) and str(define[0]).startswith("CHAOS_WITH_"):
+            enabled[str(define[0])[len("CHAOS_WITH_"):]] = str(define[1]) != "0"
+    return "+".join(sorted(k.lower() for k, on in enabled.items() if on)) or "none"
+
+
+def program(env):
+    match = re.search(r"\+<\.\./examples/([^/>]+)", env.GetProjectOption("build_src_filter", ""))
+    return match.group(1) if match else "src"
+
+
+def size_report(target, source, env):
+    elf = str(target[0])
+    out = subprocess.check_output([env.subst("$SIZETOOL"), "-A", elf]).decode()
+
+    row = dict.fromkeys(COLUMNS[4:], 0)
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) != 3 or not parts[1].isdigit():
+            continue
+        kind = classify(parts[0])
+        if kind:
+            row[kind] += int(parts[1])
+
+    # Code and initialised data in IRAM/DRAM are stored in flash too
+    row["flash"] += row["iram"] + row["dram_data"]
+    row["env"] = env["PIOENV"]
+    row["mcu"] = env.BoardConfig().get("build.mcu", "?")
+    row["program"] = program(env)
+    row["transports"] = transports(env)
+
+    print("Size report [%s, %s, %s, %s]: flash %d | IRAM %d | DRAM %d data + %d bss | PSRAM %d | RTC %d" % (
+        row["env"], row["mcu"], row["program"], row["transports"], row["flash"], row["iram"],
+        row["dram_data"], row["dram_bss"], row["psram_bss"], row["rtc"]))
+
+    path = os.path.join(env.subst("$PROJECT_BUILD_DIR"), "size_report.csv")
+    rows = {}
+    if os.path.exists(path):
+        with open(path) as f:
+            rows = {r["env"]: r for r in csv.DictReader(f)}
+    rows[row["env"]] = row
+    with open(path, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=COLUMNS)
+        writer.writeheader()
+        for name in sorted(rows):
+            writer.writerow(rows[name])
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", size_report)  # noqa: F821
@@ -4,12 +4,23 @@
  * 
  * This is the main entry point for the ESP32 Chaoslab TV Show project.
  * It sets up WiFi, web server, and display capabilities for interactive
- * TV show experiences.
+ * TV show experiences. Built with -DCHAOS_WITH_WEB=0 it leaves out WiFi
+ * and the web UI and only restores and shows the show state.
  */
 
 #include <Arduino.h>
+#include <BoardProfile.h>
+#include <ShowCommand.h>
+#include <ShowExecutor.h>
+#include <FixedString.h>
+#include <ShowStateStore.h>
+#include <BootTimer.h>
+#include <CommandLog.h>
+#include <PartitionStore.h>
+#if CHAOS_WITH_WEB
 #include <WiFi.h>
 #include <WebServer.h>
+#include <ControlPage.h>
 
 // Configuration
 const char* ssid = "ESP_CHAS_TV";           // Default AP name
@@ -17,56 +28,109 @@ const char* password = "chaoslab2024";       // Default AP password
 
 // Web server on port 80
 WebServer server(80);
+#endif
 
 // LED Pin (built-in LED)
 const int LED_PIN = 2;
 
-// State variables
-bool showRunning = false;
+// Show state lives in the executor; the web UI only adds labels
+ShowExecutor executor;
 int viewerCount = 0;
-String currentScene = "Welcome";
+FixedString<32> currentScene = "Welcome";
+
+#if CHAOS_WITH_WEB
+// One page buffer for every request - no String growth per hit.
+// Lives in PSRAM on boards that have it.
+CHAOS_FRAME_BUFFER FixedString<CONTROL_PAGE_SIZE> page;
+#endif
+
+// Show state survives resets (RTC memory + flash journal)
+ShowStateStore stateStore;
+BootTimer bootTimer;
+
+// Every web command, timestamped, on the "cmdlog" partition - pull it
+// with esptool and replay it with bench/replay_bench.cpp
+PartitionStore logStore;
+CommandRecorder recorder;
+
+// Display names for CMD_SCENE values
+const char* const sceneNames[] = {
+  "Welcome",
+  "Scene 1: Introduction",
+  "Scene 2: Main Act",
+  "Scene 3: Finale"
+};
+#define SCENE_NAME_COUNT (sizeof(sceneNames) / sizeof(sceneNames[0]))
+
+/**
+ * Executor hooks - keep the scene label in step with the show state
+ */
+void onShowStart(const ShowCommand& cmd, void* ctx) {
+  currentScene = "Opening";
+  Serial.println("🎬 Show started!");
+}
+
+void onShowStop(const ShowCommand& cmd, void* ctx) {
+  currentScene = "Ended";
+  Serial.println("⏹️ Show stopped!");
+}
+
+void onScene(const ShowCommand& cmd, void* ctx) {
+  if (cmd.value1 >= 0 && (size_t)cmd.value1 < SCENE_NAME_COUNT) {
+    currentScene = sceneNames[cmd.value1];
+  } else {
+    currentScene = "Scene ";
+    currentScene += cmd.value1;
+  }
+  Serial.print("🎭 Changed to Scene ");
+  Serial.println(cmd.value1);
+}
+
+/**
+ * Label for a state restored after a reset
+ */
+void restoreSceneLabel() {
+  const ShowState& s = executor.state();
+  if (!s.showRunning) {
+    currentScene = "Welcome";
+  } else if (s.scene > 0 && (size_t)s.scene < SCENE_NAME_COUNT) {
+    currentScene = sceneNames[s.scene];
+  } else {
+    currentScene = "Opening";
+  }
+}
+
+#if CHAOS_WITH_WEB
+/**
+ * Run a command locally and send the browser back to the main page
+ */
+void runCommand(uint8_t id, int value1 = 0) {
+  ShowCommand cmd = { id, value1, 0 };
+  bool ok = executor.execute(cmd, millis());
+  recorder.record(cmd, SOURCE_WEB, ok ? OUTCOME_EXECUTED : OUTCOME_REJECTED, micros());
+
+  server.sendHeader("Location", "/");
+  server.send(303);
+}
 
 /**
  * Handle root web page
  */
 void handleRoot() {
-  String html = "<!DOCTYPE html><html><head>";
-  html += "<title>ESP Chas TV Control</title>";
-  html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-  html += "<style>";
-  html += "body { font-family: Arial, sans-serif; text-align: center; padding: 20px; background: linear-gradient(135deg, #667eea 0%, #764ba2 100%); color: white; }";
-  html += "h1 { font-size: 2.5em; margin-bottom: 10px; }";
-  html += ".card { background: rgba(255,255,255,0.1); backdrop-filter: blur(10px); padding: 20px; border-radius: 15px; margin: 20px auto; max-width: 500px; box-shadow: 0 8px 32px rgba(0,0,0,0.3); }";
-  html += ".status { font-size: 1.2em; margin: 15px 0; }";
-  html += ".button { background: #4CAF50; color: white; border: none; padding: 15px 32px; text-decoration: none; display: inline-block; font-size: 16px; margin: 10px 5px; cursor: pointer; border-radius: 8px; transition: all 0.3s; }";
-  html += ".button:hover { background: #45a049; transform: scale(1.05); }";
-  html += ".stop { background: #f44336; }";
-  html += ".stop:hover { background: #da190b; }";
-  html += ".info { background: #2196F3; }";
-  html += ".info:hover { background: #0b7dda; }";
-  html += "</style></head><body>";
-  html += "<h1>🎬 ESP Chas TV</h1>";
-  html += "<h3>Chaoslab TV Show Collaboration</h3>";
-  html += "<div class='card'>";
-  html += "<div class='status'>📺 Show Status: <strong>" + String(showRunning ? "LIVE" : "Off Air") + "</strong></div>";
-  html += "<div class='status'>👥 Viewers: <strong>" + String(viewerCount) + "</strong></div>";
-  html += "<div class='status'>🎭 Current Scene: <strong>" + currentScene + "</strong></div>";
-  html += "</div>";
-  html += "<div class='card'>";
-  html += "<h2>Controls</h2>";
-  html += "<a href='/start'><button class='button'>▶️ Start Show</button></a>";
-  html += "<a href='/stop'><button class='button stop'>⏹️ Stop Show</button></a><br>";
-  html += "<a href='/scene1'><button class='button info'>Scene 1</button></a>";
-  html += "<a href='/scene2'><button class='button info'>Scene 2</button></a>";
-  html += "<a href='/scene3'><button class='button info'>Scene 3</button></a>";
-  html += "</div>";
-  html += "<div class='card'>";
-  html += "<p>🔌 Device: ESP32</p>";
-  html += "<p>📡 IP: " + WiFi.localIP().toString() + "</p>";
-  html += "</div>";
-  html += "</body></html>";
+  IPAddress ip = WiFi.softAPIP();
+  char ipText[16];
+  snprintf(ipText, sizeof(ipText), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+
+  ControlPageInfo info;
+  info.showRunning = executor.state().showRunning;
+  info.viewers = viewerCount;
+  info.scene = currentScene.c_str();
+  info.ip = ipText;
+  info.freeHeap = ESP.getFreeHeap();
+  info.largestBlock = ESP.getMaxAllocHeap();
+  renderControlPage(page, info);
   
-  server.send(200, "text/html", html);
+  server.send_P(200, "text/html", page.c_str(), page.length());
   viewerCount++;
 }
 
@@ -74,59 +138,35 @@ void handleRoot() {
  * Start the show
  */
 void handleStart() {
-  showRunning = true;
-  digitalWrite(LED_PIN, HIGH);
-  currentScene = "Opening";
-  Serial.println("🎬 Show started!");
-  
-  server.sendHeader("Location", "/");
-  server.send(303);
+  runCommand(CMD_SHOW_START);
 }
 
 /**
  * Stop the show
  */
 void handleStop() {
-  showRunning = false;
-  digitalWrite(LED_PIN, LOW);
-  currentScene = "Ended";
-  Serial.println("⏹️ Show stopped!");
-  
-  server.sendHeader("Location", "/");
-  server.send(303);
+  runCommand(CMD_SHOW_STOP);
 }
 
 /**
  * Change to scene 1
  */
 void handleScene1() {
-  currentScene = "Scene 1: Introduction";
-  Serial.println("🎭 Changed to Scene 1");
-  
-  server.sendHeader("Location", "/");
-  server.send(303);
+  runCommand(CMD_SCENE, 1);
 }
 
 /**
  * Change to scene 2
  */
 void handleScene2() {
-  currentScene = "Scene 2: Main Act";
-  Serial.println("🎭 Changed to Scene 2");
-  
-  server.sendHeader("Location", "/");
-  server.send(303);
+  runCommand(CMD_SCENE, 2);
 }
 
 /**
  * Change to scene 3
  */
 void handleScene3() {
-  currentScene = "Scene 3: Finale";
-  Serial.println("🎭 Changed to Scene 3");
-  
-  server.sendHeader("Location", "/");
-  server.send(303);
+  runCommand(CMD_SCENE, 3);
 }
 
 /**
@@ -135,22 +175,49 @@ void handleScene3() {
 void handleNotFound() {
   server.send(404, "text/plain", "404: Not Found");
 }
+#endif
 
 /**
  * Setup function - runs once at startup
  */
 void setup() {
+  bootTimer.mark("core", micros());
+  
   // Initialize serial communication
   Serial.begin(115200);
-  delay(1000);
+  
+  // LED and show state first - a rebooted board is back in its scene
+  // before WiFi is even up
+  pinMode(LED_PIN, OUTPUT);
+  executor.on(CMD_SHOW_START, onShowStart);
+  executor.on(CMD_SHOW_STOP, onShowStop);
+  executor.on(CMD_SCENE, onScene);
+  
+  stateStore.begin();
+  StateSource restored = stateStore.restore(executor, millis());
+  restoreSceneLabel();
+  digitalWrite(LED_PIN, executor.ledLevel(millis()) ? HIGH : LOW);
+  bootTimer.mark("state", micros());
+  
+  bool logOk = logStore.begin(CMDLOG_PARTITION, CMDLOG_MAX_SECTORS);
+  recorder.begin(logOk ? &logStore : 0, micros());
+  bootTimer.mark("log", micros());
   
   Serial.println("\n\n🎬 ESP Chas TV Starting...");
   Serial.println("================================");
+  Serial.print("🧩 Board: ");
+  Serial.print(Board::name());
+  Serial.println(Board::psram ? " (page buffer in PSRAM)" : "");
+  Serial.print("💾 Show state: ");
+  Serial.print(stateSourceName(restored));
+  Serial.print(" (");
+  Serial.print(currentScene.c_str());
+  Serial.println(")");
+  Serial.print("📼 Command log: ");
+  Serial.print(recorder.stored());
+  Serial.println(logOk ? " records" : " (no cmdlog partition)");
   
-  // Initialize LED pin
-  pinMode(LED_PIN, OUTPUT);
-  digitalWrite(LED_PIN, LOW);
-  
+#if CHAOS_WITH_WEB
   // Start WiFi Access Point
   Serial.println("📡 Starting WiFi Access Point...");
   WiFi.softAP(ssid, password);
@@ -174,7 +241,16 @@ void setup() {
   
   // Start web server
   server.begin();
+  bootTimer.mark("wifi+web", micros());
   Serial.println("🌐 Web server started!");
+#else
+  Serial.println("🌐 Web UI not built (CHAOS_WITH_WEB=0)");
+#endif
+  
+  FixedString<160> report;
+  bootTimer.format(report);
+  Serial.print("⏱️ Boot: ");
+  Serial.println(report.c_str());
   Serial.println("================================");
   Serial.println("🎭 Ready for collaboration!");
   Serial.println("================================\n");
@@ -184,17 +260,17 @@ void setup() {
  * Main loop - runs continuously
  */
 void loop() {
+#if CHAOS_WITH_WEB
   // Handle web server requests
   server.handleClient();
+#endif
   
-  // LED blink effect when show is running
-  if (showRunning) {
-    static unsigned long lastBlink = 0;
-    if (millis() - lastBlink > 500) {
-      digitalWrite(LED_PIN, !digitalRead(LED_PIN));
-      lastBlink = millis();
-    }
-  }
+  // Persist show state when a cue changed it
+  stateStore.update(executor);
+  recorder.flush();
+  
+  // LED effect for the current show state
+  digitalWrite(LED_PIN, executor.ledLevel(millis()) ? HIGH : LOW);
   
   delay(10);
 }